@@ -0,0 +1,300 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "arena.hpp"
+#include "instrumentation.hpp"
+
+// enough for anything operator new hands out
+const std::size_t ARENA_ALIGNMENT = 16;
+// how much address space is reserved for the chunks of every arena there is.
+// It's only address space, so it's tried big first, and halved until it can
+// be had
+const std::size_t MAX_ARENA_SPACE = std::size_t(1) << 36;
+const std::size_t MIN_ARENA_SPACE = std::size_t(1) << 28;
+
+thread_local memory::arena* active_arena = nullptr;
+// the number of arena scopes and allocation counters in use, on any thread.
+// While it's 0, operator new is malloc behind one branch
+std::atomic<int> allocation_hooks(0);
+
+// Every arena's chunks are carved out of one range of address space, so
+// whether memory came from an arena is told by its address alone. Chunks are
+// never given back to the system, only to the next arena which needs one, so
+// deleting arena memory late is harmless even after its arena is gone. The
+// size is 0 until the range is reserved
+std::atomic<std::uintptr_t> arena_space_begin(0);
+std::atomic<std::size_t> arena_space_size(0);
+// guards the rest of the range, and the spare chunks
+std::mutex arena_space_lock;
+char* arena_space_next = nullptr;
+char* arena_space_end = nullptr;
+memory::arena::chunk* memory::arena::spare_chunks = nullptr;
+
+std::size_t align_size(std::size_t size) {
+	return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+std::size_t page_size() {
+	static const std::size_t size = sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+bool memory::is_arena_memory(void* ptr) {
+	std::size_t size = arena_space_size.load(std::memory_order_acquire);
+	return reinterpret_cast<std::uintptr_t>(ptr)
+			- arena_space_begin.load(std::memory_order_relaxed) < size;
+}
+
+// the chunk header is padded so that the data after it stays aligned
+char* memory::arena::chunk::begin() {
+	return reinterpret_cast<char*>(this) + align_size(sizeof(chunk));
+}
+char* memory::arena::chunk::end() {
+	return begin() + size;
+}
+
+memory::arena::arena(std::size_t chunk_size) :
+		chunk_size(chunk_size) {
+}
+memory::arena::~arena() {
+	if (first == nullptr) {
+		return;
+	}
+	// the pages are given back, but not the address space, which stays the
+	// arenas'. The first page of a chunk has the header in it, so it's kept
+	for (chunk* c = first; c != nullptr; c = c->next) {
+		std::size_t page = page_size();
+		std::size_t total = align_size(sizeof(chunk)) + c->size;
+		if (total > page) {
+			madvise(reinterpret_cast<char*>(c) + page, total - page,
+					MADV_DONTNEED);
+		}
+	}
+	chunk* last = first;
+	while (last->next != nullptr) {
+		last = last->next;
+	}
+	std::lock_guard<std::mutex> lock(arena_space_lock);
+	last->next = spare_chunks;
+	spare_chunks = first;
+}
+
+// reserves the range. The lock has to be held
+bool reserve_arena_space() {
+	for (std::size_t size = MAX_ARENA_SPACE; size >= MIN_ARENA_SPACE; size /=
+			2) {
+		void* space = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (space != MAP_FAILED) {
+			arena_space_next = static_cast<char*>(space);
+			arena_space_end = arena_space_next + size;
+			arena_space_begin.store(reinterpret_cast<std::uintptr_t>(space),
+					std::memory_order_relaxed);
+			arena_space_size.store(size, std::memory_order_release);
+			return true;
+		}
+	}
+	return false;
+}
+
+// chunks don't come from operator new, since that may be what's asking. A
+// spare chunk is used if one is big enough
+memory::arena::chunk* memory::arena::new_chunk(std::size_t size) {
+	std::lock_guard<std::mutex> lock(arena_space_lock);
+	for (chunk** spare = &spare_chunks; *spare != nullptr;
+			spare = &(*spare)->next) {
+		if ((*spare)->size >= size) {
+			chunk* c = *spare;
+			*spare = c->next;
+			c->next = nullptr;
+			return c;
+		}
+	}
+	if (arena_space_next == nullptr && !reserve_arena_space()) {
+		throw std::bad_alloc();
+	}
+	std::size_t page = page_size();
+	std::size_t total = (align_size(sizeof(chunk)) + size + page - 1)
+			& ~(page - 1);
+	if (total > static_cast<std::size_t>(arena_space_end - arena_space_next)) {
+		throw std::bad_alloc();
+	}
+	chunk* c = reinterpret_cast<chunk*>(arena_space_next);
+	arena_space_next += total;
+	c->next = nullptr;
+	c->size = total - align_size(sizeof(chunk));
+	return c;
+}
+
+void* memory::arena::allocate(std::size_t size) {
+	size = align_size(size == 0 ? 1 : size);
+	while (current == nullptr || next_free + size > current->end()) {
+		if (current != nullptr && current->next != nullptr) {
+			// a chunk kept from before the last reset
+			current = current->next;
+		} else {
+			// the chunk is big enough for the allocation, even if it's bigger
+			// than the usual size
+			chunk* c = new_chunk(size > chunk_size ? size : chunk_size);
+			if (current == nullptr) {
+				first = c;
+			} else {
+				current->next = c;
+			}
+			current = c;
+		}
+		next_free = current->begin();
+	}
+	void* ptr = next_free;
+	next_free += size;
+	return ptr;
+}
+
+void memory::arena::reset() {
+	current = first;
+	next_free = first == nullptr ? nullptr : first->begin();
+}
+
+memory::arena* memory::get_active_arena() {
+	return active_arena;
+}
+
+void memory::add_allocation_hook() {
+	allocation_hooks.fetch_add(1, std::memory_order_relaxed);
+}
+void memory::remove_allocation_hook() {
+	allocation_hooks.fetch_sub(1, std::memory_order_relaxed);
+}
+
+memory::arena_scope::arena_scope(memory::arena* a) :
+		previous(active_arena) {
+	add_allocation_hook();
+	active_arena = a;
+}
+memory::arena_scope::~arena_scope() {
+	active_arena = previous;
+	remove_allocation_hook();
+}
+
+void* allocate_from_malloc(std::size_t size) {
+	void* ptr = std::malloc(size == 0 ? 1 : size);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+// counts the allocation, and takes it from the active arena if there is one
+void* allocate_hooked(std::size_t size) {
+	instrumentation::note_allocation(size);
+	memory::arena* arena = active_arena;
+	if (arena != nullptr) {
+		return arena->allocate(size);
+	}
+	return allocate_from_malloc(size);
+}
+
+// the replacement operator new and delete. Every other form goes through
+// these two, apart from the over-aligned ones, which are never in an arena
+void* operator new(std::size_t size) {
+	if (allocation_hooks.load(std::memory_order_relaxed) != 0) {
+		return allocate_hooked(size);
+	}
+	return allocate_from_malloc(size);
+}
+void operator delete(void* ptr) noexcept {
+	// memory from an arena is given back when the arena is reset, whenever
+	// and wherever it's deleted
+	if (memory::is_arena_memory(ptr)) {
+		return;
+	}
+	std::free(ptr);
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return operator new(size);
+	} catch (std::bad_alloc& e) {
+		return nullptr;
+	}
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+void operator delete[](void* ptr) noexcept {
+	operator delete(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	operator delete(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	operator delete(ptr);
+}
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, std::size_t size) noexcept {
+	operator delete(ptr);
+}
+void operator delete[](void* ptr, std::size_t size) noexcept {
+	operator delete(ptr);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	if (allocation_hooks.load(std::memory_order_relaxed) != 0) {
+		instrumentation::note_allocation(size);
+	}
+	void* ptr;
+	if (posix_memalign(&ptr, static_cast<std::size_t>(alignment),
+			size == 0 ? 1 : size) != 0) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+void* operator new(std::size_t size, std::align_val_t alignment,
+		const std::nothrow_t&) noexcept {
+	try {
+		return operator new(size, alignment);
+	} catch (std::bad_alloc& e) {
+		return nullptr;
+	}
+}
+void* operator new[](std::size_t size, std::align_val_t alignment,
+		const std::nothrow_t&) noexcept {
+	return operator new(size, alignment, std::nothrow);
+}
+void operator delete(void* ptr, std::align_val_t alignment) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t alignment,
+		const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t alignment,
+		const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t size,
+		std::align_val_t alignment) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void* ptr, std::size_t size,
+		std::align_val_t alignment) noexcept {
+	std::free(ptr);
+}
+#endif
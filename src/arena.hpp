@@ -0,0 +1,68 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+#include <cstddef>
+
+namespace memory {
+
+// Memory which is handed out by moving a pointer along, and is all given back
+// at once. While an arena is active on a thread, every operator new on that
+// thread takes its memory from the arena, and deleting it does nothing, so a
+// whole compile can be thrown away by resetting the arena, without walking
+// the trees to delete them.
+//
+// Deleting memory from an arena does nothing at any time, even after the
+// arena has stopped being active, been reset or been destroyed, but nothing
+// from an arena may be used after it's reset.
+class arena {
+	struct chunk {
+		chunk* next;
+		std::size_t size;
+		char* begin();
+		char* end();
+	};
+	// chunks from arenas which have been destroyed
+	static chunk* spare_chunks;
+	chunk* first = nullptr;
+	chunk* current = nullptr;
+	char* next_free = nullptr;
+	std::size_t chunk_size;
+public:
+	arena(std::size_t chunk_size);
+	~arena();
+	arena(const arena&) = delete;
+	arena& operator=(const arena&) = delete;
+	void* allocate(std::size_t size);
+	// gives back everything allocated so far. The chunks are kept to be used
+	// again
+	void reset();
+private:
+	chunk* new_chunk(std::size_t size);
+};
+
+// the arena active on this thread, or nullptr if there isn't one
+arena* get_active_arena();
+// whether memory came from any arena, including ones which are gone
+bool is_arena_memory(void* ptr);
+
+// operator new only looks for the active arena and counts allocations while
+// at least one hook has been added, on any thread. Otherwise it goes straight
+// to malloc
+void add_allocation_hook();
+void remove_allocation_hook();
+
+// makes an arena active on this thread for as long as it's in scope
+class arena_scope {
+	arena* previous;
+public:
+	arena_scope(arena* a);
+	~arena_scope();
+};
+
+}
+
+#endif /* ARENA_HPP_ */
@@ -0,0 +1,169 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "batch_mode.hpp"
+#include "errorcodes.hpp"
+#include "frontend.hpp"
+#include "indexer.hpp"
+#include "pass_manager.hpp"
+
+// most sources fit in one chunk, so a reset arena doesn't have to look for
+// more
+const std::size_t BATCH_ARENA_CHUNK_SIZE = 1 << 20;
+
+// reads stdin through a buffer of its own, so no stdio locking is done for
+// each byte
+class input_reader {
+	std::vector<char> buffer;
+	std::size_t pos = 0;
+	std::size_t end = 0;
+public:
+	input_reader() :
+			buffer(1 << 16) {
+	}
+	bool at_end() {
+		return pos == end && !fill();
+	}
+	// returns -1 at the end of the input
+	int read_byte() {
+		if (pos == end && !fill()) {
+			return -1;
+		}
+		return static_cast<unsigned char>(buffer[pos++]);
+	}
+	// returns false if the input ends first
+	bool read_bytes(std::string& out, std::size_t count) {
+		while (count > 0) {
+			if (pos == end && !fill()) {
+				return false;
+			}
+			std::size_t n = std::min(count, end - pos);
+			out.append(&buffer[pos], n);
+			pos += n;
+			count -= n;
+		}
+		return true;
+	}
+	// returns false if the input ends first
+	bool read_int(std::uint32_t& value) {
+		value = 0;
+		for (int i = 0; i < 4; i++) {
+			int b = read_byte();
+			if (b < 0) {
+				return false;
+			}
+			value |= static_cast<std::uint32_t>(b) << (i * 8);
+		}
+		return true;
+	}
+private:
+	bool fill() {
+		pos = 0;
+		end = std::fread(&buffer[0], 1, buffer.size(), stdin);
+		return end > 0;
+	}
+};
+
+// returns false if there are no more sources. Sets truncated if the input
+// ends in the middle of one
+bool read_source(input_reader& in, batch::framing input_framing,
+		std::string& source, bool& truncated) {
+	source.clear();
+	truncated = false;
+	if (input_framing == batch::framing::LENGTH_PREFIXED) {
+		if (in.at_end()) {
+			return false;
+		}
+		std::uint32_t length;
+		if (!in.read_int(length) || !in.read_bytes(source, length)) {
+			truncated = true;
+			return false;
+		}
+		return true;
+	}
+	int c = in.read_byte();
+	if (c < 0) {
+		return false;
+	}
+	while (c > 0) {
+		source.push_back(c);
+		c = in.read_byte();
+	}
+	return true;
+}
+
+void write_int(std::uint32_t value) {
+	char bytes[4];
+	for (int i = 0; i < 4; i++) {
+		bytes[i] = value >> (i * 8);
+	}
+	std::fwrite(bytes, 1, 4, stdout);
+}
+
+// compiles one source with everything allocated in the arena, and writes its
+// result. Nothing which outlives this may be allocated in here
+void compile_source(const std::string& source, int number) {
+	std::ostringstream errors;
+	int exit_code = SUCCESS;
+	{
+		frontend::loaded_file loaded;
+		loaded.name = "<source " + std::to_string(number) + ">";
+		loaded.text = source;
+		loaded.entry = new cache::cache_entry;
+		loaded.status = frontend::file_status::IN_PROGRESS;
+		passes::pass_manager post_parse_passes;
+		frontend::add_post_parse_passes(&post_parse_passes);
+		frontend::tokenize_file(loaded);
+		frontend::parse_file(loaded, &post_parse_passes);
+		if (loaded.status != frontend::file_status::LOADED) {
+			exit_code = frontend::report_file_error(loaded.name, loaded,
+					errors);
+		} else {
+			indexer::index dictionary;
+			diagnostics::diagnostic_buffer diags;
+			if (!indexer::index_ast_tree(loaded.entry->tree, &dictionary,
+					&diags)) {
+				frontend::report_index_error(loaded.name, &diags, errors);
+				exit_code = ERR_INDEX_FAILED;
+			}
+		}
+		// the tree and the entry are given back with the arena
+	}
+	std::string diagnostics = errors.str();
+	write_int(exit_code);
+	write_int(diagnostics.size());
+	std::fwrite(diagnostics.data(), 1, diagnostics.size(), stdout);
+	// whatever is feeding the sources may be waiting for the result
+	std::fflush(stdout);
+}
+
+int batch::run_batch(batch::framing input_framing) {
+	// the same source always gives the same result
+	frontend::set_witty_comments(false);
+	input_reader in;
+	std::string source;
+	memory::arena arena(BATCH_ARENA_CHUNK_SIZE);
+	bool truncated;
+	for (int number = 0; read_source(in, input_framing, source, truncated);
+			number++) {
+		{
+			memory::arena_scope scope(&arena);
+			compile_source(source, number);
+		}
+		arena.reset();
+	}
+	if (truncated) {
+		std::cerr << "Unexpected end of input" << std::endl;
+		return ERR_FOPEN_FAILED;
+	}
+	return SUCCESS;
+}
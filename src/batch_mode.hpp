@@ -0,0 +1,29 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef BATCH_MODE_HPP_
+#define BATCH_MODE_HPP_
+
+// Compiling a stream of small programs in one process, to save starting a
+// process for each of them. The sources are read from stdin, and each one is
+// compiled on its own, with nothing kept from the one before. For each
+// source, in order, the exit code and then whatever would have been printed
+// to stderr are written to stdout, each as a 32 bit little endian length
+// followed by that many bytes, or for the exit code just the 32 bit number.
+namespace batch {
+
+enum class framing {
+	// each source is a 32 bit little endian length followed by that many bytes
+	LENGTH_PREFIXED,
+	// each source ends with a NUL byte, or with the end of the input
+	NUL_DELIMITED
+};
+
+// returns once stdin runs out. The exit code is only an error if the input
+// ends in the middle of a source
+int run_batch(framing input_framing);
+
+}
+
+#endif /* BATCH_MODE_HPP_ */
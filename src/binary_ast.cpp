@@ -0,0 +1,848 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "binary_ast.hpp"
+
+const std::uint32_t HEADER_SIZE = 32;
+const std::uint32_t TYPE_RECORD_SIZE = 12;
+const std::uint32_t STRING_RECORD_SIZE = 8;
+
+void append_u32(std::string& data, std::uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		data.push_back(static_cast<char>(value >> (i * 8)));
+	}
+}
+
+void set_u32(std::string& data, std::uint32_t offset, std::uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		data[offset + i] = static_cast<char>(value >> (i * 8));
+	}
+}
+
+std::uint8_t get_modifier_flags(std::set<ast::modifier>* modifiers) {
+	std::uint8_t flags = 0;
+	for (ast::modifier mod : *modifiers) {
+		flags |= 1 << static_cast<int>(mod);
+	}
+	return flags;
+}
+
+class image_writer {
+	std::string data;
+	std::vector<std::string> strings;
+	std::unordered_map<std::string, std::uint32_t> string_ids;
+	std::vector<ast::type_ref> types;
+	// types are told apart by their full names
+	std::unordered_map<std::string, std::uint32_t> type_ids;
+public:
+	image_writer() :
+			data(HEADER_SIZE, '\0') {
+	}
+	std::uint32_t add_string(const std::string& value) {
+		std::unordered_map<std::string, std::uint32_t>::iterator it =
+				string_ids.find(value);
+		if (it != string_ids.end()) {
+			return it->second;
+		}
+		std::uint32_t id = strings.size();
+		strings.push_back(value);
+		string_ids[value] = id;
+		return id;
+	}
+	// a type's generic arguments are always added before it, so that the
+	// reader can check there are no loops
+	std::uint32_t add_type(ast::type_ref type) {
+		std::string key = type.to_string();
+		std::unordered_map<std::string, std::uint32_t>::iterator it =
+				type_ids.find(key);
+		if (it != type_ids.end()) {
+			return it->second;
+		}
+		for (ast::type_ref& generic_arg : *type.get_generic_args()) {
+			add_type(generic_arg);
+		}
+		std::uint32_t id = types.size();
+		types.push_back(type);
+		type_ids[key] = id;
+		return id;
+	}
+	std::uint32_t write_record(binary_ast::node_category category,
+			std::uint8_t kind, std::uint8_t flags,
+			std::vector<std::uint32_t> slots) {
+		std::uint32_t offset = get_offset();
+		data.push_back(static_cast<char>(category));
+		data.push_back(static_cast<char>(kind));
+		data.push_back(static_cast<char>(flags));
+		data.push_back(static_cast<char>(slots.size()));
+		for (std::uint32_t slot : slots) {
+			append_u32(data, slot);
+		}
+		return offset;
+	}
+	std::uint32_t write_list(std::vector<std::uint32_t>& entries) {
+		std::uint32_t offset = get_offset();
+		append_u32(data, entries.size());
+		for (std::uint32_t entry : entries) {
+			append_u32(data, entry);
+		}
+		return offset;
+	}
+	std::uint32_t write_expressions(std::vector<ast::expression*>* exprs) {
+		std::vector<std::uint32_t> entries;
+		for (ast::expression* expr : *exprs) {
+			entries.push_back(write_expression(expr));
+		}
+		return write_list(entries);
+	}
+	// children are always written before their parents, so that the parent
+	// knows where they are
+	std::uint32_t write_expression(ast::expression* expr) {
+		if (expr == nullptr) {
+			return 0;
+		}
+		std::uint8_t kind = static_cast<std::uint8_t>(expr->get_expression_kind());
+		std::vector<std::uint32_t> slots;
+		std::uint8_t flags = 0;
+		switch (expr->get_expression_kind()) {
+		case ast::expression_kind::IDENTIFIER:
+			slots.push_back(
+					add_string(
+							static_cast<ast::identifier_expression*>(expr)->get_identifier()));
+			break;
+		case ast::expression_kind::PARENTHESIZED:
+			slots.push_back(
+					write_expression(
+							static_cast<ast::parenthesized_expression*>(expr)->get_child()));
+			break;
+		case ast::expression_kind::CALL: {
+			ast::call_expression* call = static_cast<ast::call_expression*>(expr);
+			slots.push_back(add_string(call->get_name()));
+			slots.push_back(write_expressions(call->get_operands()));
+			break;
+		}
+		case ast::expression_kind::NAMESPACE: {
+			ast::namespace_expression* ns =
+					static_cast<ast::namespace_expression*>(expr);
+			slots.push_back(add_string(ns->get_namespace()));
+			slots.push_back(write_expression(ns->get_operand()));
+			break;
+		}
+		case ast::expression_kind::OPERATOR: {
+			ast::operator_expression* op =
+					static_cast<ast::operator_expression*>(expr);
+			slots.push_back(write_expression(op->get_lhs()));
+			slots.push_back(add_string(op->get_operator()));
+			slots.push_back(write_expression(op->get_rhs()));
+			break;
+		}
+		case ast::expression_kind::UNARY_OPERATOR_LEFT: {
+			ast::unary_operator_left_expression* op =
+					static_cast<ast::unary_operator_left_expression*>(expr);
+			slots.push_back(add_string(op->get_operator()));
+			slots.push_back(write_expression(op->get_operand()));
+			break;
+		}
+		case ast::expression_kind::UNARY_OPERATOR_RIGHT: {
+			ast::unary_operator_right_expression* op =
+					static_cast<ast::unary_operator_right_expression*>(expr);
+			slots.push_back(add_string(op->get_operator()));
+			slots.push_back(write_expression(op->get_operand()));
+			break;
+		}
+		case ast::expression_kind::CONST_BOOLEAN:
+			flags = static_cast<ast::const_boolean_expression*>(expr)->get_value();
+			break;
+		case ast::expression_kind::CONST_INTEGER: {
+			ast::const_integer_expression* integer =
+					static_cast<ast::const_integer_expression*>(expr);
+			slots.push_back(static_cast<std::uint32_t>(integer->get_value()));
+			flags = static_cast<std::uint8_t>(integer->get_radix());
+			break;
+		}
+		case ast::expression_kind::CONST_FLOAT: {
+			float value =
+					static_cast<ast::const_float_expression*>(expr)->get_value();
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			slots.push_back(bits);
+			break;
+		}
+		case ast::expression_kind::CONST_DOUBLE: {
+			double value =
+					static_cast<ast::const_double_expression*>(expr)->get_value();
+			std::uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			slots.push_back(static_cast<std::uint32_t>(bits));
+			slots.push_back(static_cast<std::uint32_t>(bits >> 32));
+			break;
+		}
+		case ast::expression_kind::CONST_STRING:
+			slots.push_back(
+					add_string(
+							static_cast<ast::const_string_expression*>(expr)->get_value()));
+			break;
+		case ast::expression_kind::CAST: {
+			ast::cast_expression* cast = static_cast<ast::cast_expression*>(expr);
+			slots.push_back(add_type(cast->get_target_type()));
+			slots.push_back(write_expression(cast->get_operand()));
+			break;
+		}
+		case ast::expression_kind::ARRAY: {
+			ast::array_expression* array =
+					static_cast<ast::array_expression*>(expr);
+			slots.push_back(write_expression(array->get_target()));
+			slots.push_back(write_expressions(array->get_indices()));
+			break;
+		}
+		}
+		return write_record(binary_ast::node_category::EXPRESSION, kind, flags,
+				slots);
+	}
+	std::uint32_t write_statement(ast::statement* stmt) {
+		if (stmt == nullptr) {
+			return 0;
+		}
+		std::uint8_t kind = static_cast<std::uint8_t>(stmt->get_statement_kind());
+		std::vector<std::uint32_t> slots;
+		std::uint8_t flags = 0;
+		switch (stmt->get_statement_kind()) {
+		case ast::statement_kind::BLOCK: {
+			std::vector<std::uint32_t> entries;
+			for (ast::statement* child : *static_cast<ast::block_statement*>(stmt)->get_children()) {
+				entries.push_back(write_statement(child));
+			}
+			slots.push_back(write_list(entries));
+			break;
+		}
+		case ast::statement_kind::VARIABLE_DECLARATION: {
+			ast::variable_declaration_statement* var =
+					static_cast<ast::variable_declaration_statement*>(stmt);
+			slots.push_back(add_type(var->get_type()));
+			slots.push_back(add_string(var->get_name()));
+			slots.push_back(
+					write_expression(var->get_initialization_expression()));
+			flags = get_modifier_flags(var->get_modifiers());
+			break;
+		}
+		case ast::statement_kind::ASSIGNMENT: {
+			ast::assignment_statement* assignment =
+					static_cast<ast::assignment_statement*>(stmt);
+			slots.push_back(write_expression(assignment->get_lhs()));
+			slots.push_back(add_string(assignment->get_assignment_operator()));
+			slots.push_back(write_expression(assignment->get_rhs()));
+			break;
+		}
+		case ast::statement_kind::IF: {
+			ast::if_statement* if_stmt = static_cast<ast::if_statement*>(stmt);
+			slots.push_back(write_expression(if_stmt->get_condition()));
+			slots.push_back(write_statement(if_stmt->get_if_clause()));
+			slots.push_back(write_statement(if_stmt->get_else_clause()));
+			break;
+		}
+		case ast::statement_kind::WHILE: {
+			ast::while_statement* while_stmt =
+					static_cast<ast::while_statement*>(stmt);
+			slots.push_back(write_expression(while_stmt->get_condition()));
+			slots.push_back(write_statement(while_stmt->get_while_clause()));
+			break;
+		}
+		case ast::statement_kind::DO_WHILE: {
+			ast::do_while_statement* do_while_stmt =
+					static_cast<ast::do_while_statement*>(stmt);
+			slots.push_back(
+					write_statement(do_while_stmt->get_do_while_clause()));
+			slots.push_back(write_expression(do_while_stmt->get_condition()));
+			break;
+		}
+		case ast::statement_kind::FOR: {
+			ast::for_statement* for_stmt = static_cast<ast::for_statement*>(stmt);
+			slots.push_back(write_statement(for_stmt->get_initializer()));
+			slots.push_back(write_expression(for_stmt->get_condition()));
+			slots.push_back(write_statement(for_stmt->get_increment()));
+			slots.push_back(write_statement(for_stmt->get_for_clause()));
+			break;
+		}
+		case ast::statement_kind::FOREVER:
+			slots.push_back(
+					write_statement(
+							static_cast<ast::forever_statement*>(stmt)->get_forever_clause()));
+			break;
+		case ast::statement_kind::REPEAT: {
+			ast::repeat_statement* repeat_stmt =
+					static_cast<ast::repeat_statement*>(stmt);
+			slots.push_back(write_expression(repeat_stmt->get_times()));
+			slots.push_back(write_statement(repeat_stmt->get_repeat_clause()));
+			break;
+		}
+		case ast::statement_kind::RETURN:
+			slots.push_back(
+					write_expression(
+							static_cast<ast::return_statement*>(stmt)->get_operand()));
+			break;
+		case ast::statement_kind::EXPRESSION:
+			slots.push_back(
+					write_expression(
+							static_cast<ast::expression_statement*>(stmt)->get_expression()));
+			break;
+		}
+		return write_record(binary_ast::node_category::STATEMENT, kind, flags,
+				slots);
+	}
+	std::uint32_t write_ast_nodes(std::vector<ast::ast_node*>* nodes) {
+		std::vector<std::uint32_t> entries;
+		for (ast::ast_node* node : *nodes) {
+			entries.push_back(write_ast_node(node));
+		}
+		return write_list(entries);
+	}
+	std::uint32_t write_ast_node(ast::ast_node* node) {
+		std::uint8_t kind = static_cast<std::uint8_t>(node->get_ast_node_kind());
+		std::vector<std::uint32_t> slots;
+		std::uint8_t flags = 0;
+		switch (node->get_ast_node_kind()) {
+		case ast::ast_node_kind::MODULE: {
+			ast::module_node* module = static_cast<ast::module_node*>(node);
+			slots.push_back(add_string(module->get_namespace()));
+			slots.push_back(write_ast_nodes(module->get_children()));
+			break;
+		}
+		case ast::ast_node_kind::FIELD: {
+			ast::field_node* field = static_cast<ast::field_node*>(node);
+			slots.push_back(add_type(field->get_type()));
+			slots.push_back(add_string(field->get_name()));
+			slots.push_back(
+					write_expression(field->get_initialization_expression()));
+			flags = get_modifier_flags(field->get_modifiers());
+			break;
+		}
+		case ast::ast_node_kind::FUNCTION: {
+			ast::function_node* func = static_cast<ast::function_node*>(node);
+			slots.push_back(add_type(func->get_return_type()));
+			slots.push_back(add_string(func->get_name()));
+			std::vector<std::uint32_t> params;
+			for (ast::field_node* param : *func->get_parameters()) {
+				params.push_back(write_ast_node(param));
+			}
+			slots.push_back(write_list(params));
+			slots.push_back(write_statement(func->get_body()));
+			flags = get_modifier_flags(func->get_modifiers());
+			break;
+		}
+		}
+		return write_record(binary_ast::node_category::AST_NODE, kind, flags,
+				slots);
+	}
+	std::string finish(std::uint32_t roots) {
+		std::vector<std::uint32_t> type_records;
+		for (ast::type_ref& type : types) {
+			std::vector<std::uint32_t> namespaces;
+			for (std::string& ns : *type.get_namespaces()) {
+				namespaces.push_back(add_string(ns));
+			}
+			std::vector<std::uint32_t> generic_args;
+			for (ast::type_ref& generic_arg : *type.get_generic_args()) {
+				generic_args.push_back(add_type(generic_arg));
+			}
+			type_records.push_back(add_string(type.get_type_name()));
+			type_records.push_back(write_list(namespaces));
+			type_records.push_back(write_list(generic_args));
+		}
+		std::vector<std::uint32_t> string_records;
+		for (std::string& str : strings) {
+			string_records.push_back(get_offset());
+			string_records.push_back(str.size());
+			data += str;
+		}
+		while (data.size() % 4 != 0) {
+			data.push_back('\0');
+		}
+		std::uint32_t string_table = get_offset();
+		for (std::uint32_t value : string_records) {
+			append_u32(data, value);
+		}
+		std::uint32_t type_table = get_offset();
+		for (std::uint32_t value : type_records) {
+			append_u32(data, value);
+		}
+		std::uint32_t image_size = get_offset();
+		set_u32(data, 0, binary_ast::MAGIC);
+		set_u32(data, 4, binary_ast::VERSION);
+		set_u32(data, 8, image_size);
+		set_u32(data, 12, strings.size());
+		set_u32(data, 16, string_table);
+		set_u32(data, 20, types.size());
+		set_u32(data, 24, type_table);
+		set_u32(data, 28, roots);
+		return data;
+	}
+private:
+	std::uint32_t get_offset() {
+		if (data.size() > std::numeric_limits<std::uint32_t>::max()) {
+			throw binary_ast::binary_ast_exception("Image too large");
+		}
+		return data.size();
+	}
+};
+
+binary_ast::binary_ast_exception::binary_ast_exception(
+		const char* description) :
+		description(description) {
+}
+const char* binary_ast::binary_ast_exception::what() {
+	return description;
+}
+
+std::string binary_ast::string_ref::to_string() {
+	return std::string(data, size);
+}
+bool binary_ast::string_ref::equals(const std::string& other) {
+	return other.size() == size && std::memcmp(other.data(), data, size) == 0;
+}
+
+binary_ast::type_view::type_view(const binary_ast::image* img,
+		std::uint32_t id) :
+		img(img), id(id), offset(img->get_type_record(id)) {
+}
+binary_ast::string_ref binary_ast::type_view::get_type_name() {
+	return img->get_string(img->read_u32(offset));
+}
+std::uint32_t binary_ast::type_view::get_namespace_count() {
+	return img->read_u32(img->read_u32(offset + 4));
+}
+binary_ast::string_ref binary_ast::type_view::get_namespace(std::uint32_t i) {
+	std::uint32_t list = img->read_u32(offset + 4);
+	if (i >= img->read_u32(list)) {
+		throw binary_ast::binary_ast_exception("Namespace out of range");
+	}
+	return img->get_string(img->read_u32(list + 4 + i * 4));
+}
+std::uint32_t binary_ast::type_view::get_generic_arg_count() {
+	return img->read_u32(img->read_u32(offset + 8));
+}
+binary_ast::type_view binary_ast::type_view::get_generic_arg(std::uint32_t i) {
+	std::uint32_t list = img->read_u32(offset + 8);
+	if (i >= img->read_u32(list)) {
+		throw binary_ast::binary_ast_exception("Generic argument out of range");
+	}
+	std::uint32_t generic_arg = img->read_u32(list + 4 + i * 4);
+	if (generic_arg >= id) {
+		throw binary_ast::binary_ast_exception(
+				"Generic argument is not before its type");
+	}
+	return type_view(img, generic_arg);
+}
+ast::type_ref binary_ast::type_view::to_type_ref() {
+	std::vector<std::string>* namespaces = new std::vector<std::string>;
+	for (std::uint32_t i = 0, e = get_namespace_count(); i < e; i++) {
+		namespaces->push_back(get_namespace(i).to_string());
+	}
+	std::vector<ast::type_ref>* generic_args = new std::vector<ast::type_ref>;
+	for (std::uint32_t i = 0, e = get_generic_arg_count(); i < e; i++) {
+		generic_args->push_back(get_generic_arg(i).to_type_ref());
+	}
+	return ast::type_ref(namespaces, get_type_name().to_string(), generic_args);
+}
+
+binary_ast::node_view::node_view(const binary_ast::image* img,
+		std::uint32_t offset) :
+		img(img), offset(offset) {
+}
+bool binary_ast::node_view::is_null() {
+	return offset == 0;
+}
+binary_ast::node_category binary_ast::node_view::get_category() {
+	std::uint8_t category = img->read_u8(offset);
+	if (category < static_cast<std::uint8_t>(node_category::EXPRESSION)
+			|| category > static_cast<std::uint8_t>(node_category::AST_NODE)) {
+		throw binary_ast::binary_ast_exception("Unknown node category");
+	}
+	return static_cast<binary_ast::node_category>(category);
+}
+ast::expression_kind binary_ast::node_view::get_expression_kind() {
+	std::uint8_t kind = img->read_u8(offset + 1);
+	if (get_category() != node_category::EXPRESSION
+			|| kind > static_cast<std::uint8_t>(ast::expression_kind::ARRAY)) {
+		throw binary_ast::binary_ast_exception("Not an expression");
+	}
+	return static_cast<ast::expression_kind>(kind);
+}
+ast::statement_kind binary_ast::node_view::get_statement_kind() {
+	std::uint8_t kind = img->read_u8(offset + 1);
+	if (get_category() != node_category::STATEMENT
+			|| kind > static_cast<std::uint8_t>(ast::statement_kind::EXPRESSION)) {
+		throw binary_ast::binary_ast_exception("Not a statement");
+	}
+	return static_cast<ast::statement_kind>(kind);
+}
+ast::ast_node_kind binary_ast::node_view::get_ast_node_kind() {
+	std::uint8_t kind = img->read_u8(offset + 1);
+	if (get_category() != node_category::AST_NODE
+			|| kind > static_cast<std::uint8_t>(ast::ast_node_kind::FUNCTION)) {
+		throw binary_ast::binary_ast_exception("Not an AST node");
+	}
+	return static_cast<ast::ast_node_kind>(kind);
+}
+std::uint8_t binary_ast::node_view::get_flags() {
+	return img->read_u8(offset + 2);
+}
+std::uint8_t binary_ast::node_view::get_slot_count() {
+	return img->read_u8(offset + 3);
+}
+std::uint32_t binary_ast::node_view::get_slot(int slot) {
+	if (slot < 0 || slot >= get_slot_count()) {
+		throw binary_ast::binary_ast_exception("Slot out of range");
+	}
+	return img->read_u32(offset + 4 + slot * 4);
+}
+// children are always written before their parents, which is checked so that
+// a broken image can't make a walk go round in circles
+std::uint32_t check_before(std::uint32_t child, std::uint32_t parent) {
+	if (child >= parent) {
+		throw binary_ast::binary_ast_exception("Child is not before its parent");
+	}
+	return child;
+}
+
+binary_ast::node_view binary_ast::node_view::get_child(int slot) {
+	return node_view(img, check_before(get_slot(slot), offset));
+}
+binary_ast::node_list binary_ast::node_view::get_list(int slot) {
+	return node_list(img, check_before(get_slot(slot), offset));
+}
+binary_ast::string_ref binary_ast::node_view::get_string(int slot) {
+	return img->get_string(get_slot(slot));
+}
+binary_ast::type_view binary_ast::node_view::get_type(int slot) {
+	return img->get_type(get_slot(slot));
+}
+std::int32_t binary_ast::node_view::get_int(int slot) {
+	return static_cast<std::int32_t>(get_slot(slot));
+}
+float binary_ast::node_view::get_float(int slot) {
+	std::uint32_t bits = get_slot(slot);
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+double binary_ast::node_view::get_double(int slot) {
+	std::uint64_t bits = get_slot(slot)
+			| static_cast<std::uint64_t>(get_slot(slot + 1)) << 32;
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+bool binary_ast::node_view::has_modifier(ast::modifier mod) {
+	return (get_flags() >> static_cast<int>(mod)) & 1;
+}
+
+binary_ast::node_list::node_list(const binary_ast::image* img,
+		std::uint32_t offset) :
+		img(img), offset(offset) {
+}
+std::uint32_t binary_ast::node_list::size() {
+	return img->read_u32(offset);
+}
+binary_ast::node_view binary_ast::node_list::get(std::uint32_t i) {
+	if (i >= size()) {
+		throw binary_ast::binary_ast_exception("List index out of range");
+	}
+	return node_view(img, check_before(img->read_u32(offset + 4 + i * 4), offset));
+}
+
+binary_ast::image::image(const char* data, std::size_t size) :
+		data(data), size(size) {
+	if (size > std::numeric_limits<std::uint32_t>::max()) {
+		throw binary_ast::binary_ast_exception("Image too large");
+	}
+	read_header();
+}
+binary_ast::image::~image() {
+	if (mapping != nullptr) {
+		munmap(mapping, mapping_size);
+	}
+}
+binary_ast::image* binary_ast::image::map_file(const std::string& path) {
+	return map_file(path, 0);
+}
+binary_ast::image* binary_ast::image::map_file(const std::string& path,
+		std::size_t offset) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw binary_ast::binary_ast_exception("Failed to open image");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) <= offset) {
+		close(fd);
+		throw binary_ast::binary_ast_exception("Failed to open image");
+	}
+	void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid after the file is closed
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		throw binary_ast::binary_ast_exception("Failed to map image");
+	}
+	binary_ast::image* img;
+	try {
+		img = new binary_ast::image(static_cast<const char*>(mapping) + offset,
+				st.st_size - offset);
+	} catch (binary_ast::binary_ast_exception& e) {
+		munmap(mapping, st.st_size);
+		throw;
+	}
+	img->mapping = mapping;
+	img->mapping_size = st.st_size;
+	return img;
+}
+void binary_ast::image::read_header() {
+	if (size < HEADER_SIZE || read_u32(0) != binary_ast::MAGIC) {
+		throw binary_ast::binary_ast_exception("Not an AST image");
+	}
+	if (read_u32(4) != binary_ast::VERSION) {
+		throw binary_ast::binary_ast_exception("Unsupported AST image version");
+	}
+	if (read_u32(8) != size) {
+		throw binary_ast::binary_ast_exception("AST image has the wrong size");
+	}
+	string_count = read_u32(12);
+	string_table = read_u32(16);
+	type_count = read_u32(20);
+	type_table = read_u32(24);
+	roots = read_u32(28);
+	// make sure the tables fit, so that looking things up in them only has
+	// to check the number
+	get_bytes(string_table, 0);
+	get_bytes(type_table, 0);
+	if (static_cast<std::uint64_t>(string_count) * STRING_RECORD_SIZE
+			> size - string_table
+			|| static_cast<std::uint64_t>(type_count) * TYPE_RECORD_SIZE
+					> size - type_table) {
+		throw binary_ast::binary_ast_exception("AST image tables don't fit");
+	}
+}
+binary_ast::node_list binary_ast::image::get_roots() const {
+	return node_list(this, roots);
+}
+std::uint32_t binary_ast::image::get_string_count() const {
+	return string_count;
+}
+binary_ast::string_ref binary_ast::image::get_string(std::uint32_t id) const {
+	if (id >= string_count) {
+		throw binary_ast::binary_ast_exception("String out of range");
+	}
+	std::uint32_t record = string_table + id * STRING_RECORD_SIZE;
+	binary_ast::string_ref ret;
+	ret.size = read_u32(record + 4);
+	ret.data = get_bytes(read_u32(record), ret.size);
+	return ret;
+}
+std::uint32_t binary_ast::image::get_type_count() const {
+	return type_count;
+}
+binary_ast::type_view binary_ast::image::get_type(std::uint32_t id) const {
+	return type_view(this, id);
+}
+std::uint32_t binary_ast::image::get_type_record(std::uint32_t id) const {
+	if (id >= type_count) {
+		throw binary_ast::binary_ast_exception("Type out of range");
+	}
+	return type_table + id * TYPE_RECORD_SIZE;
+}
+std::uint32_t binary_ast::image::read_u32(std::uint32_t offset) const {
+	const char* bytes = get_bytes(offset, 4);
+	std::uint32_t value = 0;
+	for (int i = 0; i < 4; i++) {
+		value |= static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[i]))
+				<< (i * 8);
+	}
+	return value;
+}
+std::uint8_t binary_ast::image::read_u8(std::uint32_t offset) const {
+	return static_cast<std::uint8_t>(*get_bytes(offset, 1));
+}
+const char* binary_ast::image::get_bytes(std::uint32_t offset,
+		std::uint32_t size) const {
+	if (offset > this->size || size > this->size - offset) {
+		throw binary_ast::binary_ast_exception("Offset outside the AST image");
+	}
+	return data + offset;
+}
+
+std::string binary_ast::write_image(std::vector<ast::ast_node*>* tree) {
+	image_writer writer;
+	std::uint32_t roots = writer.write_ast_nodes(tree);
+	return writer.finish(roots);
+}
+bool binary_ast::write_image_file(std::vector<ast::ast_node*>* tree,
+		const std::string& path) {
+	std::string data = write_image(tree);
+	std::ofstream out(path, std::ios::binary);
+	out.write(data.data(), data.size());
+	out.close();
+	return !out.fail();
+}
+
+std::set<ast::modifier>* to_modifiers(binary_ast::node_view node) {
+	std::set<ast::modifier>* modifiers = new std::set<ast::modifier>;
+	if (node.has_modifier(ast::modifier::GLOBAL)) {
+		modifiers->insert(ast::modifier::GLOBAL);
+	}
+	return modifiers;
+}
+
+ast::expression* to_expression(binary_ast::node_view node);
+
+std::vector<ast::expression*>* to_expressions(binary_ast::node_list list) {
+	std::vector<ast::expression*>* exprs = new std::vector<ast::expression*>;
+	for (std::uint32_t i = 0, e = list.size(); i < e; i++) {
+		exprs->push_back(to_expression(list.get(i)));
+	}
+	return exprs;
+}
+
+ast::expression* to_expression(binary_ast::node_view node) {
+	if (node.is_null()) {
+		return nullptr;
+	}
+	switch (node.get_expression_kind()) {
+	case ast::expression_kind::IDENTIFIER:
+		return new ast::identifier_expression(node.get_string(0).to_string());
+	case ast::expression_kind::PARENTHESIZED:
+		return new ast::parenthesized_expression(
+				to_expression(node.get_child(0)));
+	case ast::expression_kind::CALL:
+		return new ast::call_expression(node.get_string(0).to_string(),
+				to_expressions(node.get_list(1)));
+	case ast::expression_kind::NAMESPACE:
+		return new ast::namespace_expression(node.get_string(0).to_string(),
+				to_expression(node.get_child(1)));
+	case ast::expression_kind::OPERATOR:
+		return new ast::operator_expression(to_expression(node.get_child(0)),
+				node.get_string(1).to_string(), to_expression(node.get_child(2)));
+	case ast::expression_kind::UNARY_OPERATOR_LEFT:
+		return new ast::unary_operator_left_expression(
+				node.get_string(0).to_string(), to_expression(node.get_child(1)));
+	case ast::expression_kind::UNARY_OPERATOR_RIGHT:
+		return new ast::unary_operator_right_expression(
+				to_expression(node.get_child(1)), node.get_string(0).to_string());
+	case ast::expression_kind::CONST_BOOLEAN:
+		return new ast::const_boolean_expression(node.get_flags() != 0);
+	case ast::expression_kind::CONST_INTEGER:
+		if (node.get_flags() > static_cast<std::uint8_t>(ast::radix::HEX)) {
+			throw binary_ast::binary_ast_exception("Unknown radix");
+		}
+		return new ast::const_integer_expression(node.get_int(0),
+				static_cast<ast::radix>(node.get_flags()));
+	case ast::expression_kind::CONST_FLOAT:
+		return new ast::const_float_expression(node.get_float(0));
+	case ast::expression_kind::CONST_DOUBLE:
+		return new ast::const_double_expression(node.get_double(0));
+	case ast::expression_kind::CONST_STRING:
+		return new ast::const_string_expression(node.get_string(0).to_string());
+	case ast::expression_kind::CAST:
+		return new ast::cast_expression(node.get_type(0).to_type_ref(),
+				to_expression(node.get_child(1)));
+	case ast::expression_kind::ARRAY:
+		return new ast::array_expression(to_expression(node.get_child(0)),
+				to_expressions(node.get_list(1)));
+	}
+	return nullptr;
+}
+
+ast::statement* to_statement(binary_ast::node_view node) {
+	if (node.is_null()) {
+		return nullptr;
+	}
+	switch (node.get_statement_kind()) {
+	case ast::statement_kind::BLOCK: {
+		binary_ast::node_list list = node.get_list(0);
+		std::vector<ast::statement*>* children =
+				new std::vector<ast::statement*>;
+		for (std::uint32_t i = 0, e = list.size(); i < e; i++) {
+			children->push_back(to_statement(list.get(i)));
+		}
+		return new ast::block_statement(children);
+	}
+	case ast::statement_kind::VARIABLE_DECLARATION:
+		return new ast::variable_declaration_statement(to_modifiers(node),
+				node.get_type(0).to_type_ref(), node.get_string(1).to_string(),
+				to_expression(node.get_child(2)));
+	case ast::statement_kind::ASSIGNMENT:
+		return new ast::assignment_statement(to_expression(node.get_child(0)),
+				node.get_string(1).to_string(), to_expression(node.get_child(2)));
+	case ast::statement_kind::IF:
+		return new ast::if_statement(to_expression(node.get_child(0)),
+				to_statement(node.get_child(1)), to_statement(node.get_child(2)));
+	case ast::statement_kind::WHILE:
+		return new ast::while_statement(to_expression(node.get_child(0)),
+				to_statement(node.get_child(1)));
+	case ast::statement_kind::DO_WHILE:
+		return new ast::do_while_statement(to_statement(node.get_child(0)),
+				to_expression(node.get_child(1)));
+	case ast::statement_kind::FOR:
+		return new ast::for_statement(to_statement(node.get_child(0)),
+				to_expression(node.get_child(1)), to_statement(node.get_child(2)),
+				to_statement(node.get_child(3)));
+	case ast::statement_kind::FOREVER:
+		return new ast::forever_statement(to_statement(node.get_child(0)));
+	case ast::statement_kind::REPEAT:
+		return new ast::repeat_statement(to_expression(node.get_child(0)),
+				to_statement(node.get_child(1)));
+	case ast::statement_kind::RETURN:
+		return new ast::return_statement(to_expression(node.get_child(0)));
+	case ast::statement_kind::EXPRESSION:
+		return new ast::expression_statement(to_expression(node.get_child(0)));
+	}
+	return nullptr;
+}
+
+std::vector<ast::ast_node*>* to_ast_nodes(binary_ast::node_list list);
+
+ast::ast_node* to_ast_node(binary_ast::node_view node) {
+	switch (node.get_ast_node_kind()) {
+	case ast::ast_node_kind::MODULE:
+		return new ast::module_node(node.get_string(0).to_string(),
+				to_ast_nodes(node.get_list(1)));
+	case ast::ast_node_kind::FIELD:
+		return new ast::field_node(to_modifiers(node),
+				node.get_type(0).to_type_ref(), node.get_string(1).to_string(),
+				to_expression(node.get_child(2)));
+	case ast::ast_node_kind::FUNCTION: {
+		binary_ast::node_list list = node.get_list(2);
+		std::vector<ast::field_node*>* parameters =
+				new std::vector<ast::field_node*>;
+		for (std::uint32_t i = 0, e = list.size(); i < e; i++) {
+			binary_ast::node_view param = list.get(i);
+			if (param.get_ast_node_kind() != ast::ast_node_kind::FIELD) {
+				throw binary_ast::binary_ast_exception(
+						"Function parameter is not a field");
+			}
+			parameters->push_back(static_cast<ast::field_node*>(to_ast_node(param)));
+		}
+		return new ast::function_node(to_modifiers(node),
+				node.get_type(0).to_type_ref(), node.get_string(1).to_string(),
+				parameters, to_statement(node.get_child(3)));
+	}
+	}
+	return nullptr;
+}
+
+std::vector<ast::ast_node*>* to_ast_nodes(binary_ast::node_list list) {
+	std::vector<ast::ast_node*>* nodes = new std::vector<ast::ast_node*>;
+	for (std::uint32_t i = 0, e = list.size(); i < e; i++) {
+		nodes->push_back(to_ast_node(list.get(i)));
+	}
+	return nodes;
+}
+
+std::vector<ast::ast_node*>* binary_ast::to_tree(binary_ast::image* img) {
+	return to_ast_nodes(img->get_roots());
+}
@@ -0,0 +1,184 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef BINARY_AST_HPP_
+#define BINARY_AST_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "crosslang_ast.hpp"
+
+// A binary form of a tree which can be mapped straight into memory and walked
+// without creating any AST objects. Everything is little-endian and 4-byte
+// aligned, and every reference is an offset from the start of the image, so
+// an image can be mapped at any address.
+//
+// The image starts with a header:
+//   magic, version, image size, string count, string table offset,
+//   type count, type table offset, root list offset
+// The string table has an (offset, length) pair for each string, and the type
+// table has a (name string, namespace list, generic argument list) triple for
+// each type, where the namespace list holds string numbers and the generic
+// argument list holds type numbers. A list is a count followed by that many
+// 4-byte entries. Generic arguments always come before the type they're in,
+// and children always come before their parents.
+//
+// Every node is a record with a 4-byte tag (category, kind, flags, slot count)
+// followed by its slots. An offset of 0 is a missing optional child. The
+// slots for each kind of node are:
+//   identifier: identifier string
+//   parenthesized: child
+//   call: name string, operand list
+//   namespace: namespace string, operand
+//   operator: lhs, operator string, rhs
+//   unary operator left and right: operator string, operand
+//   const boolean: no slots, the value is the flags
+//   const integer: value, and the radix is the flags
+//   const float: value's bits
+//   const double: low 32 bits, high 32 bits
+//   const string: value string
+//   cast: target type, operand
+//   array: target, index list
+//   block: child list
+//   variable declaration: type, name string, initializer
+//   assignment: lhs, operator string, rhs
+//   if: condition, if clause, else clause
+//   while: condition, while clause
+//   do while: do while clause, condition
+//   for: initializer, condition, increment, for clause
+//   forever: forever clause
+//   repeat: times, repeat clause
+//   return: operand
+//   expression: expression
+//   module: namespace string, child list
+//   field: type, name string, initializer
+//   function: return type, name string, parameter list, body
+// For variable declarations, fields and functions, the flags have a bit set
+// for each modifier.
+namespace binary_ast {
+
+const std::uint32_t MAGIC = 0x54534158; // "XAST"
+const std::uint32_t VERSION = 1;
+
+enum class node_category {
+	EXPRESSION = 1, STATEMENT = 2, AST_NODE = 3
+};
+
+class binary_ast_exception: public std::exception {
+	const char* description;
+public:
+	binary_ast_exception(const char* description);
+	const char* what();
+};
+
+// a string inside an image, which isn't null terminated
+struct string_ref {
+	const char* data;
+	std::uint32_t size;
+	std::string to_string();
+	bool equals(const std::string& other);
+};
+
+class image;
+class node_list;
+
+class type_view {
+	const image* img;
+	std::uint32_t id;
+	std::uint32_t offset;
+public:
+	type_view(const image* img, std::uint32_t id);
+	string_ref get_type_name();
+	std::uint32_t get_namespace_count();
+	string_ref get_namespace(std::uint32_t i);
+	std::uint32_t get_generic_arg_count();
+	type_view get_generic_arg(std::uint32_t i);
+	ast::type_ref to_type_ref();
+};
+
+class node_view {
+	const image* img;
+	std::uint32_t offset;
+public:
+	node_view(const image* img, std::uint32_t offset);
+	// true for a missing optional child
+	bool is_null();
+	node_category get_category();
+	ast::expression_kind get_expression_kind();
+	ast::statement_kind get_statement_kind();
+	ast::ast_node_kind get_ast_node_kind();
+	std::uint8_t get_flags();
+	std::uint8_t get_slot_count();
+	std::uint32_t get_slot(int slot);
+	node_view get_child(int slot);
+	node_list get_list(int slot);
+	string_ref get_string(int slot);
+	type_view get_type(int slot);
+	std::int32_t get_int(int slot);
+	float get_float(int slot);
+	double get_double(int slot);
+	bool has_modifier(ast::modifier mod);
+};
+
+class node_list {
+	const image* img;
+	std::uint32_t offset;
+public:
+	node_list(const image* img, std::uint32_t offset);
+	std::uint32_t size();
+	node_view get(std::uint32_t i);
+};
+
+// Reads an image in memory. Everything read from it is checked to be inside
+// the image, so a broken image throws a binary_ast_exception rather than
+// reading past the end.
+class image {
+	const char* data;
+	std::uint32_t size;
+	void* mapping = nullptr;
+	std::size_t mapping_size = 0;
+	std::uint32_t string_count;
+	std::uint32_t string_table;
+	std::uint32_t type_count;
+	std::uint32_t type_table;
+	std::uint32_t roots;
+public:
+	// the data isn't copied, so it has to outlive the image
+	image(const char* data, std::size_t size);
+	~image();
+	// maps the file into memory. Throws a binary_ast_exception if it can't be
+	// mapped or isn't an image of the right version
+	static image* map_file(const std::string& path);
+	// the same, for an image which starts part way into the file and goes on
+	// to the end of it
+	static image* map_file(const std::string& path, std::size_t offset);
+	node_list get_roots() const;
+	std::uint32_t get_string_count() const;
+	string_ref get_string(std::uint32_t id) const;
+	std::uint32_t get_type_count() const;
+	type_view get_type(std::uint32_t id) const;
+	std::uint32_t get_type_record(std::uint32_t id) const;
+	std::uint32_t read_u32(std::uint32_t offset) const;
+	std::uint8_t read_u8(std::uint32_t offset) const;
+	const char* get_bytes(std::uint32_t offset, std::uint32_t size) const;
+private:
+	void read_header();
+};
+
+// creates the image of a tree. Offsets are 32 bits, so a tree whose image
+// would be 4GB or more throws a binary_ast_exception
+std::string write_image(std::vector<ast::ast_node*>* tree);
+// returns false if the file couldn't be written
+bool write_image_file(std::vector<ast::ast_node*>* tree,
+		const std::string& path);
+
+// creates ordinary AST objects from an image, for code which needs to change
+// the tree
+std::vector<ast::ast_node*>* to_tree(image* img);
+
+}
+
+#endif /* BINARY_AST_HPP_ */
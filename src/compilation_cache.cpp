@@ -0,0 +1,152 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "compilation_cache.hpp"
+#include "serializer.hpp"
+#include "version.hpp"
+
+const std::int32_t ENTRY_MAGIC = 0x434c4358; // "XCLC"
+// the layout of an entry, which is separate from the compiler version since
+// the layout can stay the same when the compiler changes
+const std::int32_t ENTRY_FORMAT_VERSION = 3;
+
+const std::uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const std::uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+std::uint64_t fnv_1a(std::uint64_t hash, const char* data, std::size_t size) {
+	for (std::size_t i = 0; i < size; i++) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+std::uint64_t cache::hash_content(const std::string& text) {
+	return fnv_1a(FNV_OFFSET_BASIS, text.data(), text.size());
+}
+
+cache::cache_entry::~cache_entry() {
+	delete image;
+}
+
+std::vector<ast::ast_node*>* cache::get_tree(cache::cache_entry& entry) {
+	if (entry.tree != nullptr || entry.image == nullptr) {
+		return entry.tree;
+	}
+	try {
+		entry.tree = binary_ast::to_tree(entry.image);
+	} catch (binary_ast::binary_ast_exception& e) {
+		return nullptr;
+	}
+	// the tree doesn't point into the image
+	delete entry.image;
+	entry.image = nullptr;
+	return entry.tree;
+}
+
+void make_directories(const std::string& path) {
+	for (std::string::size_type i = 1; i <= path.size(); i++) {
+		if (i == path.size() || path[i] == '/') {
+			// it doesn't matter if it already exists
+			mkdir(path.substr(0, i).c_str(), 0777);
+		}
+	}
+}
+
+cache::compilation_cache::compilation_cache(std::string directory) :
+		directory(directory) {
+	make_directories(directory);
+}
+std::string cache::compilation_cache::get_entry_path(std::uint64_t key) {
+	std::ostringstream path;
+	path << directory << "/" << std::hex << key << ".xlc";
+	return path.str();
+}
+bool cache::compilation_cache::load(const std::string& text,
+		cache::cache_entry& entry) {
+	entry.content_hash = hash_content(text);
+	entry.text_size = text.size();
+	entry.key = fnv_1a(entry.content_hash, CROSSLANG_VERSION,
+			std::char_traits<char>::length(CROSSLANG_VERSION));
+	std::string path = get_entry_path(entry.key);
+	std::ifstream in(path, std::ios::binary);
+	if (!in.good()) {
+		return false;
+	}
+	serializer::binary_reader reader(in);
+	try {
+		// the key could collide, so check it really is the same file
+		if (reader.read_int() != ENTRY_MAGIC
+				|| reader.read_int() != ENTRY_FORMAT_VERSION
+				|| reader.read_string() != CROSSLANG_VERSION
+				|| reader.read_long() != entry.text_size
+				|| reader.read_long()
+						!= static_cast<std::int64_t>(entry.content_hash)) {
+			return false;
+		}
+		serializer::read_tokens(reader, entry.tokens);
+		serializer::read_line_breaks(reader, entry.line_breaks);
+		entry.index = serializer::read_index(reader);
+		// the rest of the file is the tree's image, which is mapped rather
+		// than read, since most builds never look at a cached tree
+		std::streamoff image_start = in.tellg();
+		if (image_start > 0) {
+			entry.image = binary_ast::image::map_file(path, image_start);
+		}
+	} catch (serializer::serializer_exception& e) {
+		// a broken entry is just treated as a missing one
+	} catch (binary_ast::binary_ast_exception& e) {
+	}
+	if (entry.index == nullptr || entry.image == nullptr) {
+		entry.tokens.clear();
+		entry.line_breaks.clear();
+		delete entry.index;
+		entry.index = nullptr;
+		return false;
+	}
+	return true;
+}
+bool cache::compilation_cache::store(cache::cache_entry& entry) {
+	std::string image;
+	try {
+		image = binary_ast::write_image(entry.tree);
+	} catch (binary_ast::binary_ast_exception& e) {
+		// the tree is too big for an image
+		return false;
+	}
+	std::string path = get_entry_path(entry.key);
+	// write to a file nobody else can be writing to, then move it into place
+	// all at once, so a reader never sees half an entry
+	std::ostringstream temp_path;
+	temp_path << path << "." << getpid() << "."
+			<< std::hash<std::thread::id>()(std::this_thread::get_id())
+			<< ".tmp";
+	std::ofstream out(temp_path.str(), std::ios::binary);
+	if (!out.good()) {
+		return false;
+	}
+	serializer::binary_writer writer(out);
+	writer.write_int(ENTRY_MAGIC);
+	writer.write_int(ENTRY_FORMAT_VERSION);
+	writer.write_string(CROSSLANG_VERSION);
+	writer.write_long(entry.text_size);
+	writer.write_long(entry.content_hash);
+	serializer::write_tokens(writer, entry.tokens);
+	serializer::write_line_breaks(writer, entry.line_breaks);
+	serializer::write_index(writer, entry.index);
+	out.write(image.data(), image.size());
+	out.close();
+	if (out.fail() || std::rename(temp_path.str().c_str(), path.c_str()) != 0) {
+		std::remove(temp_path.str().c_str());
+		return false;
+	}
+	return true;
+}
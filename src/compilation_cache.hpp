@@ -0,0 +1,66 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef COMPILATION_CACHE_HPP_
+#define COMPILATION_CACHE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "binary_ast.hpp"
+#include "crosslang_ast.hpp"
+#include "indexer.hpp"
+#include "tokenizer.hpp"
+
+namespace cache {
+
+// everything the front end produces for one file. The tree has already been
+// through the parser's post-processing, and the index is what the file adds
+// to the dictionary
+struct cache_entry {
+	// these are filled in by compilation_cache::load()
+	std::uint64_t key = 0;
+	std::uint64_t content_hash = 0;
+	std::int64_t text_size = 0;
+	std::vector<tokenizer::token> tokens;
+	std::vector<std::int64_t> line_breaks;
+	std::vector<ast::ast_node*>* tree = nullptr;
+	indexer::index* index = nullptr;
+	// a loaded entry leaves its tree in the entry file, mapped into memory,
+	// and the tree is only made by get_tree() if something asks for it
+	binary_ast::image* image = nullptr;
+	cache_entry() = default;
+	cache_entry(const cache_entry&) = delete;
+	cache_entry& operator=(const cache_entry&) = delete;
+	~cache_entry();
+};
+
+// makes the tree of a loaded entry from its image, the first time it's asked
+// for. Returns nullptr if the image turns out to be broken
+std::vector<ast::ast_node*>* get_tree(cache_entry& entry);
+
+// FNV-1a, which is fast and good enough to tell files apart
+std::uint64_t hash_content(const std::string& text);
+
+// A directory holding one entry per file contents, keyed by the hash of the
+// contents and the compiler version. Entries are never changed once they're
+// written, so several compilers can share a cache directory.
+class compilation_cache {
+	std::string directory;
+public:
+	// the directory is created if it doesn't exist yet
+	compilation_cache(std::string directory);
+	// sets the entry's key and content hash for the given file contents,
+	// then fills in the rest of it and returns true if there's a usable entry
+	// in the cache. If not, the rest can be filled in and the entry stored
+	bool load(const std::string& text, cache_entry& entry);
+	// returns false if the entry couldn't be written, which is harmless
+	bool store(cache_entry& entry);
+private:
+	std::string get_entry_path(std::uint64_t key);
+};
+
+}
+
+#endif /* COMPILATION_CACHE_HPP_ */
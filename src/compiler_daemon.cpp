@@ -0,0 +1,247 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "compiler_daemon.hpp"
+#include "errorcodes.hpp"
+#include "incremental_build.hpp"
+
+bool send_all(int fd, const char* data, std::size_t size) {
+	while (size > 0) {
+		// a client going away mustn't kill the daemon with SIGPIPE
+		ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+		if (sent <= 0) {
+			return false;
+		}
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+bool receive_all(int fd, char* data, std::size_t size) {
+	while (size > 0) {
+		ssize_t received = recv(fd, data, size, 0);
+		if (received <= 0) {
+			return false;
+		}
+		data += received;
+		size -= received;
+	}
+	return true;
+}
+bool send_int(int fd, std::int32_t value) {
+	char bytes[4];
+	for (int i = 0; i < 4; i++) {
+		bytes[i] = static_cast<std::uint32_t>(value) >> (i * 8);
+	}
+	return send_all(fd, bytes, 4);
+}
+bool receive_int(int fd, std::int32_t& value) {
+	unsigned char bytes[4];
+	if (!receive_all(fd, reinterpret_cast<char*>(bytes), 4)) {
+		return false;
+	}
+	std::uint32_t result = 0;
+	for (int i = 0; i < 4; i++) {
+		result |= static_cast<std::uint32_t>(bytes[i]) << (i * 8);
+	}
+	value = result;
+	return true;
+}
+bool send_string(int fd, const std::string& str) {
+	return send_int(fd, str.size()) && send_all(fd, str.data(), str.size());
+}
+bool receive_string(int fd, std::string& str) {
+	std::int32_t size;
+	if (!receive_int(fd, size) || size < 0) {
+		return false;
+	}
+	str.resize(size);
+	return size == 0 || receive_all(fd, &str[0], size);
+}
+
+// returns -1 if the path is too long for a socket address
+int make_address(const std::string& socket_path, sockaddr_un& address) {
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		return -1;
+	}
+	std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+	return 0;
+}
+
+// returns -1 if the daemon isn't there, with errno saying why
+int connect_to_daemon(const std::string& socket_path) {
+	sockaddr_un address;
+	if (make_address(socket_path, address) != 0) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+			!= 0) {
+		int error = errno;
+		close(fd);
+		errno = error;
+		return -1;
+	}
+	return fd;
+}
+
+// a daemon which didn't stop properly leaves its socket behind, with nothing
+// listening on it. Returns false if another daemon is still listening
+bool remove_stale_socket(const std::string& socket_path) {
+	int fd = connect_to_daemon(socket_path);
+	if (fd >= 0) {
+		close(fd);
+		return false;
+	}
+	// anything else at the path, such as a file which isn't a socket, is
+	// left alone for bind() to fail on
+	struct stat info;
+	if (errno == ECONNREFUSED && lstat(socket_path.c_str(), &info) == 0
+			&& S_ISSOCK(info.st_mode)) {
+		unlink(socket_path.c_str());
+	}
+	return true;
+}
+
+// a client which stops sending or reading halfway through a request is
+// given up on after this long, so it can't hold up the clients after it
+bool set_client_timeout(int client) {
+	timeval timeout;
+	timeout.tv_sec = compiler_daemon::CLIENT_TIMEOUT_SECONDS;
+	timeout.tv_usec = 0;
+	return setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+			sizeof(timeout)) == 0
+			&& setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+					sizeof(timeout)) == 0;
+}
+
+// handles one connection. Returns false if the daemon should stop
+bool serve(int client, incremental::build_state& state) {
+	std::int32_t kind;
+	if (!receive_int(client, kind)) {
+		return true;
+	}
+	if (kind == compiler_daemon::REQUEST_STOP) {
+		send_int(client, SUCCESS);
+		return false;
+	}
+	std::string directory;
+	std::int32_t count;
+	if (kind != compiler_daemon::REQUEST_COMPILE
+			|| !receive_string(client, directory) || !receive_int(client, count)
+			|| count < 0) {
+		return true;
+	}
+	std::vector<std::string> names(count);
+	for (std::string& name : names) {
+		if (!receive_string(client, name)) {
+			return true;
+		}
+	}
+	// whatever the build prints goes back to the client
+	std::ostringstream errors;
+	int exit_code = state.compile(directory, names, errors);
+	if (send_int(client, exit_code)) {
+		send_string(client, errors.str());
+	}
+	return true;
+}
+
+int compiler_daemon::run_daemon(const std::string& socket_path,
+		int thread_count) {
+	sockaddr_un address;
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || make_address(socket_path, address) != 0) {
+		std::cerr << "Failed to create socket " << socket_path << std::endl;
+		return ERR_DAEMON_FAILED;
+	}
+	if (!remove_stale_socket(socket_path)) {
+		std::cerr << "A daemon is already running on socket " << socket_path
+				<< std::endl;
+		close(server);
+		return ERR_DAEMON_FAILED;
+	}
+	if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+			!= 0 || listen(server, 16) != 0) {
+		std::cerr << "Failed to listen on socket " << socket_path << std::endl;
+		close(server);
+		return ERR_DAEMON_FAILED;
+	}
+	incremental::build_state state(thread_count);
+	bool running = true;
+	while (running) {
+		int client = accept(server, nullptr, nullptr);
+		if (client < 0) {
+			continue;
+		}
+		if (set_client_timeout(client)) {
+			running = serve(client, state);
+		}
+		close(client);
+	}
+	close(server);
+	unlink(socket_path.c_str());
+	return SUCCESS;
+}
+
+int compiler_daemon::run_client(const std::string& socket_path,
+		std::vector<std::string>& files) {
+	int fd = connect_to_daemon(socket_path);
+	if (fd < 0) {
+		std::cerr << "Failed to connect to daemon at " << socket_path
+				<< std::endl;
+		return ERR_DAEMON_FAILED;
+	}
+	// the daemon's working directory isn't this one
+	char cwd[4096];
+	std::string directory;
+	if (getcwd(cwd, sizeof(cwd)) != nullptr) {
+		directory = cwd;
+	}
+	bool sent = send_int(fd, REQUEST_COMPILE) && send_string(fd, directory)
+			&& send_int(fd, files.size());
+	for (int i = 0, e = files.size(); sent && i < e; i++) {
+		sent = send_string(fd, files[i]);
+	}
+	std::int32_t exit_code;
+	std::string errors;
+	if (!sent || !receive_int(fd, exit_code) || !receive_string(fd, errors)) {
+		std::cerr << "Lost connection to daemon at " << socket_path
+				<< std::endl;
+		close(fd);
+		return ERR_DAEMON_FAILED;
+	}
+	close(fd);
+	std::cerr << errors;
+	return exit_code;
+}
+
+int compiler_daemon::stop_daemon(const std::string& socket_path) {
+	int fd = connect_to_daemon(socket_path);
+	if (fd < 0) {
+		std::cerr << "Failed to connect to daemon at " << socket_path
+				<< std::endl;
+		return ERR_DAEMON_FAILED;
+	}
+	std::int32_t reply;
+	bool stopped = send_int(fd, REQUEST_STOP) && receive_int(fd, reply);
+	close(fd);
+	return stopped ? SUCCESS : ERR_DAEMON_FAILED;
+}
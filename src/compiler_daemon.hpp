@@ -0,0 +1,42 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef COMPILER_DAEMON_HPP_
+#define COMPILER_DAEMON_HPP_
+
+#include <string>
+#include <vector>
+
+// A compiler which stays running between builds, listening on a Unix domain
+// socket. It keeps the tree of every file it has seen and the dictionary of
+// the last build, so a build only has to parse and index the files which
+// have changed. A file is checked by its modification time and size first,
+// and by the hash of its contents if they've changed.
+//
+// Every message is little-endian, and strings are a 4-byte length followed by
+// that many bytes. A request is a 4-byte request kind, followed for a compile
+// request by the client's working directory, the number of files and then
+// each file name. The reply to a compile request is the exit code, followed
+// by what would have been printed to standard error as a string.
+namespace compiler_daemon {
+
+const int REQUEST_COMPILE = 1;
+const int REQUEST_STOP = 2;
+// requests are served one at a time, so a client which goes quiet for this
+// long is disconnected
+const int CLIENT_TIMEOUT_SECONDS = 10;
+
+// serves requests until it's asked to stop. thread_count is the size of the
+// pool which changed files are parsed on. Fails if another daemon is
+// listening on the socket
+int run_daemon(const std::string& socket_path, int thread_count);
+// asks the daemon to compile the files, and prints what it says went wrong.
+// Returns the exit code of the build
+int run_client(const std::string& socket_path,
+		std::vector<std::string>& files);
+int stop_daemon(const std::string& socket_path);
+
+}
+
+#endif /* COMPILER_DAEMON_HPP_ */
@@ -0,0 +1,380 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <climits>
+#include <cmath>
+#include <string>
+#include "constant_folder.hpp"
+
+enum class constant_kind {
+	BOOLEAN, INTEGER, FLOAT, DOUBLE, STRING
+};
+
+struct constant {
+	constant_kind kind;
+	bool bool_value;
+	// integers are widened to 64 bits so we can tell when they overflow
+	long long int_value;
+	double double_value;
+	std::string string_value;
+};
+
+bool get_constant(ast::expression* expr, constant& value) {
+	switch (expr->get_expression_kind()) {
+	case ast::expression_kind::CONST_BOOLEAN:
+		value.kind = constant_kind::BOOLEAN;
+		value.bool_value =
+				static_cast<ast::const_boolean_expression*>(expr)->get_value();
+		return true;
+	case ast::expression_kind::CONST_INTEGER:
+		value.kind = constant_kind::INTEGER;
+		value.int_value =
+				static_cast<ast::const_integer_expression*>(expr)->get_value();
+		return true;
+	case ast::expression_kind::CONST_FLOAT:
+		value.kind = constant_kind::FLOAT;
+		value.double_value =
+				static_cast<ast::const_float_expression*>(expr)->get_value();
+		return true;
+	case ast::expression_kind::CONST_DOUBLE:
+		value.kind = constant_kind::DOUBLE;
+		value.double_value =
+				static_cast<ast::const_double_expression*>(expr)->get_value();
+		return true;
+	case ast::expression_kind::CONST_STRING:
+		value.kind = constant_kind::STRING;
+		value.string_value =
+				static_cast<ast::const_string_expression*>(expr)->get_value();
+		return true;
+	default:
+		return false;
+	}
+}
+
+ast::expression* create_constant_expression(constant& value) {
+	switch (value.kind) {
+	case constant_kind::BOOLEAN:
+		return new ast::const_boolean_expression(value.bool_value);
+	case constant_kind::INTEGER:
+		return new ast::const_integer_expression(value.int_value);
+	case constant_kind::FLOAT:
+		return new ast::const_float_expression(value.double_value);
+	case constant_kind::DOUBLE:
+		return new ast::const_double_expression(value.double_value);
+	case constant_kind::STRING:
+		return new ast::const_string_expression(value.string_value);
+	}
+	return nullptr;
+}
+
+bool is_number(constant& value) {
+	return value.kind == constant_kind::INTEGER
+			|| value.kind == constant_kind::FLOAT
+			|| value.kind == constant_kind::DOUBLE;
+}
+
+double to_double(constant& value) {
+	if (value.kind == constant_kind::INTEGER) {
+		return value.int_value;
+	} else {
+		return value.double_value;
+	}
+}
+
+bool make_int(long long result, constant& value) {
+	// an int which overflows wraps around in Java but is undefined in C++, so
+	// leave it for the target language to deal with
+	if (result < INT_MIN || result > INT_MAX) {
+		return false;
+	}
+	value.kind = constant_kind::INTEGER;
+	value.int_value = result;
+	return true;
+}
+
+bool make_floating(constant_kind kind, double result, constant& value) {
+	if (kind == constant_kind::FLOAT) {
+		result = static_cast<float>(result);
+	}
+	// there's no way to write infinity or NaN as a literal
+	if (!std::isfinite(result)) {
+		return false;
+	}
+	value.kind = kind;
+	value.double_value = result;
+	return true;
+}
+
+bool make_bool(bool result, constant& value) {
+	value.kind = constant_kind::BOOLEAN;
+	value.bool_value = result;
+	return true;
+}
+
+bool fold_int_operator(long long lhs, std::string& op, long long rhs,
+		constant& value) {
+	if (op == "+") {
+		return make_int(lhs + rhs, value);
+	} else if (op == "-") {
+		return make_int(lhs - rhs, value);
+	} else if (op == "*") {
+		return make_int(lhs * rhs, value);
+	} else if (op == "/") {
+		return rhs != 0 && make_int(lhs / rhs, value);
+	} else if (op == "%") {
+		return rhs != 0 && make_int(lhs % rhs, value);
+	} else if (op == "&") {
+		return make_int(lhs & rhs, value);
+	} else if (op == "|") {
+		return make_int(lhs | rhs, value);
+	} else if (op == "^") {
+		return make_int(lhs ^ rhs, value);
+	} else if (op == "<<" || op == ">>") {
+		// shifting negative numbers or by more than the width of an int is
+		// not the same in every language
+		if (lhs < 0 || rhs < 0 || rhs >= 32) {
+			return false;
+		}
+		return make_int(op == "<<" ? lhs << rhs : lhs >> rhs, value);
+	} else if (op == "==") {
+		return make_bool(lhs == rhs, value);
+	} else if (op == "!=") {
+		return make_bool(lhs != rhs, value);
+	} else if (op == "<") {
+		return make_bool(lhs < rhs, value);
+	} else if (op == "<=") {
+		return make_bool(lhs <= rhs, value);
+	} else if (op == ">") {
+		return make_bool(lhs > rhs, value);
+	} else if (op == ">=") {
+		return make_bool(lhs >= rhs, value);
+	}
+	return false;
+}
+
+bool fold_floating_operator(constant_kind kind, double lhs, std::string& op,
+		double rhs, constant& value) {
+	if (op == "+") {
+		return make_floating(kind, lhs + rhs, value);
+	} else if (op == "-") {
+		return make_floating(kind, lhs - rhs, value);
+	} else if (op == "*") {
+		return make_floating(kind, lhs * rhs, value);
+	} else if (op == "/") {
+		return make_floating(kind, lhs / rhs, value);
+	} else if (op == "==") {
+		return make_bool(lhs == rhs, value);
+	} else if (op == "!=") {
+		return make_bool(lhs != rhs, value);
+	} else if (op == "<") {
+		return make_bool(lhs < rhs, value);
+	} else if (op == "<=") {
+		return make_bool(lhs <= rhs, value);
+	} else if (op == ">") {
+		return make_bool(lhs > rhs, value);
+	} else if (op == ">=") {
+		return make_bool(lhs >= rhs, value);
+	}
+	return false;
+}
+
+bool fold_bool_operator(bool lhs, std::string& op, bool rhs, constant& value) {
+	if (op == "&&") {
+		return make_bool(lhs && rhs, value);
+	} else if (op == "||") {
+		return make_bool(lhs || rhs, value);
+	} else if (op == "^^" || op == "!=") {
+		return make_bool(lhs != rhs, value);
+	} else if (op == "==") {
+		return make_bool(lhs == rhs, value);
+	}
+	return false;
+}
+
+bool fold_operator(constant& lhs, std::string op, constant& rhs,
+		constant& value) {
+	if (lhs.kind == constant_kind::INTEGER
+			&& rhs.kind == constant_kind::INTEGER) {
+		return fold_int_operator(lhs.int_value, op, rhs.int_value, value);
+	}
+	if (is_number(lhs) && is_number(rhs)) {
+		constant_kind kind =
+				lhs.kind == constant_kind::DOUBLE
+						|| rhs.kind == constant_kind::DOUBLE ?
+						constant_kind::DOUBLE : constant_kind::FLOAT;
+		return fold_floating_operator(kind, to_double(lhs), op, to_double(rhs),
+				value);
+	}
+	if (lhs.kind == constant_kind::BOOLEAN
+			&& rhs.kind == constant_kind::BOOLEAN) {
+		return fold_bool_operator(lhs.bool_value, op, rhs.bool_value, value);
+	}
+	if (lhs.kind == constant_kind::STRING && rhs.kind == constant_kind::STRING
+			&& op == "+") {
+		value.kind = constant_kind::STRING;
+		value.string_value = lhs.string_value + rhs.string_value;
+		return true;
+	}
+	// string comparison is by reference in some languages, and mixing types
+	// means different things everywhere
+	return false;
+}
+
+bool fold_unary_operator(std::string op, constant& operand, constant& value) {
+	if (operand.kind == constant_kind::INTEGER) {
+		if (op == "+") {
+			return make_int(operand.int_value, value);
+		} else if (op == "-") {
+			return make_int(-operand.int_value, value);
+		} else if (op == "~") {
+			return make_int(~operand.int_value, value);
+		}
+	} else if (is_number(operand)) {
+		if (op == "+") {
+			return make_floating(operand.kind, operand.double_value, value);
+		} else if (op == "-") {
+			return make_floating(operand.kind, -operand.double_value, value);
+		}
+	} else if (operand.kind == constant_kind::BOOLEAN && op == "!") {
+		return make_bool(!operand.bool_value, value);
+	}
+	return false;
+}
+
+bool fold_expression(ast::expression* expr, constant& value) {
+	switch (expr->get_expression_kind()) {
+	case ast::expression_kind::PARENTHESIZED: {
+		ast::parenthesized_expression* paren =
+				static_cast<ast::parenthesized_expression*>(expr);
+		return get_constant(paren->get_child(), value);
+	}
+	case ast::expression_kind::OPERATOR: {
+		ast::operator_expression* op =
+				static_cast<ast::operator_expression*>(expr);
+		constant lhs, rhs;
+		bool lhs_constant = get_constant(op->get_lhs(), lhs);
+		bool rhs_constant = get_constant(op->get_rhs(), rhs);
+		if (lhs_constant && rhs_constant) {
+			return fold_operator(lhs, op->get_operator(), rhs, value);
+		}
+		// the rhs of a short-circuiting operator is never evaluated if the
+		// lhs decides the result, so it doesn't matter what it is
+		if (lhs_constant && lhs.kind == constant_kind::BOOLEAN) {
+			if ((op->get_operator() == "&&" && !lhs.bool_value)
+					|| (op->get_operator() == "||" && lhs.bool_value)) {
+				return make_bool(lhs.bool_value, value);
+			}
+		}
+		return false;
+	}
+	case ast::expression_kind::UNARY_OPERATOR_LEFT: {
+		ast::unary_operator_left_expression* op =
+				static_cast<ast::unary_operator_left_expression*>(expr);
+		constant operand;
+		return get_constant(op->get_operand(), operand)
+				&& fold_unary_operator(op->get_operator(), operand, value);
+	}
+	default:
+		return false;
+	}
+}
+
+bool get_constant_bool(ast::expression* expr, bool& value) {
+	constant c;
+	if (expr != nullptr && get_constant(expr, c)
+			&& c.kind == constant_kind::BOOLEAN) {
+		value = c.bool_value;
+		return true;
+	}
+	return false;
+}
+
+ast::statement* create_empty_statement() {
+	return new ast::block_statement(new std::vector<ast::statement*>);
+}
+
+class constant_folding_pass: public passes::pass {
+public:
+	std::string get_name() {
+		return "constant folding";
+	}
+	int get_node_kinds() {
+		return passes::STATEMENTS | passes::EXPRESSIONS;
+	}
+	passes::traversal_order get_traversal_order() {
+		return passes::traversal_order::POST_ORDER;
+	}
+	bool modifies_tree() {
+		return true;
+	}
+	void leave_expression(ast::expression*& expr) {
+		// children have already been folded, so we only need to look one
+		// level down
+		constant value;
+		if (!fold_expression(expr, value)) {
+			return;
+		}
+		ast::expression* folded = create_constant_expression(value);
+		delete expr;
+		expr = folded;
+	}
+	void leave_statement(ast::statement*& stmt) {
+		ast::statement* replacement = nullptr;
+		bool condition;
+		switch (stmt->get_statement_kind()) {
+		case ast::statement_kind::IF: {
+			ast::if_statement* if_stmt = static_cast<ast::if_statement*>(stmt);
+			if (!get_constant_bool(if_stmt->get_condition(), condition)) {
+				return;
+			}
+			if (condition) {
+				replacement = if_stmt->get_if_clause();
+				if_stmt->set_if_clause(nullptr);
+			} else if (if_stmt->has_else_clause()) {
+				replacement = if_stmt->get_else_clause();
+				if_stmt->set_else_clause(nullptr);
+			} else {
+				replacement = create_empty_statement();
+			}
+			break;
+		}
+		case ast::statement_kind::WHILE: {
+			ast::while_statement* while_stmt =
+					static_cast<ast::while_statement*>(stmt);
+			if (!get_constant_bool(while_stmt->get_condition(), condition)
+					|| condition) {
+				return;
+			}
+			replacement = create_empty_statement();
+			break;
+		}
+		case ast::statement_kind::REPEAT: {
+			ast::repeat_statement* repeat_stmt =
+					static_cast<ast::repeat_statement*>(stmt);
+			constant times;
+			if (!get_constant(repeat_stmt->get_times(), times)
+					|| times.kind != constant_kind::INTEGER
+					|| times.int_value > 0) {
+				return;
+			}
+			replacement = create_empty_statement();
+			break;
+		}
+		default:
+			return;
+		}
+		delete stmt;
+		stmt = replacement;
+	}
+};
+
+void constant_folder::add_constant_folding_pass(
+		passes::pass_manager* manager) {
+	manager->add_pass(new constant_folding_pass);
+}
+void constant_folder::fold_constants(std::vector<ast::ast_node*>* tree) {
+	passes::pass_manager manager;
+	add_constant_folding_pass(&manager);
+	manager.run(tree);
+}
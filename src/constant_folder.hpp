@@ -0,0 +1,24 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef CONSTANT_FOLDER_HPP_
+#define CONSTANT_FOLDER_HPP_
+
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "pass_manager.hpp"
+
+namespace constant_folder {
+
+// Folds operators, unary operators and parentheses whose operands are all
+// constants into a single constant, and prunes if, while and repeat
+// statements whose condition or count turns out to be constant.
+// Anything whose result would differ between the languages we compile to,
+// e.g. integer overflow or division by zero, is left alone.
+void fold_constants(std::vector<ast::ast_node*>* tree);
+void add_constant_folding_pass(passes::pass_manager* manager);
+
+}
+
+#endif /* CONSTANT_FOLDER_HPP_ */
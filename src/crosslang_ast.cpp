@@ -2,6 +2,9 @@
  *      Author: Earthcomputer
  */
 
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -54,7 +57,7 @@ bool ast::type_ref::is_long() {
 bool ast::type_ref::is_short() {
 	return namespaces->empty() && generic_args->empty() && type_name == "short";
 }
-std::string ast::type_ref::to_string() {
+std::string ast::type_ref::to_string() const {
 	std::string ret = "";
 	for (std::string& ns : *namespaces) {
 		ret += ns;
@@ -75,8 +78,19 @@ std::string ast::type_ref::to_string() {
 	}
 	return ret;
 }
-bool ast::type_ref::operator ==(ast::type_ref other) {
-	if (namespaces != other.namespaces || type_name != other.type_name) {
+std::size_t ast::type_ref::hash() const {
+	std::hash<std::string> hash_string;
+	std::size_t ret = hash_string(type_name);
+	for (std::string& ns : *namespaces) {
+		ret = ast::hash_combine(ret, hash_string(ns));
+	}
+	for (const type_ref& generic_arg : *generic_args) {
+		ret = ast::hash_combine(ret, generic_arg.hash());
+	}
+	return ret;
+}
+bool ast::type_ref::operator ==(const ast::type_ref& other) const {
+	if (*namespaces != *other.namespaces || type_name != other.type_name) {
 		return false;
 	}
 	if (generic_args->size() != other.generic_args->size()) {
@@ -89,10 +103,25 @@ bool ast::type_ref::operator ==(ast::type_ref other) {
 	}
 	return true;
 }
-bool ast::type_ref::operator !=(ast::type_ref other) {
+bool ast::type_ref::operator !=(const ast::type_ref& other) const {
 	return !operator==(other);
 }
 
+std::size_t ast::hash_combine(std::size_t seed, std::size_t value) {
+	return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+std::uint64_t get_double_bits(double value) {
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+std::size_t hash_double(double value) {
+	// hash the bits rather than the value so that 0.0 and -0.0 are different
+	return std::hash<std::uint64_t>()(get_double_bits(value));
+}
+
 ast::expression::expression(ast::expression_kind kind) :
 		kind(kind) {
 }
@@ -104,24 +133,6 @@ ast::expression_kind ast::expression::get_expression_kind() {
 bool ast::expression::is_of_expression_kind(ast::expression_kind kind) {
 	return this->kind == kind;
 }
-ast::expression* ast::expression::get_parent_expression() {
-	return parent_expression;
-}
-void ast::expression::set_parent_expression(ast::expression* parent) {
-	parent_expression = parent;
-}
-ast::statement* ast::expression::get_parent_statement() {
-	return parent_statement;
-}
-void ast::expression::set_parent_statement(ast::statement* parent) {
-	parent_statement = parent;
-}
-ast::ast_node* ast::expression::get_parent_node() {
-	return parent_node;
-}
-void ast::expression::set_parent_node(ast::ast_node* parent) {
-	parent_node = parent;
-}
 std::string ast::expression::to_string() {
 	std::cerr << "Called expression::to_string()!" << std::endl;
 	throw std::exception();
@@ -133,6 +144,60 @@ void ast::expression::accept(ast::ast_visitor* visitor) {
 	std::cerr << "Called expression::accept(ast_visitor*)!" << std::endl;
 	throw std::exception();
 }
+std::size_t ast::expression::get_structural_hash() {
+	return get_structural_hash(nullptr);
+}
+std::size_t ast::expression::get_structural_hash(
+		ast::structural_hash_cache* cache) {
+	if (cache != nullptr) {
+		ast::structural_hash_cache::iterator it = cache->find(this);
+		if (it != cache->end()) {
+			return it->second;
+		}
+	}
+	std::size_t hash = ast::hash_combine(static_cast<std::size_t>(kind),
+			hash_own_data());
+	std::vector<ast::expression**>* children = get_children();
+	hash = ast::hash_combine(hash, children->size());
+	for (ast::expression** child : *children) {
+		hash = ast::hash_combine(hash,
+				*child == nullptr ? 0 : (*child)->get_structural_hash(cache));
+	}
+	delete children;
+	if (cache != nullptr) {
+		(*cache)[this] = hash;
+	}
+	return hash;
+}
+bool ast::expression::structurally_equals(ast::expression* other) {
+	if (this == other) {
+		return true;
+	}
+	if (other == nullptr || kind != other->kind || !own_data_equals(other)) {
+		return false;
+	}
+	std::vector<ast::expression**>* children = get_children();
+	std::vector<ast::expression**>* other_children = other->get_children();
+	bool equal = children->size() == other_children->size();
+	for (int i = 0, e = children->size(); equal && i < e; i++) {
+		ast::expression* child = *(*children)[i];
+		ast::expression* other_child = *(*other_children)[i];
+		if (child == nullptr || other_child == nullptr) {
+			equal = child == other_child;
+		} else {
+			equal = child->structurally_equals(other_child);
+		}
+	}
+	delete children;
+	delete other_children;
+	return equal;
+}
+std::size_t ast::expression::hash_own_data() {
+	return 0;
+}
+bool ast::expression::own_data_equals(ast::expression* other) {
+	return true;
+}
 
 ast::identifier_expression::identifier_expression(std::string identifier) :
 		expression(ast::expression_kind::IDENTIFIER), identifier(identifier) {
@@ -149,6 +214,14 @@ std::string ast::identifier_expression::to_string() {
 void ast::identifier_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_identifier_expression(this);
 }
+std::size_t ast::identifier_expression::hash_own_data() {
+	return std::hash<std::string>()(identifier);
+}
+bool ast::identifier_expression::own_data_equals(ast::expression* other) {
+	ast::identifier_expression* o =
+			static_cast<ast::identifier_expression*>(other);
+	return identifier == o->identifier;
+}
 
 ast::parenthesized_expression::parenthesized_expression(ast::expression* child) :
 		expression(ast::expression_kind::PARENTHESIZED), child(child) {
@@ -215,6 +288,13 @@ std::vector<ast::expression**>* ast::call_expression::get_children() {
 void ast::call_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_call_expression(this);
 }
+std::size_t ast::call_expression::hash_own_data() {
+	return std::hash<std::string>()(name);
+}
+bool ast::call_expression::own_data_equals(ast::expression* other) {
+	ast::call_expression* o = static_cast<ast::call_expression*>(other);
+	return name == o->name;
+}
 
 ast::namespace_expression::namespace_expression(std::string namespace_name,
 		ast::expression* operand) :
@@ -245,6 +325,14 @@ std::vector<ast::expression**>* ast::namespace_expression::get_children() {
 void ast::namespace_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_namespace_expression(this);
 }
+std::size_t ast::namespace_expression::hash_own_data() {
+	return std::hash<std::string>()(namespace_name);
+}
+bool ast::namespace_expression::own_data_equals(ast::expression* other) {
+	ast::namespace_expression* o =
+			static_cast<ast::namespace_expression*>(other);
+	return namespace_name == o->namespace_name;
+}
 
 ast::operator_expression::operator_expression(ast::expression* lhs,
 		std::string operator_name, ast::expression* rhs) :
@@ -287,6 +375,13 @@ std::vector<ast::expression**>* ast::operator_expression::get_children() {
 void ast::operator_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_operator_expression(this);
 }
+std::size_t ast::operator_expression::hash_own_data() {
+	return std::hash<std::string>()(operator_name);
+}
+bool ast::operator_expression::own_data_equals(ast::expression* other) {
+	ast::operator_expression* o = static_cast<ast::operator_expression*>(other);
+	return operator_name == o->operator_name;
+}
 
 ast::unary_operator_left_expression::unary_operator_left_expression(
 		std::string operator_name, ast::expression* operand) :
@@ -319,6 +414,15 @@ std::vector<ast::expression**>* ast::unary_operator_left_expression::get_childre
 void ast::unary_operator_left_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_unary_operator_left_expression(this);
 }
+std::size_t ast::unary_operator_left_expression::hash_own_data() {
+	return std::hash<std::string>()(operator_name);
+}
+bool ast::unary_operator_left_expression::own_data_equals(
+		ast::expression* other) {
+	ast::unary_operator_left_expression* o =
+			static_cast<ast::unary_operator_left_expression*>(other);
+	return operator_name == o->operator_name;
+}
 
 ast::unary_operator_right_expression::unary_operator_right_expression(
 		ast::expression* operand, std::string operator_name) :
@@ -351,6 +455,15 @@ std::vector<ast::expression**>* ast::unary_operator_right_expression::get_childr
 void ast::unary_operator_right_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_unary_operator_right_expression(this);
 }
+std::size_t ast::unary_operator_right_expression::hash_own_data() {
+	return std::hash<std::string>()(operator_name);
+}
+bool ast::unary_operator_right_expression::own_data_equals(
+		ast::expression* other) {
+	ast::unary_operator_right_expression* o =
+			static_cast<ast::unary_operator_right_expression*>(other);
+	return operator_name == o->operator_name;
+}
 
 ast::const_boolean_expression::const_boolean_expression(bool value) :
 		expression(ast::expression_kind::CONST_BOOLEAN), value(value) {
@@ -374,6 +487,14 @@ std::string ast::const_boolean_expression::to_string() {
 void ast::const_boolean_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_const_boolean_expression(this);
 }
+std::size_t ast::const_boolean_expression::hash_own_data() {
+	return value ? 1 : 2;
+}
+bool ast::const_boolean_expression::own_data_equals(ast::expression* other) {
+	ast::const_boolean_expression* o =
+			static_cast<ast::const_boolean_expression*>(other);
+	return value == o->value;
+}
 
 ast::const_integer_expression::const_integer_expression(int value) :
 		expression(ast::expression_kind::CONST_INTEGER), value(value), rad(
@@ -415,6 +536,15 @@ std::string ast::const_integer_expression::to_string() {
 void ast::const_integer_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_const_integer_expression(this);
 }
+std::size_t ast::const_integer_expression::hash_own_data() {
+	return ast::hash_combine(std::hash<int>()(value),
+			static_cast<std::size_t>(rad));
+}
+bool ast::const_integer_expression::own_data_equals(ast::expression* other) {
+	ast::const_integer_expression* o =
+			static_cast<ast::const_integer_expression*>(other);
+	return value == o->value && rad == o->rad;
+}
 
 ast::const_float_expression::const_float_expression(float value) :
 		expression(ast::expression_kind::CONST_FLOAT), value(value) {
@@ -433,6 +563,15 @@ std::string ast::const_float_expression::to_string() {
 void ast::const_float_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_const_float_expression(this);
 }
+std::size_t ast::const_float_expression::hash_own_data() {
+	return hash_double(value);
+}
+bool ast::const_float_expression::own_data_equals(ast::expression* other) {
+	ast::const_float_expression* o =
+			static_cast<ast::const_float_expression*>(other);
+	// the bits are compared, for the same reason as they're hashed
+	return get_double_bits(value) == get_double_bits(o->value);
+}
 
 ast::const_double_expression::const_double_expression(double value) :
 		expression(ast::expression_kind::CONST_DOUBLE), value(value) {
@@ -451,6 +590,14 @@ std::string ast::const_double_expression::to_string() {
 void ast::const_double_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_const_double_expression(this);
 }
+std::size_t ast::const_double_expression::hash_own_data() {
+	return hash_double(value);
+}
+bool ast::const_double_expression::own_data_equals(ast::expression* other) {
+	ast::const_double_expression* o =
+			static_cast<ast::const_double_expression*>(other);
+	return get_double_bits(value) == get_double_bits(o->value);
+}
 
 ast::const_string_expression::const_string_expression(std::string value) :
 		expression(ast::expression_kind::CONST_STRING), value(value) {
@@ -467,6 +614,14 @@ std::string ast::const_string_expression::to_string() {
 void ast::const_string_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_const_string_expression(this);
 }
+std::size_t ast::const_string_expression::hash_own_data() {
+	return std::hash<std::string>()(value);
+}
+bool ast::const_string_expression::own_data_equals(ast::expression* other) {
+	ast::const_string_expression* o =
+			static_cast<ast::const_string_expression*>(other);
+	return value == o->value;
+}
 
 ast::cast_expression::cast_expression(ast::type_ref target_type,
 		ast::expression* operand) :
@@ -498,6 +653,13 @@ std::vector<ast::expression**>* ast::cast_expression::get_children() {
 void ast::cast_expression::accept(ast::ast_visitor* visitor) {
 	visitor->visit_cast_expression(this);
 }
+std::size_t ast::cast_expression::hash_own_data() {
+	return target_type.hash();
+}
+bool ast::cast_expression::own_data_equals(ast::expression* other) {
+	ast::cast_expression* o = static_cast<ast::cast_expression*>(other);
+	return target_type == o->target_type;
+}
 
 ast::array_expression::array_expression(ast::expression* target,
 		std::vector<ast::expression*>* indices) :
@@ -558,18 +720,6 @@ ast::statement_kind ast::statement::get_statement_kind() {
 bool ast::statement::is_of_statement_kind(ast::statement_kind kind) {
 	return this->kind == kind;
 }
-ast::statement* ast::statement::get_parent_statement() {
-	return parent_statement;
-}
-void ast::statement::set_parent_statement(ast::statement* parent) {
-	parent_statement = parent;
-}
-ast::ast_node* ast::statement::get_parent_node() {
-	return parent_node;
-}
-void ast::statement::set_parent_node(ast::ast_node* parent) {
-	parent_node = parent;
-}
 std::string ast::statement::to_string() {
 	std::cerr << "Called statement::to_string()!" << std::endl;
 	throw std::exception();
@@ -584,6 +734,86 @@ void ast::statement::accept(ast::ast_visitor* visitor) {
 	std::cerr << "Called statement::accept(ast_visitor*)!" << std::endl;
 	throw std::exception();
 }
+std::size_t ast::statement::get_structural_hash() {
+	return get_structural_hash(nullptr);
+}
+std::size_t ast::statement::get_structural_hash(
+		ast::structural_hash_cache* cache) {
+	if (cache != nullptr) {
+		ast::structural_hash_cache::iterator it = cache->find(this);
+		if (it != cache->end()) {
+			return it->second;
+		}
+	}
+	std::size_t hash = ast::hash_combine(static_cast<std::size_t>(kind),
+			hash_own_data());
+	std::vector<ast::expression**>* child_expressions = get_child_expressions();
+	hash = ast::hash_combine(hash, child_expressions->size());
+	for (ast::expression** child : *child_expressions) {
+		hash = ast::hash_combine(hash,
+				*child == nullptr ? 0 : (*child)->get_structural_hash(cache));
+	}
+	delete child_expressions;
+	std::vector<ast::statement**>* child_statements = get_child_statements();
+	hash = ast::hash_combine(hash, child_statements->size());
+	for (ast::statement** child : *child_statements) {
+		hash = ast::hash_combine(hash,
+				*child == nullptr ? 0 : (*child)->get_structural_hash(cache));
+	}
+	delete child_statements;
+	if (cache != nullptr) {
+		(*cache)[this] = hash;
+	}
+	return hash;
+}
+bool ast::statement::structurally_equals(ast::statement* other) {
+	if (this == other) {
+		return true;
+	}
+	if (other == nullptr || kind != other->kind || !own_data_equals(other)) {
+		return false;
+	}
+	std::vector<ast::expression**>* child_expressions = get_child_expressions();
+	std::vector<ast::expression**>* other_child_expressions =
+			other->get_child_expressions();
+	bool equal = child_expressions->size() == other_child_expressions->size();
+	for (int i = 0, e = child_expressions->size(); equal && i < e; i++) {
+		ast::expression* child = *(*child_expressions)[i];
+		ast::expression* other_child = *(*other_child_expressions)[i];
+		if (child == nullptr || other_child == nullptr) {
+			equal = child == other_child;
+		} else {
+			equal = child->structurally_equals(other_child);
+		}
+	}
+	delete child_expressions;
+	delete other_child_expressions;
+	if (!equal) {
+		return false;
+	}
+	std::vector<ast::statement**>* child_statements = get_child_statements();
+	std::vector<ast::statement**>* other_child_statements =
+			other->get_child_statements();
+	equal = child_statements->size() == other_child_statements->size();
+	for (int i = 0, e = child_statements->size(); equal && i < e; i++) {
+		ast::statement* child = *(*child_statements)[i];
+		ast::statement* other_child = *(*other_child_statements)[i];
+		if (child == nullptr || other_child == nullptr) {
+			equal = child == other_child;
+		} else {
+			equal = child->structurally_equals(other_child);
+		}
+	}
+	delete child_statements;
+	delete other_child_statements;
+	return equal;
+}
+std::size_t ast::statement::hash_own_data() {
+	return 0;
+}
+bool ast::statement::own_data_equals(ast::statement* other) {
+	return true;
+}
 
 ast::block_statement::block_statement(std::vector<ast::statement*>* children) :
 		statement(ast::statement_kind::BLOCK), children(children) {
@@ -674,6 +904,20 @@ std::vector<ast::expression**>* ast::variable_declaration_statement::get_child_e
 void ast::variable_declaration_statement::accept(ast::ast_visitor* visitor) {
 	visitor->visit_variable_declaration_statement(this);
 }
+std::size_t ast::variable_declaration_statement::hash_own_data() {
+	std::size_t ret = ast::hash_combine(type.hash(),
+			std::hash<std::string>()(name));
+	for (ast::modifier mod : *modifiers) {
+		ret = ast::hash_combine(ret, static_cast<std::size_t>(mod));
+	}
+	return ret;
+}
+bool ast::variable_declaration_statement::own_data_equals(
+		ast::statement* other) {
+	ast::variable_declaration_statement* o =
+			static_cast<ast::variable_declaration_statement*>(other);
+	return *modifiers == *o->modifiers && type == o->type && name == o->name;
+}
 
 ast::assignment_statement::assignment_statement(ast::expression* lhs,
 		std::string assignment_operator, ast::expression* rhs) :
@@ -717,6 +961,14 @@ std::vector<ast::expression**>* ast::assignment_statement::get_child_expressions
 void ast::assignment_statement::accept(ast::ast_visitor* visitor) {
 	visitor->visit_assignment_statement(this);
 }
+std::size_t ast::assignment_statement::hash_own_data() {
+	return std::hash<std::string>()(assignment_operator);
+}
+bool ast::assignment_statement::own_data_equals(ast::statement* other) {
+	ast::assignment_statement* o =
+			static_cast<ast::assignment_statement*>(other);
+	return assignment_operator == o->assignment_operator;
+}
 
 ast::if_statement::if_statement(ast::expression* condition,
 		ast::statement* if_clause) :
@@ -993,6 +1245,17 @@ std::vector<ast::expression**>* ast::for_statement::get_child_expressions() {
 void ast::for_statement::accept(ast::ast_visitor* visitor) {
 	visitor->visit_for_statement(this);
 }
+std::size_t ast::for_statement::hash_own_data() {
+	// get_child_statements() skips missing parts, so record which are there
+	return (has_initializer() ? 1 : 0) | (has_condition() ? 2 : 0)
+			| (has_increment() ? 4 : 0);
+}
+bool ast::for_statement::own_data_equals(ast::statement* other) {
+	ast::for_statement* o = static_cast<ast::for_statement*>(other);
+	return has_initializer() == o->has_initializer()
+			&& has_condition() == o->has_condition()
+			&& has_increment() == o->has_increment();
+}
 
 ast::forever_statement::forever_statement(ast::statement* forever_clause) :
 		statement(ast::statement_kind::FOREVER), forever_clause(forever_clause) {
@@ -1077,12 +1340,6 @@ ast::ast_node_kind ast::ast_node::get_ast_node_kind() {
 bool ast::ast_node::is_of_ast_node_kind(ast::ast_node_kind kind) {
 	return this->kind == kind;
 }
-ast::ast_node* ast::ast_node::get_parent_node() {
-	return parent_node;
-}
-void ast::ast_node::set_parent_node(ast::ast_node* parent) {
-	parent_node = parent;
-}
 std::string ast::ast_node::to_string() {
 	std::cerr << "Called ast_node::to_string()!" << std::endl;
 	throw std::exception();
@@ -5,8 +5,10 @@
 #ifndef RELEASE_CROSSLANG_AST_HPP_
 #define RELEASE_CROSSLANG_AST_HPP_
 
+#include <cstddef>
 #include <string>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace ast {
@@ -74,36 +76,45 @@ public:
 	bool is_int();
 	bool is_long();
 	bool is_short();
-	std::string to_string();
-	bool operator==(type_ref other);
-	bool operator!=(type_ref other);
+	std::string to_string() const;
+	std::size_t hash() const;
+	bool operator==(const type_ref& other) const;
+	bool operator!=(const type_ref& other) const;
 };
 
+std::size_t hash_combine(std::size_t seed, std::size_t value);
+
 class expression;
 class statement;
 class ast_node;
 class ast_visitor;
 
+// the structural hashes of expressions and statements which have already
+// been hashed, for hashing many subtrees of a tree which isn't changing
+typedef std::unordered_map<const void*, std::size_t> structural_hash_cache;
+
 class expression {
 	expression_kind kind;
-	expression* parent_expression = nullptr;
-	statement* parent_statement = nullptr;
-	ast_node* parent_node = nullptr;
 protected:
 	expression(expression_kind kind);
 public:
 	virtual ~expression();
 	expression_kind get_expression_kind();
 	bool is_of_expression_kind(expression_kind kind);
-	expression* get_parent_expression();
-	void set_parent_expression(expression* parent);
-	statement* get_parent_statement();
-	void set_parent_statement(statement* parent);
-	ast_node* get_parent_node();
-	void set_parent_node(ast_node* parent);
 	virtual std::string to_string();
 	virtual std::vector<expression**>* get_children();
 	virtual void accept(ast_visitor* visitor);
+	// the structural hash covers the kind, operator, literal values etc. of
+	// this expression and all its children. Nothing is kept in the tree,
+	// since passes change it, so it's worked out again every time unless
+	// it's in the cache. A cache is only good while the tree doesn't change
+	std::size_t get_structural_hash();
+	std::size_t get_structural_hash(structural_hash_cache* cache);
+	bool structurally_equals(expression* other);
+	// hashes and compares the data specific to this kind of expression,
+	// not including children. other is always of the same kind as this
+	virtual std::size_t hash_own_data();
+	virtual bool own_data_equals(expression* other);
 };
 
 class identifier_expression: public expression {
@@ -113,6 +124,8 @@ public:
 	std::string get_identifier();
 	void set_identifier(std::string identifier);
 	std::string to_string();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -139,6 +152,8 @@ public:
 	std::vector<expression*>* get_operands();
 	std::string to_string();
 	std::vector<expression**>* get_children();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -154,6 +169,8 @@ public:
 	void set_operand(expression* operand);
 	std::string to_string();
 	std::vector<expression**>* get_children();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -173,6 +190,8 @@ public:
 	void set_rhs(expression* rhs);
 	std::string to_string();
 	std::vector<expression**>* get_children();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -189,6 +208,8 @@ public:
 	void set_operand(expression* operand);
 	std::string to_string();
 	std::vector<expression**>* get_children();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -205,6 +226,8 @@ public:
 	void set_operator(std::string operator_name);
 	std::string to_string();
 	std::vector<expression**>* get_children();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -215,6 +238,8 @@ public:
 	bool get_value();
 	void set_value(bool value);
 	std::string to_string();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -229,6 +254,8 @@ public:
 	radix get_radix();
 	void set_radix(radix rad);
 	std::string to_string();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -239,6 +266,8 @@ public:
 	float get_value();
 	void set_value(float value);
 	std::string to_string();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -249,6 +278,8 @@ public:
 	double get_value();
 	void set_value(double value);
 	std::string to_string();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -259,6 +290,8 @@ public:
 	std::string get_value();
 	void set_value(std::string value);
 	std::string to_string();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -274,6 +307,8 @@ public:
 	void set_operand(expression* operand);
 	std::string to_string();
 	std::vector<expression**>* get_children();
+	std::size_t hash_own_data();
+	bool own_data_equals(expression* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -293,22 +328,22 @@ public:
 
 class statement {
 	statement_kind kind;
-	statement* parent_statement = nullptr;
-	ast_node* parent_node = nullptr;
 protected:
 	statement(statement_kind kind);
 public:
 	virtual ~statement();
 	statement_kind get_statement_kind();
 	bool is_of_statement_kind(statement_kind kind);
-	statement* get_parent_statement();
-	void set_parent_statement(statement* parent);
-	ast_node* get_parent_node();
-	void set_parent_node(ast_node* parent);
 	virtual std::string to_string();
 	virtual std::vector<statement**>* get_child_statements();
 	virtual std::vector<expression**>* get_child_expressions();
 	virtual void accept(ast_visitor* visitor);
+	// see expression::get_structural_hash()
+	std::size_t get_structural_hash();
+	std::size_t get_structural_hash(structural_hash_cache* cache);
+	bool structurally_equals(statement* other);
+	virtual std::size_t hash_own_data();
+	virtual bool own_data_equals(statement* other);
 };
 
 class block_statement: public statement {
@@ -340,6 +375,8 @@ public:
 	void set_initialization_expression(expression* initialization_expression);
 	std::string to_string();
 	std::vector<expression**>* get_child_expressions();
+	std::size_t hash_own_data();
+	bool own_data_equals(statement* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -359,6 +396,8 @@ public:
 	void set_rhs(expression* rhs);
 	std::string to_string();
 	std::vector<expression**>* get_child_expressions();
+	std::size_t hash_own_data();
+	bool own_data_equals(statement* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -439,6 +478,8 @@ public:
 	std::string to_string();
 	std::vector<statement**>* get_child_statements();
 	std::vector<expression**>* get_child_expressions();
+	std::size_t hash_own_data();
+	bool own_data_equals(statement* other);
 	void accept(ast_visitor* visitor);
 };
 
@@ -496,15 +537,12 @@ public:
 
 class ast_node {
 	ast_node_kind kind;
-	ast_node* parent_node = nullptr;
 protected:
 	ast_node(ast_node_kind kind);
 public:
 	virtual ~ast_node();
 	ast_node_kind get_ast_node_kind();
 	bool is_of_ast_node_kind(ast_node_kind kind);
-	ast_node* get_parent_node();
-	void set_parent_node(ast_node* parent);
 	virtual std::string to_string();
 	virtual std::vector<ast_node**>* get_child_nodes();
 	virtual std::vector<statement**>* get_child_statements();
@@ -0,0 +1,319 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <algorithm>
+#include <functional>
+#include "dependency_graph.hpp"
+#include "parallel_walker.hpp"
+#include "pass_manager.hpp"
+#include "qualified_index.hpp"
+
+bool dependencies::change_set::is_empty() {
+	return changed_names.empty() && changed_declarations.empty()
+			&& changed_files.empty();
+}
+
+std::size_t hash_modifiers(std::set<ast::modifier>* modifiers) {
+	std::size_t ret = modifiers->size();
+	for (ast::modifier mod : *modifiers) {
+		ret = ast::hash_combine(ret, static_cast<std::size_t>(mod));
+	}
+	return ret;
+}
+
+// finds the fields and functions in a tree. What each of them uses is left
+// to a body_visitor, which can look at their bodies in parallel
+class declaration_collector: public passes::pass {
+	int file;
+	std::vector<dependencies::declaration>* declarations;
+	// where the declarations for the units in collect_units() are
+	std::vector<std::size_t>* unit_declarations;
+	std::vector<std::string> module_paths;
+public:
+	declaration_collector(int file,
+			std::vector<dependencies::declaration>* declarations,
+			std::vector<std::size_t>* unit_declarations) :
+			file(file), declarations(declarations), unit_declarations(
+					unit_declarations), module_paths(1, "") {
+	}
+	std::string get_name() {
+		return "declaration collector";
+	}
+	int get_node_kinds() {
+		return passes::AST_NODES;
+	}
+	passes::traversal_order get_traversal_order() {
+		return passes::traversal_order::PRE_AND_POST_ORDER;
+	}
+	void enter_ast_node(ast::ast_node*& node) {
+		switch (node->get_ast_node_kind()) {
+		case ast::ast_node_kind::MODULE: {
+			std::string ns = static_cast<ast::module_node*>(node)->get_namespace();
+			module_paths.push_back(
+					ns.empty() ?
+							module_paths.back() :
+							indexer::qualify(module_paths.back(), ns));
+			break;
+		}
+		case ast::ast_node_kind::FIELD:
+			add_field(static_cast<ast::field_node*>(node));
+			break;
+		case ast::ast_node_kind::FUNCTION:
+			add_function(static_cast<ast::function_node*>(node));
+			break;
+		default:
+			break;
+		}
+	}
+	void leave_ast_node(ast::ast_node*& node) {
+		if (node->is_of_ast_node_kind(ast::ast_node_kind::MODULE)) {
+			module_paths.pop_back();
+		}
+	}
+private:
+	dependencies::declaration* begin_declaration(const std::string& name,
+			bool is_unit) {
+		if (is_unit) {
+			unit_declarations->push_back(declarations->size());
+		}
+		declarations->push_back(dependencies::declaration());
+		dependencies::declaration* decl = &declarations->back();
+		decl->name = indexer::qualify(module_paths.back(), name);
+		decl->file = file;
+		decl->body_hash = 0;
+		return decl;
+	}
+	void add_field(ast::field_node* field) {
+		dependencies::declaration* decl = begin_declaration(field->get_name(),
+				field->has_initialization_expression());
+		decl->key = decl->name;
+		decl->signature_hash = ast::hash_combine(
+				hash_modifiers(field->get_modifiers()),
+				field->get_type().hash());
+	}
+	void add_function(ast::function_node* func) {
+		dependencies::declaration* decl = begin_declaration(func->get_name(),
+				true);
+		std::hash<std::string> hash_string;
+		decl->key = decl->name + "(";
+		bool first = true;
+		for (ast::field_node* param : *func->get_parameters()) {
+			if (!first) {
+				decl->key += ", ";
+			}
+			first = false;
+			decl->key += param->get_type().to_string();
+		}
+		decl->key += ")";
+		decl->signature_hash = ast::hash_combine(
+				ast::hash_combine(hash_modifiers(func->get_modifiers()),
+						func->get_return_type().hash()),
+				hash_string(decl->key));
+	}
+};
+
+// what a function body or field initializer hashes to and uses
+struct declaration_body {
+	std::size_t hash = 0;
+	std::vector<std::string> references;
+};
+
+class body_visitor: public parallel_walker::unit_visitor<declaration_body> {
+	name_resolver::resolution_table* table;
+	declaration_body body;
+public:
+	body_visitor(name_resolver::resolution_table* table) :
+			table(table) {
+	}
+	void begin_unit(ast::ast_node* unit) {
+		body = declaration_body();
+	}
+	void visit_expression(ast::expression* expr) {
+		// the table is only read, so any number of visitors can share it.
+		// Every name which was looked up is a dependency, since declaring
+		// something with a name which wasn't found could shadow what was, or
+		// resolve what wasn't. Every part of a namespace expression has the
+		// same names, but they're all taken out again at the end
+		name_resolver::resolution* res = table->get_resolution(expr);
+		if (res != nullptr) {
+			body.references.insert(body.references.end(),
+					res->looked_up.begin(), res->looked_up.end());
+		}
+		ast::ast_visitor::visit_expression(expr);
+	}
+	declaration_body end_unit(ast::ast_node* unit) {
+		std::vector<std::string>& refs = body.references;
+		std::sort(refs.begin(), refs.end());
+		refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+		std::hash<std::string> hash_string;
+		if (unit->is_of_ast_node_kind(ast::ast_node_kind::FIELD)) {
+			body.hash = hash_string(
+					static_cast<ast::field_node*>(unit)->get_initialization_expression()->to_string());
+		} else {
+			// the parameter names aren't part of the signature, since nothing
+			// outside the function can see them
+			ast::function_node* func = static_cast<ast::function_node*>(unit);
+			body.hash = hash_string(func->get_body()->to_string());
+			for (ast::field_node* param : *func->get_parameters()) {
+				body.hash = ast::hash_combine(body.hash,
+						hash_string(param->get_name()));
+			}
+		}
+		return body;
+	}
+};
+
+void dependencies::dependency_graph::set_file(int file,
+		std::vector<ast::ast_node*>* tree,
+		name_resolver::resolution_table* table, concurrency::thread_pool* pool,
+		dependencies::change_set* changes) {
+	std::vector<dependencies::declaration> found;
+	std::vector<std::size_t> unit_declarations;
+	passes::pass_manager manager;
+	manager.add_pass(
+			new declaration_collector(file, &found, &unit_declarations));
+	manager.run(tree);
+	std::vector<declaration_body>* bodies = parallel_walker::visit_units<
+			declaration_body>(tree, [table]() {
+		return new body_visitor(table);
+	}, pool);
+	for (int i = 0, e = bodies->size(); i < e; i++) {
+		dependencies::declaration& decl = found[unit_declarations[i]];
+		decl.body_hash = (*bodies)[i].hash;
+		decl.references.swap((*bodies)[i].references);
+	}
+	delete bodies;
+	replace_file(file, found, changes);
+}
+void dependencies::dependency_graph::remove_file(int file,
+		dependencies::change_set* changes) {
+	std::vector<dependencies::declaration> none;
+	replace_file(file, none, changes);
+	exports_by_file.erase(file);
+}
+void dependencies::dependency_graph::replace_file(int file,
+		std::vector<dependencies::declaration>& found,
+		dependencies::change_set* changes) {
+	std::unordered_set<std::string> found_keys;
+	for (dependencies::declaration& decl : found) {
+		found_keys.insert(decl.key);
+	}
+	std::vector<std::string>& exports = exports_by_file[file];
+	for (std::string& key : exports) {
+		if (found_keys.find(key) != found_keys.end()) {
+			continue;
+		}
+		// it's gone, so the file's output changes and anything using the
+		// name has to be checked again
+		std::unordered_map<std::string, dependencies::declaration>::iterator it =
+				declarations.find(key);
+		if (it != declarations.end()) {
+			changes->changed_names.insert(it->second.name);
+			// it might have been moved to another file already
+			if (it->second.file == file) {
+				remove_declaration(key);
+			}
+		}
+		changes->changed_files.insert(file);
+	}
+	exports.clear();
+	for (dependencies::declaration& decl : found) {
+		exports.push_back(decl.key);
+		std::unordered_map<std::string, dependencies::declaration>::iterator it =
+				declarations.find(decl.key);
+		if (it == declarations.end() || it->second.file != file
+				|| it->second.signature_hash != decl.signature_hash) {
+			changes->changed_names.insert(decl.name);
+			changes->changed_declarations.insert(decl.key);
+		} else if (it->second.body_hash != decl.body_hash) {
+			// nothing else can see the change
+			changes->changed_declarations.insert(decl.key);
+		}
+		if (it != declarations.end()) {
+			remove_declaration(decl.key);
+		}
+		add_declaration(decl);
+	}
+}
+void dependencies::dependency_graph::add_declaration(
+		dependencies::declaration& decl) {
+	for (std::string& ref : decl.references) {
+		users_by_name[ref].insert(decl.key);
+	}
+	declarations[decl.key] = decl;
+}
+void dependencies::dependency_graph::remove_declaration(
+		const std::string& key) {
+	dependencies::declaration& decl = declarations[key];
+	for (std::string& ref : decl.references) {
+		std::unordered_map<std::string, std::unordered_set<std::string>>::iterator users =
+				users_by_name.find(ref);
+		if (users != users_by_name.end()) {
+			users->second.erase(key);
+			if (users->second.empty()) {
+				users_by_name.erase(users);
+			}
+		}
+	}
+	declarations.erase(key);
+}
+
+dependencies::declaration* dependencies::dependency_graph::get_declaration(
+		const std::string& key) {
+	std::unordered_map<std::string, dependencies::declaration>::iterator it =
+			declarations.find(key);
+	return it == declarations.end() ? nullptr : &it->second;
+}
+std::vector<std::string> dependencies::dependency_graph::get_exports(
+		int file) {
+	std::unordered_map<int, std::vector<std::string>>::iterator it =
+			exports_by_file.find(file);
+	if (it == exports_by_file.end()) {
+		return std::vector<std::string>();
+	}
+	return it->second;
+}
+std::vector<std::string> dependencies::dependency_graph::get_users(
+		const std::string& name) {
+	std::vector<std::string> ret;
+	std::unordered_map<std::string, std::unordered_set<std::string>>::iterator it =
+			users_by_name.find(name);
+	if (it != users_by_name.end()) {
+		ret.assign(it->second.begin(), it->second.end());
+		std::sort(ret.begin(), ret.end());
+	}
+	return ret;
+}
+std::vector<std::string> dependencies::dependency_graph::get_declarations_to_regenerate(
+		dependencies::change_set* changes) {
+	std::unordered_set<std::string> keys;
+	for (const std::string& key : changes->changed_declarations) {
+		// it may have been removed again since
+		if (declarations.find(key) != declarations.end()) {
+			keys.insert(key);
+		}
+	}
+	// a changed signature doesn't change the signatures of its users, so
+	// this doesn't have to go any further
+	for (const std::string& name : changes->changed_names) {
+		std::unordered_map<std::string, std::unordered_set<std::string>>::iterator users =
+				users_by_name.find(name);
+		if (users != users_by_name.end()) {
+			keys.insert(users->second.begin(), users->second.end());
+		}
+	}
+	std::vector<std::string> ret(keys.begin(), keys.end());
+	std::sort(ret.begin(), ret.end());
+	return ret;
+}
+std::vector<int> dependencies::dependency_graph::get_files_to_regenerate(
+		dependencies::change_set* changes) {
+	std::unordered_set<int> files(changes->changed_files);
+	for (std::string& key : get_declarations_to_regenerate(changes)) {
+		files.insert(declarations[key].file);
+	}
+	std::vector<int> ret(files.begin(), files.end());
+	std::sort(ret.begin(), ret.end());
+	return ret;
+}
@@ -0,0 +1,94 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef DEPENDENCY_GRAPH_HPP_
+#define DEPENDENCY_GRAPH_HPP_
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "name_resolver.hpp"
+#include "thread_pool.hpp"
+
+namespace dependencies {
+
+// A field or function, as far as generating output for it goes. The key is
+// what tells it apart from everything else: the fully qualified name, and
+// the parameter types for a function. The signature hash covers everything
+// other code can see, and the body hash covers everything else, so an edit
+// which only changes the body doesn't affect the code which uses it.
+struct declaration {
+	std::string key;
+	std::string name;
+	int file;
+	std::size_t signature_hash;
+	std::size_t body_hash;
+	// the fully qualified names it looked up, sorted. That's the names of
+	// the fields and functions it uses, and the names which were tried
+	// before them or instead of them, whether or not anything has them
+	std::vector<std::string> references;
+};
+
+// what has changed since the last time the graph was asked what to
+// regenerate
+class change_set {
+	friend class dependency_graph;
+	// names whose declarations can be seen to have changed from outside
+	std::unordered_set<std::string> changed_names;
+	// declarations which are new or whose body has changed
+	std::unordered_set<std::string> changed_declarations;
+	// files which have lost a declaration
+	std::unordered_set<int> changed_files;
+public:
+	bool is_empty();
+};
+
+// Which file declares what, and which declarations use which names. It's
+// built from the trees after name resolution, one file at a time, and
+// comparing a file's new tree with what was recorded for it before gives
+// the smallest set of declarations and files whose output has to be
+// generated again.
+//
+// Uses are recorded by name rather than by declaration, so that adding or
+// removing an overload counts as a change to everything which uses the name.
+class dependency_graph {
+	std::unordered_map<std::string, declaration> declarations;
+	std::unordered_map<int, std::vector<std::string>> exports_by_file;
+	std::unordered_map<std::string, std::unordered_set<std::string>> users_by_name;
+public:
+	// records the declarations in a file's tree, replacing anything recorded
+	// for the file before, and adds what changed to the change set. The
+	// resolution table has to be for the same tree. The bodies of the
+	// declarations are looked at on the pool
+	void set_file(int file, std::vector<ast::ast_node*>* tree,
+			name_resolver::resolution_table* table,
+			concurrency::thread_pool* pool, change_set* changes);
+	void remove_file(int file, change_set* changes);
+	// returns nullptr if there's no such declaration
+	declaration* get_declaration(const std::string& key);
+	// the keys of the declarations in a file, in the order they appear
+	std::vector<std::string> get_exports(int file);
+	// the keys of the declarations which use a name, sorted
+	std::vector<std::string> get_users(const std::string& name);
+	// the keys of the declarations whose output has to be generated again,
+	// sorted. That's the changed ones, and the ones which looked up a name
+	// which has been declared, taken away or had its signature changed
+	std::vector<std::string> get_declarations_to_regenerate(
+			change_set* changes);
+	// the files with a declaration to generate again, or which have lost one,
+	// sorted
+	std::vector<int> get_files_to_regenerate(change_set* changes);
+private:
+	void replace_file(int file, std::vector<declaration>& found,
+			change_set* changes);
+	void add_declaration(declaration& decl);
+	void remove_declaration(const std::string& key);
+};
+
+}
+
+#endif /* DEPENDENCY_GRAPH_HPP_ */
@@ -0,0 +1,31 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include "diagnostics.hpp"
+
+void diagnostics::diagnostic_buffer::report(diagnostics::stage found_by,
+		const std::string& message, std::int64_t pos) {
+	diagnostics::diagnostic d;
+	d.found_by = found_by;
+	d.message = message;
+	d.pos = pos;
+	diagnostics.push_back(d);
+}
+bool diagnostics::diagnostic_buffer::has_errors() {
+	return !diagnostics.empty();
+}
+bool diagnostics::diagnostic_buffer::has_errors(diagnostics::stage found_by) {
+	for (diagnostics::diagnostic& d : diagnostics) {
+		if (d.found_by == found_by) {
+			return true;
+		}
+	}
+	return false;
+}
+std::vector<diagnostics::diagnostic>* diagnostics::diagnostic_buffer::get_diagnostics() {
+	return &diagnostics;
+}
+void diagnostics::diagnostic_buffer::clear() {
+	diagnostics.clear();
+}
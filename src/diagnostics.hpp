@@ -0,0 +1,44 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef DIAGNOSTICS_HPP_
+#define DIAGNOSTICS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Errors found while compiling a file. They're collected rather than thrown,
+// so that the tokenizer, parser and indexer can carry on past an error and
+// report everything wrong with a file in one go.
+namespace diagnostics {
+
+// which part of the compiler found the error
+enum class stage {
+	TOKENIZE, PARSE, INDEX
+};
+
+struct diagnostic {
+	stage found_by;
+	std::string message;
+	// the position in the file's text, or NO_POS if it isn't known
+	std::int64_t pos;
+};
+
+const std::int64_t NO_POS = -1;
+
+// the errors for one file, in the order they were found
+class diagnostic_buffer {
+	std::vector<diagnostic> diagnostics;
+public:
+	void report(stage found_by, const std::string& message, std::int64_t pos);
+	bool has_errors();
+	bool has_errors(stage found_by);
+	std::vector<diagnostic>* get_diagnostics();
+	void clear();
+};
+
+}
+
+#endif /* DIAGNOSTICS_HPP_ */
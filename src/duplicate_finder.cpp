@@ -0,0 +1,155 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <unordered_map>
+#include "duplicate_finder.hpp"
+#include "pass_manager.hpp"
+
+struct subtree {
+	void* node;
+	// the index of the subtree this one is directly inside of, or -1 if it's
+	// directly inside something of a different kind
+	int parent;
+	int node_count;
+};
+
+class subtree_collector: public passes::pass {
+	int collected_kind;
+	int walked_kinds;
+	std::vector<subtree>* subtrees;
+	// index into subtrees, or -1 for nodes which aren't collected
+	std::vector<int> index_stack;
+	std::vector<int> node_count_stack;
+public:
+	subtree_collector(int collected_kind, std::vector<subtree>* subtrees) :
+			collected_kind(collected_kind), walked_kinds(
+					collected_kind == passes::STATEMENTS ?
+							passes::STATEMENTS | passes::EXPRESSIONS :
+							collected_kind), subtrees(subtrees) {
+	}
+	std::string get_name() {
+		return "subtree collector";
+	}
+	int get_node_kinds() {
+		return walked_kinds;
+	}
+	passes::traversal_order get_traversal_order() {
+		return passes::traversal_order::PRE_AND_POST_ORDER;
+	}
+	void enter_statement(ast::statement*& stmt) {
+		enter(stmt, passes::STATEMENTS);
+	}
+	void leave_statement(ast::statement*& stmt) {
+		leave();
+	}
+	void enter_expression(ast::expression*& expr) {
+		enter(expr, passes::EXPRESSIONS);
+	}
+	void leave_expression(ast::expression*& expr) {
+		leave();
+	}
+private:
+	void enter(void* node, int kind) {
+		int index = -1;
+		if (kind == collected_kind) {
+			subtree s;
+			s.node = node;
+			s.parent = index_stack.empty() ? -1 : index_stack.back();
+			s.node_count = 0;
+			index = subtrees->size();
+			subtrees->push_back(s);
+		}
+		index_stack.push_back(index);
+		node_count_stack.push_back(1);
+	}
+	void leave() {
+		int index = index_stack.back();
+		int node_count = node_count_stack.back();
+		index_stack.pop_back();
+		node_count_stack.pop_back();
+		if (index != -1) {
+			(*subtrees)[index].node_count = node_count;
+		}
+		if (!node_count_stack.empty()) {
+			node_count_stack.back() += node_count;
+		}
+	}
+};
+
+template<typename T>
+std::vector<std::vector<T*>>* find_duplicates(
+		std::vector<ast::ast_node*>* tree, int kind, int min_node_count) {
+	std::vector<subtree> subtrees;
+	passes::pass_manager manager;
+	manager.add_pass(new subtree_collector(kind, &subtrees));
+	manager.run(tree);
+
+	// group the subtrees, using the hash to find the candidate groups and
+	// then checking properly in case of collisions
+	std::vector<std::vector<int>> groups;
+	std::vector<int> group_of(subtrees.size(), -1);
+	std::unordered_map<std::size_t, std::vector<int>> groups_by_hash;
+	// the tree doesn't change while it's being looked at, so each subtree is
+	// only hashed once
+	ast::structural_hash_cache hashes;
+	for (int i = 0, e = subtrees.size(); i < e; i++) {
+		if (subtrees[i].node_count < min_node_count) {
+			continue;
+		}
+		T* node = static_cast<T*>(subtrees[i].node);
+		std::vector<int>& candidates =
+				groups_by_hash[node->get_structural_hash(&hashes)];
+		for (int candidate : candidates) {
+			T* first = static_cast<T*>(subtrees[groups[candidate][0]].node);
+			if (first->structurally_equals(node)) {
+				group_of[i] = candidate;
+				groups[candidate].push_back(i);
+				break;
+			}
+		}
+		if (group_of[i] == -1) {
+			group_of[i] = groups.size();
+			candidates.push_back(groups.size());
+			groups.push_back(std::vector<int>(1, i));
+		}
+	}
+
+	std::vector<std::vector<T*>>* duplicates = new std::vector<std::vector<T*>>;
+	for (std::vector<int>& group : groups) {
+		if (group.size() < 2) {
+			continue;
+		}
+		// skip the group if all of its members are just part of a larger
+		// duplicate
+		bool all_inside_duplicates = true;
+		for (int i : group) {
+			int parent = subtrees[i].parent;
+			if (parent == -1 || group_of[parent] == -1
+					|| groups[group_of[parent]].size() < 2) {
+				all_inside_duplicates = false;
+				break;
+			}
+		}
+		if (all_inside_duplicates) {
+			continue;
+		}
+		std::vector<T*> members;
+		for (int i : group) {
+			members.push_back(static_cast<T*>(subtrees[i].node));
+		}
+		duplicates->push_back(members);
+	}
+	return duplicates;
+}
+
+std::vector<std::vector<ast::expression*>>* duplicate_finder::find_duplicate_expressions(
+		std::vector<ast::ast_node*>* tree, int min_node_count) {
+	return find_duplicates<ast::expression>(tree, passes::EXPRESSIONS,
+			min_node_count);
+}
+std::vector<std::vector<ast::statement*>>* duplicate_finder::find_duplicate_statements(
+		std::vector<ast::ast_node*>* tree, int min_node_count) {
+	return find_duplicates<ast::statement>(tree, passes::STATEMENTS,
+			min_node_count);
+}
@@ -0,0 +1,24 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef DUPLICATE_FINDER_HPP_
+#define DUPLICATE_FINDER_HPP_
+
+#include <vector>
+#include "crosslang_ast.hpp"
+
+namespace duplicate_finder {
+
+// Finds groups of structurally identical subtrees with at least
+// min_node_count nodes in them. Subtrees which are only duplicated because
+// every one of them is inside a larger duplicate are not reported. Groups
+// and their members are in the order they first appear in the tree.
+std::vector<std::vector<ast::expression*>>* find_duplicate_expressions(
+		std::vector<ast::ast_node*>* tree, int min_node_count);
+std::vector<std::vector<ast::statement*>>* find_duplicate_statements(
+		std::vector<ast::ast_node*>* tree, int min_node_count);
+
+}
+
+#endif /* DUPLICATE_FINDER_HPP_ */
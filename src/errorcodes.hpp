@@ -10,5 +10,7 @@ const int ERR_FOPEN_FAILED = 1;
 const int ERR_TOKENIZE_FAILED = 2;
 const int ERR_PARSE_FAILED = 3;
 const int ERR_INDEX_FAILED = 4;
+const int ERR_DAEMON_FAILED = 5;
+const int ERR_BAD_ARGUMENTS = 6;
 
 #endif /* ERRORCODES_HPP_ */
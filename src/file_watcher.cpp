@@ -0,0 +1,110 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <set>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "errorcodes.hpp"
+#include "file_watcher.hpp"
+#include "incremental_build.hpp"
+
+// how long to wait for more changes after one, since saving a file is often
+// more than one event
+const int SETTLE_MILLIS = 10;
+
+void split_path(const std::string& path, std::string& directory,
+		std::string& name) {
+	std::string::size_type slash = path.rfind('/');
+	if (slash == std::string::npos) {
+		directory = ".";
+		name = path;
+	} else {
+		directory = slash == 0 ? "/" : path.substr(0, slash);
+		name = path.substr(slash + 1);
+	}
+}
+
+void build(incremental::build_state& state, std::vector<std::string>& files) {
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	int exit_code = state.compile("", files);
+	double millis = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+	std::cout << (exit_code == SUCCESS ? "Build succeeded" : "Build failed")
+			<< " in " << millis << " ms, " << state.get_reparsed_count()
+			<< " of " << files.size() << " files parsed" << std::endl;
+	if (exit_code == SUCCESS) {
+		for (std::string& file : *state.get_files_to_regenerate()) {
+			std::cout << "Regenerate " << file << std::endl;
+		}
+	}
+}
+
+// reads the events which are waiting, and returns true if any of them are
+// for one of the files
+bool read_events(int fd, std::map<int, std::set<std::string>>& names_by_watch) {
+	alignas(inotify_event) char buffer[4096];
+	ssize_t size = read(fd, buffer, sizeof(buffer));
+	bool relevant = false;
+	for (char* ptr = buffer; size > 0 && ptr < buffer + size;) {
+		inotify_event* event = reinterpret_cast<inotify_event*>(ptr);
+		ptr += sizeof(inotify_event) + event->len;
+		if (event->len == 0) {
+			continue;
+		}
+		std::set<std::string>& names = names_by_watch[event->wd];
+		if (names.find(event->name) != names.end()) {
+			relevant = true;
+		}
+	}
+	return relevant;
+}
+
+int file_watch::watch_files(std::vector<std::string>& files,
+		int thread_count) {
+	int fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0) {
+		std::cerr << "Failed to watch files" << std::endl;
+		return ERR_FOPEN_FAILED;
+	}
+	std::map<std::string, int> watches;
+	std::map<int, std::set<std::string>> names_by_watch;
+	for (std::string& file : files) {
+		std::string directory, name;
+		split_path(file, directory, name);
+		std::map<std::string, int>::iterator watch = watches.find(directory);
+		if (watch == watches.end()) {
+			int wd = inotify_add_watch(fd, directory.c_str(),
+					IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM
+							| IN_MOVED_TO);
+			if (wd < 0) {
+				std::cerr << "Failed to watch directory " << directory
+						<< std::endl;
+				close(fd);
+				return ERR_FOPEN_FAILED;
+			}
+			watch = watches.insert(std::make_pair(directory, wd)).first;
+		}
+		names_by_watch[watch->second].insert(name);
+	}
+
+	incremental::build_state state(thread_count);
+	build(state, files);
+	while (true) {
+		if (!read_events(fd, names_by_watch)) {
+			continue;
+		}
+		pollfd waiting;
+		waiting.fd = fd;
+		waiting.events = POLLIN;
+		while (poll(&waiting, 1, SETTLE_MILLIS) > 0) {
+			read_events(fd, names_by_watch);
+		}
+		build(state, files);
+	}
+}
@@ -0,0 +1,23 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef FILE_WATCHER_HPP_
+#define FILE_WATCHER_HPP_
+
+#include <string>
+#include <vector>
+
+namespace file_watch {
+
+// Builds the files, and then builds them again whenever one of them is
+// written, created, moved or deleted, until the process is killed. Only the
+// files which have changed are parsed and indexed again, and the time each
+// build takes is printed. The directories the files are in are watched,
+// rather than the files, so that editors which save by replacing the file
+// are noticed. Returns if the files can't be watched.
+int watch_files(std::vector<std::string>& files, int thread_count);
+
+}
+
+#endif /* FILE_WATCHER_HPP_ */
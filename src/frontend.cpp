@@ -0,0 +1,504 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include "constant_folder.hpp"
+#include "errorcodes.hpp"
+#include "frontend.hpp"
+#include "parser.hpp"
+#include "pipeline.hpp"
+#include "tokenizer.hpp"
+#include "tracing.hpp"
+
+int frontend::get_line_number(std::vector<std::int64_t>& line_numbers,
+		std::int64_t pos) {
+	int size = line_numbers.size();
+	if (size == 0) {
+		return 1;
+	}
+	int i = std::upper_bound(line_numbers.begin(), line_numbers.end(), pos)
+			- line_numbers.begin();
+	return i == size ? size : i + 1;
+}
+
+bool witty_comments = true;
+
+void frontend::set_witty_comments(bool enabled) {
+	witty_comments = enabled;
+}
+void frontend::print_random_witty_comment() {
+	print_random_witty_comment(std::cerr);
+}
+void frontend::print_random_witty_comment(std::ostream& out) {
+	if (!witty_comments) {
+		return;
+	}
+	out << "-----------------------" << std::endl;
+	const int LENGTH = 4;
+	const std::string comments[LENGTH] = {
+			"And you call yourself a programmer?",
+			"Unlike you, I don't make mitsakes",
+			"What on Earth were you thinking when you typed that?",
+			"Wrong! Try again!" };
+	out << comments[rand() % LENGTH] << std::endl;
+}
+
+std::vector<instrumentation::phase_sample>* get_phases(
+		frontend::loaded_file& result) {
+	return result.measure ? &result.phases : nullptr;
+}
+
+void frontend::read_file(const std::string& file,
+		frontend::loaded_file& result, cache::compilation_cache* cache) {
+	result.name = file;
+	tracing::span span("load", file);
+	instrumentation::phase_scope scope(get_phases(result), "load");
+	std::ifstream in;
+	in.open(file);
+	if (!in.good()) {
+		result.status = frontend::file_status::FOPEN_FAILED;
+		return;
+	}
+	result.text = tokenizer::read_input_stream(in);
+	in.close();
+
+	result.entry = new cache::cache_entry;
+	if (cache != nullptr && cache->load(result.text, *result.entry)) {
+		result.status = frontend::file_status::LOADED;
+		result.from_cache = true;
+		result.index = result.entry->index;
+		result.text.clear();
+		return;
+	}
+	result.status = frontend::file_status::IN_PROGRESS;
+}
+
+void frontend::tokenize_file(frontend::loaded_file& result) {
+	if (result.status != frontend::file_status::IN_PROGRESS) {
+		return;
+	}
+	tracing::span span("tokenize", result.name);
+	instrumentation::phase_scope scope(get_phases(result), "tokenize");
+	if (!tokenizer::tokenize(result.text, result.entry->tokens,
+			result.entry->line_breaks, &result.errors)) {
+		result.status = frontend::file_status::TOKENIZE_FAILED;
+	}
+	// the text isn't needed any more
+	std::string().swap(result.text);
+}
+
+// the passes are walked together, so each pass's own time is only the time
+// spent in its hooks
+void run_measured_passes(std::vector<ast::ast_node*>* nodes,
+		passes::pass_manager* manager,
+		std::vector<instrumentation::phase_sample>& phases) {
+	std::vector<passes::pass_statistics>* statistics =
+			manager->get_statistics();
+	std::vector<std::chrono::steady_clock::duration> before;
+	for (passes::pass_statistics& stats : *statistics) {
+		before.push_back(stats.time);
+	}
+	{
+		instrumentation::phase_scope scope(&phases, "post-parse passes");
+		manager->set_timing(true);
+		manager->run(nodes);
+		manager->set_timing(false);
+	}
+	for (int i = 0, e = statistics->size(); i < e; i++) {
+		instrumentation::phase_sample sample;
+		sample.phase = "pass: " + (*statistics)[i].name;
+		sample.wall_seconds = std::chrono::duration<double>(
+				(*statistics)[i].time - before[i]).count();
+		sample.has_cpu_and_memory = false;
+		phases.push_back(sample);
+	}
+}
+
+void frontend::parse_file(frontend::loaded_file& result,
+		passes::pass_manager* post_parse_passes) {
+	if (result.status != frontend::file_status::IN_PROGRESS) {
+		return;
+	}
+	std::vector<ast::ast_node*>* nodes;
+	{
+		tracing::span span("parse", result.name);
+		instrumentation::phase_scope scope(get_phases(result), "parse");
+		nodes = parser::parse_unprocessed(result.entry->tokens, &result.errors);
+	}
+	if (nodes == nullptr) {
+		result.status = frontend::file_status::PARSE_FAILED;
+		return;
+	}
+	tracing::span span("post-parse passes", result.name);
+	if (result.measure) {
+		run_measured_passes(nodes, post_parse_passes, result.phases);
+	} else {
+		post_parse_passes->run(nodes);
+	}
+	result.entry->tree = nodes;
+	result.status = frontend::file_status::LOADED;
+}
+
+void frontend::index_file(frontend::loaded_file& result) {
+	if (result.status != frontend::file_status::LOADED || result.from_cache) {
+		return;
+	}
+	tracing::span span("index", result.name);
+	instrumentation::phase_scope scope(get_phases(result), "index");
+	indexer::index* idx = new indexer::index;
+	// it's indexed again when everything is merged, so that the errors are
+	// reported in the right order
+	if (!indexer::index_ast_tree(result.entry->tree, idx, nullptr)) {
+		delete idx;
+		return;
+	}
+	result.index = idx;
+}
+
+// the nodes from each chunk are freed before the next is read, so a small
+// chunk keeps the memory which is reused warm in the cache. Bigger chunks are
+// slower, not faster
+const std::size_t STREAM_CHUNK_SIZE = 1 << 14;
+
+// parses the nodes which are complete, and indexes them once they've been
+// through the passes. After an error, the rest of the file is only parsed to
+// find any more errors, so dictionary is nullptr. Returns false if the nodes
+// couldn't be parsed
+bool compile_streamed_nodes(parser::stream_parser& node_parser, bool at_end,
+		int file_number, indexer::index* dictionary,
+		passes::pass_manager* post_parse_passes,
+		diagnostics::diagnostic_buffer* parse_diags,
+		diagnostics::diagnostic_buffer* index_diags) {
+	std::vector<ast::ast_node*> nodes;
+	if (!node_parser.parse_complete_nodes(nodes, at_end, parse_diags)) {
+		return false;
+	}
+	if (dictionary != nullptr && !nodes.empty()) {
+		post_parse_passes->run(&nodes);
+		indexer::index_ast_tree(&nodes, dictionary, file_number, index_diags);
+	}
+	for (ast::ast_node* node : nodes) {
+		delete node;
+	}
+	return true;
+}
+
+bool frontend::stream_file(const std::string& file, int file_number,
+		frontend::loaded_file& result, indexer::index* dictionary,
+		passes::pass_manager* post_parse_passes,
+		diagnostics::diagnostic_buffer* index_diags) {
+	result.name = file;
+	result.streamed = true;
+	tracing::span span("stream", file);
+	std::ifstream in(file, std::ios::binary);
+	if (!in.good()) {
+		result.status = frontend::file_status::FOPEN_FAILED;
+		return false;
+	}
+	result.status = frontend::file_status::IN_PROGRESS;
+	tokenizer::stream_tokenizer text_tokenizer;
+	parser::stream_parser node_parser;
+	std::vector<char> buffer(STREAM_CHUNK_SIZE);
+	std::vector<tokenizer::token> tokens;
+	// the line numbers of errors are found later, so these aren't kept
+	std::vector<std::int64_t> line_breaks;
+	// parse errors only count if the whole file could be tokenized, like
+	// when the stages are run one after another
+	diagnostics::diagnostic_buffer parse_diags;
+	bool parsed = true;
+	char last_char = '\n';
+	while (true) {
+		in.read(&buffer[0], buffer.size());
+		std::size_t count = in.gcount();
+		if (count == 0) {
+			break;
+		}
+		last_char = buffer[count - 1];
+		text_tokenizer.feed(&buffer[0], count, tokens, line_breaks,
+				&result.errors);
+		line_breaks.clear();
+		if (result.errors.has_errors()) {
+			// only the tokenizer's errors are still wanted
+			tokens.clear();
+			continue;
+		}
+		node_parser.add_tokens(tokens);
+		parsed = compile_streamed_nodes(node_parser, false, file_number,
+				parsed ? dictionary : nullptr, post_parse_passes, &parse_diags,
+				index_diags) && parsed;
+	}
+	// reading the file whole ends its last line, so the same is done here
+	if (last_char != '\n') {
+		text_tokenizer.feed("\n", 1, tokens, line_breaks, &result.errors);
+	}
+	if (!text_tokenizer.finish(tokens, &result.errors)) {
+		result.status = frontend::file_status::TOKENIZE_FAILED;
+		return false;
+	}
+	node_parser.add_tokens(tokens);
+	parsed = compile_streamed_nodes(node_parser, true, file_number,
+			parsed ? dictionary : nullptr, post_parse_passes, &parse_diags,
+			index_diags) && parsed;
+	if (!parsed) {
+		for (diagnostics::diagnostic& d : *parse_diags.get_diagnostics()) {
+			result.errors.report(d.found_by, d.message, d.pos);
+		}
+		result.status = frontend::file_status::PARSE_FAILED;
+		return false;
+	}
+	result.status = frontend::file_status::LOADED;
+	return !index_diags->has_errors();
+}
+
+// the parser's post-processing is fused into as few walks of each tree as
+// possible
+void frontend::add_post_parse_passes(passes::pass_manager* manager) {
+	parser::add_post_processing_passes(manager);
+	constant_folder::add_constant_folding_pass(manager);
+}
+
+// takes a note of the first file which fails, so that no time is spent on
+// files after it
+void note_failure(std::atomic<int>& first_failure, int file) {
+	int failure = first_failure.load();
+	while (file < failure
+			&& !first_failure.compare_exchange_weak(failure, file)) {
+	}
+}
+
+void frontend::load_files_in_parallel(std::vector<std::string>& files,
+		std::vector<frontend::loaded_file>& loaded, cache::compilation_cache* cache,
+		concurrency::thread_pool* pool) {
+	// passes keep state while they walk a tree, so each worker has its own
+	std::vector<passes::pass_manager*> post_parse_passes;
+	for (int i = 0; i < pool->get_thread_count(); i++) {
+		passes::pass_manager* manager = new passes::pass_manager;
+		add_post_parse_passes(manager);
+		post_parse_passes.push_back(manager);
+	}
+	std::atomic<int> first_failure(INT_MAX);
+	std::vector<std::function<void(int)>> tasks;
+	for (int i = 0, e = files.size(); i < e; i++) {
+		tasks.push_back(
+				[i, &files, &loaded, &first_failure, cache, &post_parse_passes](
+						int worker) {
+					if (i > first_failure.load()) {
+						return;
+					}
+					frontend::loaded_file& result = loaded[i];
+					read_file(files[i], result, cache);
+					tokenize_file(result);
+					parse_file(result, post_parse_passes[worker]);
+					if (result.status != frontend::file_status::LOADED) {
+						note_failure(first_failure, i);
+					}
+				});
+	}
+	pool->run_all(&tasks);
+	for (passes::pass_manager* manager : post_parse_passes) {
+		delete manager;
+	}
+}
+
+void print_stage_stats(std::vector<concurrency::stage_stats>* stats) {
+	std::cerr << "stage\titems\tbusy\tstarved\tblocked\tutilization"
+			<< std::endl;
+	for (concurrency::stage_stats& stage : *stats) {
+		std::cerr << stage.name << "\t" << stage.items << "\t"
+				<< stage.busy_seconds << "s\t" << stage.starved_seconds
+				<< "s\t" << stage.blocked_seconds << "s\t"
+				<< static_cast<int>(stage.get_utilization() * 100) << "%"
+				<< std::endl;
+	}
+}
+
+void frontend::load_files_pipelined(std::vector<std::string>& files,
+		std::vector<frontend::loaded_file>& loaded, cache::compilation_cache* cache,
+		bool print_stats) {
+	passes::pass_manager post_parse_passes;
+	add_post_parse_passes(&post_parse_passes);
+	std::atomic<int> first_failure(INT_MAX);
+	// two files waiting between each pair of stages is enough to keep every
+	// stage busy, without keeping many files in memory at once
+	concurrency::pipeline stages(2);
+	stages.add_stage("load", [&files, &loaded, cache, &first_failure](int i) {
+		read_file(files[i], loaded[i], cache);
+		if (loaded[i].status == frontend::file_status::FOPEN_FAILED) {
+			note_failure(first_failure, i);
+		}
+	});
+	stages.add_stage("tokenize", [&loaded, &first_failure](int i) {
+		tokenize_file(loaded[i]);
+		if (loaded[i].status == frontend::file_status::TOKENIZE_FAILED) {
+			note_failure(first_failure, i);
+		}
+	});
+	stages.add_stage("parse",
+			[&loaded, &first_failure, &post_parse_passes](int i) {
+				parse_file(loaded[i], &post_parse_passes);
+				if (loaded[i].status == frontend::file_status::PARSE_FAILED) {
+					note_failure(first_failure, i);
+				}
+			});
+	stages.add_stage("index", [&loaded](int i) {
+		index_file(loaded[i]);
+	});
+	stages.run(files.size(), [&first_failure](int i) {
+		return i < first_failure.load();
+	});
+	if (print_stats) {
+		print_stage_stats(stages.get_stats());
+	}
+}
+
+// the line numbers are 0 where they aren't known
+void print_diagnostics(diagnostics::diagnostic_buffer* diags,
+		std::vector<int>& lines, std::ostream& out) {
+	std::vector<diagnostics::diagnostic>* list = diags->get_diagnostics();
+	for (int i = 0, e = list->size(); i < e; i++) {
+		out << "Message: " << (*list)[i].message << std::endl;
+		if (lines[i] != 0) {
+			out << "Line number: " << lines[i] << std::endl;
+		}
+	}
+}
+
+void find_lines(diagnostics::diagnostic_buffer* diags,
+		std::vector<std::int64_t>& line_breaks, std::vector<int>& lines) {
+	for (diagnostics::diagnostic& d : *diags->get_diagnostics()) {
+		lines.push_back(
+				d.pos == diagnostics::NO_POS ?
+						0 : frontend::get_line_number(line_breaks, d.pos));
+	}
+}
+
+// reads a streamed file again, counting the line breaks before each error,
+// so that the line numbers are the same as get_line_number would give
+void find_streamed_lines(diagnostics::diagnostic_buffer* diags,
+		const std::string& file, std::vector<int>& lines) {
+	std::vector<diagnostics::diagnostic>* list = diags->get_diagnostics();
+	lines.assign(list->size(), 0);
+	std::vector<int> order;
+	for (int i = 0, e = list->size(); i < e; i++) {
+		if ((*list)[i].pos != diagnostics::NO_POS) {
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [list](int a, int b) {
+		return (*list)[a].pos < (*list)[b].pos;
+	});
+	std::ifstream in(file, std::ios::binary);
+	if (!in.good()) {
+		return;
+	}
+	// the number of line breaks before each error
+	std::vector<int> breaks_before(list->size());
+	std::size_t next = 0;
+	int break_count = 0;
+	std::int64_t pos = 0;
+	char last_char = '\n';
+	std::vector<char> buffer(STREAM_CHUNK_SIZE);
+	while (true) {
+		in.read(&buffer[0], buffer.size());
+		std::size_t count = in.gcount();
+		if (count == 0) {
+			break;
+		}
+		for (std::size_t i = 0; i < count; i++, pos++) {
+			if (buffer[i] != '\n') {
+				continue;
+			}
+			while (next != order.size() && (*list)[order[next]].pos < pos) {
+				breaks_before[order[next++]] = break_count;
+			}
+			break_count++;
+		}
+		last_char = buffer[count - 1];
+	}
+	// the last line is ended when the file is read whole
+	if (last_char != '\n') {
+		while (next != order.size() && (*list)[order[next]].pos < pos) {
+			breaks_before[order[next++]] = break_count;
+		}
+		break_count++;
+	}
+	while (next != order.size()) {
+		breaks_before[order[next++]] = break_count;
+	}
+	for (int i : order) {
+		lines[i] = break_count == 0 ? 1 :
+				breaks_before[i] == break_count ?
+						break_count : breaks_before[i] + 1;
+	}
+}
+
+void print_file_diagnostics(const std::string& file,
+		frontend::loaded_file& result, std::ostream& out) {
+	std::vector<int> lines;
+	if (result.streamed) {
+		find_streamed_lines(&result.errors, file, lines);
+	} else {
+		find_lines(&result.errors, result.entry->line_breaks, lines);
+	}
+	print_diagnostics(&result.errors, lines, out);
+}
+
+int frontend::report_file_error(const std::string& file,
+		frontend::loaded_file& result) {
+	return report_file_error(file, result, std::cerr);
+}
+int frontend::report_file_error(const std::string& file,
+		frontend::loaded_file& result, std::ostream& out) {
+	switch (result.status) {
+	case frontend::file_status::FOPEN_FAILED:
+		out << "Failed to open file " << file << std::endl;
+		return ERR_FOPEN_FAILED;
+	case frontend::file_status::TOKENIZE_FAILED:
+		out << "COMPILATION FAILED WHILE TOKENIZING!" << std::endl;
+		out
+				<< "This means the compiler failed to split the file up into tokens (words)."
+				<< std::endl;
+		out << "This is normally caused by an unclosed string/comment."
+				<< std::endl;
+		out << "File: " << file << std::endl;
+		print_file_diagnostics(file, result, out);
+		print_random_witty_comment(out);
+		return ERR_TOKENIZE_FAILED;
+	case frontend::file_status::PARSE_FAILED:
+		out << "COMPILATION FAILED WHILE PARSING!" << std::endl;
+		out
+				<< "This means the compiler was unable to deduce the structure of the code."
+				<< std::endl;
+		out << "This is normally caused by a syntax error." << std::endl;
+		out << "File: " << file << std::endl;
+		print_file_diagnostics(file, result, out);
+		print_random_witty_comment(out);
+		return ERR_TOKENIZE_FAILED;
+	default:
+		return SUCCESS;
+	}
+}
+void frontend::report_index_error(const std::string& file,
+		diagnostics::diagnostic_buffer* diags) {
+	report_index_error(file, diags, std::cerr);
+}
+void frontend::report_index_error(const std::string& file,
+		diagnostics::diagnostic_buffer* diags, std::ostream& out) {
+	out << "COMPILATION FAILED WHILE INDEXING!" << std::endl;
+	out
+			<< "This occurs when the compiler is trying to build an index (dictionary) of fields, functions, etc."
+			<< std::endl;
+	out << "File: " << file << std::endl;
+	// duplicates don't have a position
+	std::vector<int> lines(diags->get_diagnostics()->size(), 0);
+	print_diagnostics(diags, lines, out);
+	print_random_witty_comment(out);
+}
@@ -0,0 +1,99 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef FRONTEND_HPP_
+#define FRONTEND_HPP_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "compilation_cache.hpp"
+#include "diagnostics.hpp"
+#include "indexer.hpp"
+#include "instrumentation.hpp"
+#include "pass_manager.hpp"
+#include "thread_pool.hpp"
+
+// Getting files from text to trees, and reporting what goes wrong on the way,
+// for both the command line and the daemon.
+namespace frontend {
+
+// what happened to one file on its way through the front end
+enum class file_status {
+	SKIPPED, IN_PROGRESS, LOADED, FOPEN_FAILED, TOKENIZE_FAILED, PARSE_FAILED
+};
+
+struct loaded_file {
+	// the name it was read from
+	std::string name;
+	file_status status = file_status::SKIPPED;
+	std::string text;
+	cache::cache_entry* entry = nullptr;
+	bool from_cache = false;
+	// only set if the file was indexed along with the other stages
+	indexer::index* index = nullptr;
+	// what went wrong, if the file failed
+	diagnostics::diagnostic_buffer errors;
+	// set if the file was compiled a piece at a time, so its line breaks
+	// weren't kept and are found by reading it again if need be
+	bool streamed = false;
+	// if set, how long each stage takes is added to the phases
+	bool measure = false;
+	std::vector<instrumentation::phase_sample> phases;
+};
+
+int get_line_number(std::vector<std::int64_t>& line_numbers,
+		std::int64_t pos);
+// the witty comment after an error is picked with rand(), so it can be
+// turned off where the same source has to give the same errors every time
+void set_witty_comments(bool enabled);
+void print_random_witty_comment();
+void print_random_witty_comment(std::ostream& out);
+
+// the stages of the front end. Errors are kept to be reported later, so they
+// can be reported in order, and each stage leaves a file alone once it has
+// failed or been loaded from the cache
+void read_file(const std::string& file, loaded_file& result,
+		cache::compilation_cache* cache);
+void tokenize_file(loaded_file& result);
+void parse_file(loaded_file& result, passes::pass_manager* post_parse_passes);
+void index_file(loaded_file& result);
+void add_post_parse_passes(passes::pass_manager* manager);
+
+// compiles a file a piece at a time, so that only the text, tokens and tree
+// of the top-level nodes which are being worked on are in memory, however big
+// the file is. Each top-level node is indexed into the dictionary and thrown
+// away as soon as it's parsed, so nothing is cached. Errors are kept in the
+// result as for the other stages, except duplicates, which are added to the
+// index diagnostics. Returns false if anything went wrong
+bool stream_file(const std::string& file, int file_number, loaded_file& result,
+		indexer::index* dictionary, passes::pass_manager* post_parse_passes,
+		diagnostics::diagnostic_buffer* index_diags);
+
+// every file is loaded, tokenized and parsed on its own, as a task on the
+// pool. Files after one which has failed may be skipped
+void load_files_in_parallel(std::vector<std::string>& files,
+		std::vector<loaded_file>& loaded, cache::compilation_cache* cache,
+		concurrency::thread_pool* pool);
+// each stage of the front end runs on its own thread, so that one file can
+// be read while the one before it is tokenized and the one before that is
+// parsed and so on
+void load_files_pipelined(std::vector<std::string>& files,
+		std::vector<loaded_file>& loaded, cache::compilation_cache* cache,
+		bool print_stats);
+
+// prints the errors for a file which failed, to std::cerr unless given
+// somewhere else, and returns the exit code for it
+int report_file_error(const std::string& file, loaded_file& result);
+int report_file_error(const std::string& file, loaded_file& result,
+		std::ostream& out);
+void report_index_error(const std::string& file,
+		diagnostics::diagnostic_buffer* diags);
+void report_index_error(const std::string& file,
+		diagnostics::diagnostic_buffer* diags, std::ostream& out);
+
+}
+
+#endif /* FRONTEND_HPP_ */
@@ -0,0 +1,219 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "frozen_index.hpp"
+
+std::string indexer::name_ref::to_string() const {
+	return std::string(data, size);
+}
+int compare_names(const char* a, std::size_t a_size, const char* b,
+		std::size_t b_size) {
+	int ret = std::memcmp(a, b, std::min(a_size, b_size));
+	if (ret != 0) {
+		return ret;
+	}
+	return a_size < b_size ? -1 : a_size > b_size ? 1 : 0;
+}
+int indexer::name_ref::compare(const std::string& other) const {
+	return compare_names(data, size, other.data(), other.size());
+}
+int indexer::name_ref::compare(const indexer::name_ref& other) const {
+	return compare_names(data, size, other.data, other.size);
+}
+
+bool indexer::frozen_function::has_parameter_types(
+		std::vector<ast::type_ref>* parameter_types) const {
+	if (this->parameter_types.size() != parameter_types->size()) {
+		return false;
+	}
+	for (int i = 0, e = parameter_types->size(); i < e; i++) {
+		if (this->parameter_types.first[i] != (*parameter_types)[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// the first thing in a sorted range whose name isn't less than the given name
+template<typename T>
+const T* lower_bound_by_name(const indexer::frozen_range<T>& range,
+		const std::string& name) {
+	return std::lower_bound(range.begin(), range.end(), name,
+			[](const T& t, const std::string& name) {
+				return t.name.compare(name) < 0;
+			});
+}
+
+const indexer::frozen_module* indexer::frozen_module::get_module(
+		const std::string& name) const {
+	const indexer::frozen_module* it = lower_bound_by_name(modules, name);
+	// unnamed modules have an empty name, and are never found
+	while (it != modules.end() && !it->has_name) {
+		++it;
+	}
+	if (it == modules.end() || it->name.compare(name) != 0) {
+		return nullptr;
+	}
+	return it;
+}
+const indexer::frozen_field* indexer::frozen_module::get_field(
+		const std::string& name) const {
+	const indexer::frozen_field* it = lower_bound_by_name(fields, name);
+	if (it == fields.end() || it->name.compare(name) != 0) {
+		return nullptr;
+	}
+	return it;
+}
+indexer::frozen_range<indexer::frozen_function> indexer::frozen_module::get_overloads(
+		const std::string& name) const {
+	indexer::frozen_range<indexer::frozen_function> ret;
+	ret.first = lower_bound_by_name(functions, name);
+	ret.last = ret.first;
+	while (ret.last != functions.end() && ret.last->name.compare(name) == 0) {
+		++ret.last;
+	}
+	return ret;
+}
+const indexer::frozen_function* indexer::frozen_module::get_function(
+		const std::string& name,
+		std::vector<ast::type_ref>* parameter_types) const {
+	for (const indexer::frozen_function& function : get_overloads(name)) {
+		if (function.has_parameter_types(parameter_types)) {
+			return &function;
+		}
+	}
+	return nullptr;
+}
+
+// counts everything in an index, so the arrays can be made the right size
+// before anything points into them
+void count_index(indexer::module_index* idx, std::size_t& modules,
+		std::size_t& fields, std::size_t& functions, std::size_t& types,
+		std::size_t& chars) {
+	chars += idx->get_name().size();
+	for (indexer::module_index* ns : *idx->get_modules()) {
+		modules++;
+		count_index(ns, modules, fields, functions, types, chars);
+	}
+	for (indexer::field_index* field : *idx->get_fields()) {
+		fields++;
+		types++;
+		chars += field->get_name().size();
+	}
+	for (indexer::function_index* function : *idx->get_functions()) {
+		functions++;
+		types += 1 + function->get_parameter_types()->size();
+		chars += function->get_name().size();
+	}
+}
+
+indexer::frozen_index::frozen_index(indexer::index* dictionary) {
+	std::size_t module_count = 1, field_count = 0, function_count = 0,
+			type_count = 0, char_count = 0;
+	count_index(dictionary, module_count, field_count, function_count,
+			type_count, char_count);
+	// nothing is added past these sizes, so the arrays never move and the
+	// pointers into them stay valid
+	strings.reserve(char_count);
+	types.reserve(type_count);
+	modules.resize(module_count);
+	fields.resize(field_count);
+	functions.resize(function_count);
+	std::size_t next_module = 1, next_field = 0, next_function = 0;
+	modules[0].has_name = dictionary->has_name();
+	modules[0].name = add_string(dictionary->get_name());
+	lay_out(dictionary, modules[0], next_module, next_field, next_function);
+}
+const indexer::frozen_module* indexer::frozen_index::get_root() const {
+	return &modules[0];
+}
+std::size_t indexer::frozen_index::get_module_count() const {
+	return modules.size();
+}
+std::size_t indexer::frozen_index::get_field_count() const {
+	return fields.size();
+}
+std::size_t indexer::frozen_index::get_function_count() const {
+	return functions.size();
+}
+indexer::name_ref indexer::frozen_index::add_string(const std::string& str) {
+	indexer::name_ref ret;
+	ret.data = strings.data() + strings.size();
+	ret.size = str.size();
+	strings.insert(strings.end(), str.begin(), str.end());
+	return ret;
+}
+
+template<typename T>
+bool name_less(T* a, T* b) {
+	return a->get_name() < b->get_name();
+}
+bool module_less(indexer::module_index* a, indexer::module_index* b) {
+	if (a->has_name() != b->has_name()) {
+		return !a->has_name();
+	}
+	return a->get_name() < b->get_name();
+}
+
+// the members of a module are all given their places before any submodule is
+// laid out, so that they stay next to each other
+void indexer::frozen_index::lay_out(indexer::module_index* from,
+		indexer::frozen_module& to, std::size_t& next_module,
+		std::size_t& next_field, std::size_t& next_function) {
+	std::vector<indexer::module_index*> sub_modules(*from->get_modules());
+	std::vector<indexer::field_index*> sub_fields(*from->get_fields());
+	std::vector<indexer::function_index*> sub_functions(
+			*from->get_functions());
+	std::stable_sort(sub_modules.begin(), sub_modules.end(), module_less);
+	std::sort(sub_fields.begin(), sub_fields.end(),
+			name_less<indexer::field_index>);
+	// stable, so overloads stay in the order they were added
+	std::stable_sort(sub_functions.begin(), sub_functions.end(),
+			name_less<indexer::function_index>);
+
+	std::size_t first_module = next_module, first_field = next_field,
+			first_function = next_function;
+	next_module += sub_modules.size();
+	next_field += sub_fields.size();
+	next_function += sub_functions.size();
+	to.modules.first = modules.data() + first_module;
+	to.modules.last = modules.data() + next_module;
+	to.fields.first = fields.data() + first_field;
+	to.fields.last = fields.data() + next_field;
+	to.functions.first = functions.data() + first_function;
+	to.functions.last = functions.data() + next_function;
+
+	for (indexer::field_index* from_field : sub_fields) {
+		indexer::frozen_field& field = fields[first_field++];
+		field.global = from_field->is_global();
+		field.name = add_string(from_field->get_name());
+		types.push_back(from_field->get_type());
+		field.type = &types.back();
+	}
+	for (indexer::function_index* from_function : sub_functions) {
+		indexer::frozen_function& function = functions[first_function++];
+		function.global = from_function->is_global();
+		function.name = add_string(from_function->get_name());
+		types.push_back(from_function->get_return_type());
+		function.return_type = &types.back();
+		function.parameter_types.first = types.data() + types.size();
+		for (ast::type_ref& type : *from_function->get_parameter_types()) {
+			types.push_back(type);
+		}
+		function.parameter_types.last = types.data() + types.size();
+		function.signature_hash = from_function->get_signature_hash();
+	}
+	for (indexer::module_index* from_module : sub_modules) {
+		indexer::frozen_module& module = modules[first_module++];
+		module.has_name = from_module->has_name();
+		module.name = add_string(from_module->get_name());
+		lay_out(from_module, module, next_module, next_field, next_function);
+	}
+}
+
+indexer::frozen_index* indexer::freeze(indexer::index* dictionary) {
+	return new indexer::frozen_index(dictionary);
+}
@@ -0,0 +1,111 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef FROZEN_INDEX_HPP_
+#define FROZEN_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "indexer.hpp"
+
+namespace indexer {
+
+// a name in a frozen index's string pool, which isn't null terminated
+struct name_ref {
+	const char* data = nullptr;
+	std::uint32_t size = 0;
+	std::string to_string() const;
+	// like std::string::compare
+	int compare(const std::string& other) const;
+	int compare(const name_ref& other) const;
+};
+
+// a run of things next to each other in one of a frozen index's arrays
+template<typename T>
+struct frozen_range {
+	const T* first = nullptr;
+	const T* last = nullptr;
+	const T* begin() const {
+		return first;
+	}
+	const T* end() const {
+		return last;
+	}
+	std::size_t size() const {
+		return last - first;
+	}
+	bool empty() const {
+		return first == last;
+	}
+};
+
+struct frozen_field {
+	bool global;
+	name_ref name;
+	const ast::type_ref* type;
+};
+
+struct frozen_function {
+	bool global;
+	name_ref name;
+	const ast::type_ref* return_type;
+	frozen_range<ast::type_ref> parameter_types;
+	std::size_t signature_hash;
+	bool has_parameter_types(std::vector<ast::type_ref>* parameter_types) const;
+};
+
+// The members of a module are sorted by name, so they're found with a binary
+// search. Unnamed modules come before the named ones, and overloads are next
+// to each other in the order they were added.
+struct frozen_module {
+	bool has_name;
+	name_ref name;
+	frozen_range<frozen_module> modules;
+	frozen_range<frozen_field> fields;
+	frozen_range<frozen_function> functions;
+	// these return nullptr if there's nothing with that name
+	const frozen_module* get_module(const std::string& name) const;
+	const frozen_field* get_field(const std::string& name) const;
+	// the range is empty if there's no function with that name
+	frozen_range<frozen_function> get_overloads(const std::string& name) const;
+	const frozen_function* get_function(const std::string& name,
+			std::vector<ast::type_ref>* parameter_types) const;
+};
+
+// An index which can't be changed any more. Every module, field, function,
+// type and name is in one of a few arrays rather than being allocated on its
+// own, and nothing changes after it's been built, so any number of threads
+// can read it at once without locking.
+class frozen_index {
+	std::vector<char> strings;
+	std::vector<ast::type_ref> types;
+	std::vector<frozen_module> modules;
+	std::vector<frozen_field> fields;
+	std::vector<frozen_function> functions;
+public:
+	frozen_index(index* dictionary);
+	// everything points into the arrays, so it can't be copied
+	frozen_index(const frozen_index&) = delete;
+	frozen_index& operator=(const frozen_index&) = delete;
+	const frozen_module* get_root() const;
+	std::size_t get_module_count() const;
+	std::size_t get_field_count() const;
+	std::size_t get_function_count() const;
+private:
+	name_ref add_string(const std::string& str);
+	void lay_out(module_index* from, frozen_module& to,
+			std::size_t& next_module, std::size_t& next_field,
+			std::size_t& next_function);
+};
+
+// Builds a frozen copy of an index, for once indexing has finished and the
+// index is only going to be read. The index itself isn't changed.
+frozen_index* freeze(index* dictionary);
+
+}
+
+#endif /* FROZEN_INDEX_HPP_ */
@@ -0,0 +1,249 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <functional>
+#include <iostream>
+#include <unordered_set>
+#include <sys/stat.h>
+#include "compilation_cache.hpp"
+#include "errorcodes.hpp"
+#include "incremental_build.hpp"
+#include "name_resolver.hpp"
+
+void free_loaded_file(frontend::loaded_file& loaded) {
+	if (loaded.entry != nullptr) {
+		if (loaded.entry->tree != nullptr) {
+			for (ast::ast_node* node : *loaded.entry->tree) {
+				delete node;
+			}
+			delete loaded.entry->tree;
+		}
+		delete loaded.entry;
+	}
+	loaded = frontend::loaded_file();
+}
+
+incremental::build_state::build_state(int thread_count) :
+		pool(thread_count) {
+	for (int i = 0; i < pool.get_thread_count(); i++) {
+		passes::pass_manager* manager = new passes::pass_manager;
+		frontend::add_post_parse_passes(manager);
+		post_parse_passes.push_back(manager);
+	}
+}
+incremental::build_state::~build_state() {
+	for (std::pair<const std::string, incremental::tracked_file*>& file : files) {
+		free_loaded_file(file.second->loaded);
+		delete file.second;
+	}
+	for (passes::pass_manager* manager : post_parse_passes) {
+		delete manager;
+	}
+}
+int incremental::build_state::compile(const std::string& directory,
+		std::vector<std::string>& names) {
+	return compile(directory, names, std::cerr);
+}
+int incremental::build_state::compile(const std::string& directory,
+		std::vector<std::string>& names, std::ostream& errors) {
+	// files are known by their full paths, but are reported by the names
+	// they were given
+	std::vector<std::string> paths;
+	std::vector<incremental::tracked_file*> requested;
+	std::unordered_set<incremental::tracked_file*> requested_set;
+	for (std::string& name : names) {
+		paths.push_back(
+				name.empty() || name[0] == '/' || directory.empty() ?
+						name : directory + "/" + name);
+		incremental::tracked_file*& file = files[paths.back()];
+		if (file == nullptr) {
+			file = new incremental::tracked_file;
+			file->id = files.size() - 1;
+		}
+		requested.push_back(file);
+		requested_set.insert(file);
+	}
+	// files from an earlier build which aren't in this one mustn't be seen
+	// as duplicates
+	for (std::pair<const std::string, incremental::tracked_file*>& file : files) {
+		if (file.second->indexed
+				&& requested_set.find(file.second) == requested_set.end()) {
+			delete dictionary.retract_file(file.second->id);
+			file.second->indexed = false;
+		}
+		if (file.second->in_graph
+				&& requested_set.find(file.second) == requested_set.end()) {
+			graph.remove_file(file.second->id, &changes);
+			file.second->in_graph = false;
+		}
+	}
+
+	std::vector<bool> changed(names.size(), false);
+	std::vector<std::function<void(int)>> tasks;
+	for (int i = 0, e = names.size(); i < e; i++) {
+		changed[i] = revalidate(paths[i], requested[i]);
+		incremental::tracked_file* file = requested[i];
+		if (changed[i] && file->indexed) {
+			delete dictionary.retract_file(file->id);
+			file->indexed = false;
+		}
+		if (changed[i]) {
+			file->in_graph = false;
+		}
+		if (changed[i]
+				&& file->loaded.status == frontend::file_status::IN_PROGRESS) {
+			tasks.push_back([this, file](int worker) {
+				frontend::tokenize_file(file->loaded);
+				frontend::parse_file(file->loaded, post_parse_passes[worker]);
+			});
+		}
+	}
+	reparsed_count = tasks.size();
+	pool.run_all(&tasks);
+
+	// the files before a file with an error are indexed before the error
+	// is reported, like they would be in a full build
+	int first_changed = -1;
+	for (int i = 0, e = names.size(); i < e; i++) {
+		incremental::tracked_file* file = requested[i];
+		if (file->loaded.status != frontend::file_status::LOADED) {
+			return frontend::report_file_error(names[i], file->loaded,
+					errors);
+		}
+		if (file->indexed) {
+			continue;
+		}
+		if (first_changed == -1) {
+			first_changed = i;
+		}
+		diagnostics::diagnostic_buffer diags;
+		if (!indexer::reindex_file(file->loaded.entry->tree, &dictionary,
+				file->id, &diags)) {
+			// the duplicate may be with a file which comes later, so it
+			// might not be the one a full build would report
+			int exit_code = index_in_order(names, requested, first_changed,
+					errors);
+			if (exit_code != SUCCESS) {
+				return exit_code;
+			}
+			break;
+		}
+		file->indexed = true;
+	}
+	update_graph(names, requested);
+	return SUCCESS;
+}
+int incremental::build_state::index_in_order(std::vector<std::string>& names,
+		std::vector<incremental::tracked_file*>& requested, int first,
+		std::ostream& errors) {
+	// everything from the first file which changed is indexed again one file
+	// after another, like merge_indexes() does when the merges fail. The
+	// files before it are the same as they were in the last build
+	for (int i = first, e = names.size(); i < e; i++) {
+		if (requested[i]->indexed) {
+			delete dictionary.retract_file(requested[i]->id);
+			requested[i]->indexed = false;
+		}
+	}
+	for (int i = first, e = names.size(); i < e; i++) {
+		incremental::tracked_file* file = requested[i];
+		if (file->loaded.status != frontend::file_status::LOADED) {
+			return frontend::report_file_error(names[i], file->loaded,
+					errors);
+		}
+		diagnostics::diagnostic_buffer diags;
+		if (!indexer::index_ast_tree(file->loaded.entry->tree, &dictionary,
+				file->id, &diags)) {
+			// what wasn't a duplicate was still added
+			delete dictionary.retract_file(file->id);
+			frontend::report_index_error(names[i], &diags, errors);
+			return ERR_INDEX_FAILED;
+		}
+		file->indexed = true;
+	}
+	return SUCCESS;
+}
+void incremental::build_state::update_graph(std::vector<std::string>& names,
+		std::vector<incremental::tracked_file*>& requested) {
+	// names are resolved against the whole dictionary, so it's only done
+	// once everything has been indexed
+	std::unordered_map<int, incremental::tracked_file*> files_by_id;
+	std::unordered_map<int, std::string> names_by_id;
+	std::unordered_set<int> resolved;
+	for (int i = 0, e = names.size(); i < e; i++) {
+		incremental::tracked_file* file = requested[i];
+		files_by_id[file->id] = file;
+		names_by_id[file->id] = names[i];
+		if (file->in_graph) {
+			continue;
+		}
+		resolve_into_graph(file, &changes);
+		resolved.insert(file->id);
+	}
+	files_to_regenerate.clear();
+	for (int id : graph.get_files_to_regenerate(&changes)) {
+		// files which have left the build have nothing to generate
+		std::unordered_map<int, std::string>::iterator name = names_by_id.find(
+				id);
+		if (name == names_by_id.end()) {
+			continue;
+		}
+		files_to_regenerate.push_back(name->second);
+		// a file which hasn't changed, but whose names may now resolve
+		// differently, has to have what it looks up recorded again. Its own
+		// declarations are the same, so nothing else changes
+		if (resolved.find(id) == resolved.end()) {
+			dependencies::change_set unchanged;
+			resolve_into_graph(files_by_id[id], &unchanged);
+		}
+	}
+	changes = dependencies::change_set();
+}
+void incremental::build_state::resolve_into_graph(
+		incremental::tracked_file* file, dependencies::change_set* changes) {
+	name_resolver::resolution_table table;
+	name_resolver::resolve_names(file->loaded.entry->tree, &dictionary,
+			&table);
+	graph.set_file(file->id, file->loaded.entry->tree, &table, &pool,
+			changes);
+	file->in_graph = true;
+}
+int incremental::build_state::get_reparsed_count() {
+	return reparsed_count;
+}
+std::vector<std::string>* incremental::build_state::get_files_to_regenerate() {
+	return &files_to_regenerate;
+}
+bool incremental::build_state::revalidate(const std::string& path,
+		incremental::tracked_file* file) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		free_loaded_file(file->loaded);
+		file->exists = false;
+		file->loaded.status = frontend::file_status::FOPEN_FAILED;
+		return true;
+	}
+	if (file->exists && info.st_size == file->size
+			&& info.st_mtim.tv_sec == file->mtime.tv_sec
+			&& info.st_mtim.tv_nsec == file->mtime.tv_nsec) {
+		return false;
+	}
+	frontend::loaded_file loaded;
+	frontend::read_file(path, loaded, nullptr);
+	std::uint64_t hash = cache::hash_content(loaded.text);
+	bool same = file->exists && hash == file->content_hash
+			&& loaded.status == frontend::file_status::IN_PROGRESS;
+	file->exists = loaded.status != frontend::file_status::FOPEN_FAILED;
+	file->mtime = info.st_mtim;
+	file->size = info.st_size;
+	file->content_hash = hash;
+	if (same) {
+		// only touched
+		free_loaded_file(loaded);
+		return false;
+	}
+	free_loaded_file(file->loaded);
+	file->loaded = loaded;
+	return true;
+}
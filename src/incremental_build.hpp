@@ -0,0 +1,84 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef INCREMENTAL_BUILD_HPP_
+#define INCREMENTAL_BUILD_HPP_
+
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+#include "dependency_graph.hpp"
+#include "frontend.hpp"
+#include "indexer.hpp"
+#include "pass_manager.hpp"
+#include "thread_pool.hpp"
+
+namespace incremental {
+
+// a file which has been built before, as it was the last time it was looked
+// at
+struct tracked_file {
+	int id;
+	bool exists = false;
+	timespec mtime;
+	off_t size = 0;
+	std::uint64_t content_hash = 0;
+	frontend::loaded_file loaded;
+	// whether what's in the dictionary for this file is up to date
+	bool indexed = false;
+	// whether the dependency graph has this file's current tree
+	bool in_graph = false;
+};
+
+// Builds the same files over and over, keeping the tree of every file it has
+// seen and the dictionary of the last build, so that a build only has to
+// parse and index the files which have changed. A file is checked by its
+// modification time and size first, and by the hash of its contents if
+// they've changed. After a successful build, the files which changed are
+// resolved and put in the dependency graph, which works out which files'
+// output has to be generated again.
+class build_state {
+	std::unordered_map<std::string, tracked_file*> files;
+	indexer::index dictionary;
+	dependencies::dependency_graph graph;
+	// what has changed since the last successful build
+	dependencies::change_set changes;
+	std::vector<std::string> files_to_regenerate;
+	concurrency::thread_pool pool;
+	std::vector<passes::pass_manager*> post_parse_passes;
+	int reparsed_count = 0;
+public:
+	// thread_count is the size of the pool changed files are parsed on
+	build_state(int thread_count);
+	~build_state();
+	// does the same as running the compiler on the files, printing errors to
+	// std::cerr, or to the given stream, and returning the exit code.
+	// Relative file names are relative to the directory, and errors are
+	// reported with the names as given
+	int compile(const std::string& directory, std::vector<std::string>& names);
+	int compile(const std::string& directory, std::vector<std::string>& names,
+			std::ostream& errors);
+	// the number of files which were parsed again in the last build
+	int get_reparsed_count();
+	// the files whose output has to be generated again after the last
+	// successful build, by the names they were given
+	std::vector<std::string>* get_files_to_regenerate();
+private:
+	bool revalidate(const std::string& path, tracked_file* file);
+	int index_in_order(std::vector<std::string>& names,
+			std::vector<tracked_file*>& requested, int first,
+			std::ostream& errors);
+	void update_graph(std::vector<std::string>& names,
+			std::vector<tracked_file*>& requested);
+	void resolve_into_graph(tracked_file* file,
+			dependencies::change_set* changes);
+};
+
+}
+
+#endif /* INCREMENTAL_BUILD_HPP_ */
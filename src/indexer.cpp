@@ -2,7 +2,11 @@
  *   Author: Earthcomputer
  */
 
+#include <functional>
+#include <vector>
 #include "indexer.hpp"
+#include "qualified_index.hpp"
+#include "tracing.hpp"
 
 indexer::field_index::field_index(bool global, std::string name,
 		ast::type_ref type) :
@@ -11,22 +15,39 @@ indexer::field_index::field_index(bool global, std::string name,
 bool indexer::field_index::is_global() {
 	return global;
 }
-std::string indexer::field_index::get_name() {
+const std::string& indexer::field_index::get_name() {
 	return name;
 }
 ast::type_ref indexer::field_index::get_type() {
 	return type;
 }
+int indexer::field_index::get_file() {
+	return file;
+}
+void indexer::field_index::set_file(int file) {
+	this->file = file;
+}
+
+std::size_t indexer::hash_signature(const std::string& name,
+		std::vector<ast::type_ref>* parameter_types) {
+	std::size_t ret = std::hash<std::string>()(name);
+	ret = ast::hash_combine(ret, parameter_types->size());
+	for (ast::type_ref& type : *parameter_types) {
+		ret = ast::hash_combine(ret, type.hash());
+	}
+	return ret;
+}
 
 indexer::function_index::function_index(bool global, std::string name,
 		ast::type_ref return_type, std::vector<ast::type_ref>* parameters) :
 		global(global), name(name), return_type(return_type), parameters(
-				parameters) {
+				parameters), signature_hash(
+				indexer::hash_signature(name, parameters)) {
 }
 bool indexer::function_index::is_global() {
 	return global;
 }
-std::string indexer::function_index::get_name() {
+const std::string& indexer::function_index::get_name() {
 	return name;
 }
 ast::type_ref indexer::function_index::get_return_type() {
@@ -35,127 +56,451 @@ ast::type_ref indexer::function_index::get_return_type() {
 std::vector<ast::type_ref>* indexer::function_index::get_parameter_types() {
 	return parameters;
 }
+std::size_t indexer::function_index::get_signature_hash() {
+	return signature_hash;
+}
+bool indexer::function_index::has_parameter_types(
+		std::vector<ast::type_ref>* parameter_types) {
+	if (parameters->size() != parameter_types->size()) {
+		return false;
+	}
+	for (int i = 0, e = parameters->size(); i < e; i++) {
+		if ((*parameters)[i] != (*parameter_types)[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+int indexer::function_index::get_file() {
+	return file;
+}
+void indexer::function_index::set_file(int file) {
+	this->file = file;
+}
 
 indexer::module_index::module_index() :
-		name_exists(false), name(), modules(
-				new std::set<indexer::module_index*>), fields(
-				new std::set<indexer::field_index*>), functions(
-				new std::set<indexer::function_index*>) {
-}
-indexer::module_index::module_index(std::set<indexer::module_index*>* modules,
-		std::set<indexer::field_index*>* fields,
-		std::set<indexer::function_index*>* functions) :
-		name_exists(false), name(), modules(modules), fields(fields), functions(
-				functions) {
-}
-indexer::module_index::module_index(std::string name,
-		std::set<indexer::module_index*>* modules,
-		std::set<indexer::field_index*>* fields,
-		std::set<indexer::function_index*>* functions) :
-		name_exists(true), name(name), modules(modules), fields(fields), functions(
-				functions) {
+		name_exists(false), name() {
+}
+indexer::module_index::module_index(std::string name) :
+		name_exists(true), name(name) {
 }
 indexer::module_index::~module_index() {
-	for (indexer::module_index* ns : *modules) {
+	for (indexer::module_index* ns : modules) {
 		delete ns;
 	}
-	delete modules;
-	for (indexer::field_index* field : *fields) {
+	for (indexer::field_index* field : fields) {
 		delete field;
 	}
-	delete fields;
-	for (indexer::function_index* function : *functions) {
+	for (indexer::function_index* function : functions) {
 		delete function;
 	}
-	delete functions;
+	delete qualified;
 }
 bool indexer::module_index::has_name() {
 	return name_exists;
 }
-std::string indexer::module_index::get_name() {
+const std::string& indexer::module_index::get_name() {
 	return name;
 }
-std::set<indexer::module_index*>* indexer::module_index::get_modules() {
-	return modules;
-}
-std::set<indexer::field_index*>* indexer::module_index::get_fields() {
-	return fields;
-}
-std::set<indexer::function_index*>* indexer::module_index::get_functions() {
-	return functions;
-}
-void indexer::module_index::add_field(indexer::field_index* field) {
-	for (indexer::field_index* existing_field : *fields) {
-		if (existing_field->get_name() == field->get_name()) {
-			throw indexer::indexer_exception(
-					("Duplicate field " + field->get_name()).c_str());
-		}
-	}
-	fields->insert(field);
-}
-void indexer::module_index::add_function(indexer::function_index* function) {
-	for (indexer::function_index* existing_function : *functions) {
-		bool same_name = existing_function->get_name() == function->get_name();
-		std::vector<ast::type_ref>* existing_param_types =
-				existing_function->get_parameter_types();
-		std::vector<ast::type_ref>* param_types =
-				function->get_parameter_types();
-		if (same_name) {
-			if (existing_param_types->size() == param_types->size()) {
-				bool all_same = true;
-				for (int i = 0, e = param_types->size(); i < e; i++) {
-					if ((*existing_param_types)[i] != (*param_types)[i]) {
-						all_same = false;
-						break;
-					}
-				}
-				if (all_same) {
-					throw indexer::indexer_exception(
-							("Duplicate function " + function->get_name()).c_str());
-				}
-			}
-		}
+int indexer::module_index::get_file() {
+	return file;
+}
+void indexer::module_index::set_file(int file) {
+	close_gaps();
+	this->file = file;
+	positions_by_file.clear();
+	indexer::module_index::file_positions& positions = positions_by_file[file];
+	for (std::size_t i = 0, e = modules.size(); i < e; i++) {
+		modules[i]->set_file(file);
+		positions.modules.push_back(i);
+	}
+	for (std::size_t i = 0, e = fields.size(); i < e; i++) {
+		fields[i]->set_file(file);
+		positions.fields.push_back(i);
+	}
+	for (std::size_t i = 0, e = functions.size(); i < e; i++) {
+		functions[i]->set_file(file);
+		positions.functions.push_back(i);
 	}
-	functions->insert(function);
 }
-void indexer::module_index::add_module(indexer::module_index* ns) {
-	if (ns->has_name()) {
-		for (indexer::module_index* existing_namespace : *modules) {
-			if (existing_namespace->has_name()) {
-				if (existing_namespace->get_name() == ns->get_name()) {
-					throw indexer::indexer_exception(
-							("Duplicate namespace " + ns->get_name()).c_str());
-				}
-			}
+std::vector<indexer::module_index*>* indexer::module_index::get_modules() {
+	close_gaps();
+	return &modules;
+}
+std::vector<indexer::field_index*>* indexer::module_index::get_fields() {
+	close_gaps();
+	return &fields;
+}
+std::vector<indexer::function_index*>* indexer::module_index::get_functions() {
+	close_gaps();
+	return &functions;
+}
+indexer::module_index* indexer::module_index::get_module(
+		const std::string& name) {
+	std::unordered_map<std::string, indexer::module_index*>::iterator it =
+			modules_by_name.find(name);
+	return it == modules_by_name.end() ? nullptr : it->second;
+}
+indexer::field_index* indexer::module_index::get_field(
+		const std::string& name) {
+	std::unordered_map<std::string, indexer::field_index*>::iterator it =
+			fields_by_name.find(name);
+	return it == fields_by_name.end() ? nullptr : it->second;
+}
+std::vector<indexer::function_index*>* indexer::module_index::get_overloads(
+		const std::string& name) {
+	std::unordered_map<std::string, std::vector<indexer::function_index*>>::iterator it =
+			overloads_by_name.find(name);
+	return it == overloads_by_name.end() ? nullptr : &it->second;
+}
+bool indexer::module_index::add_field(indexer::field_index* field) {
+	if (get_field(field->get_name()) != nullptr) {
+		return false;
+	}
+	add_names(field);
+	positions_by_file[field->get_file()].fields.push_back(fields.size());
+	fields.push_back(field);
+	return true;
+}
+indexer::function_index* indexer::module_index::get_function(
+		const std::string& name, std::vector<ast::type_ref>* parameter_types) {
+	std::size_t hash = indexer::hash_signature(name, parameter_types);
+	std::pair<
+			std::unordered_multimap<std::size_t, indexer::function_index*>::iterator,
+			std::unordered_multimap<std::size_t, indexer::function_index*>::iterator> range =
+			functions_by_signature.equal_range(hash);
+	for (; range.first != range.second; ++range.first) {
+		indexer::function_index* function = range.first->second;
+		// the hash can collide, so the signature still has to be compared
+		if (function->get_name() == name
+				&& function->has_parameter_types(parameter_types)) {
+			return function;
 		}
 	}
-	modules->insert(ns);
+	return nullptr;
 }
-
-indexer::indexer_exception::indexer_exception(const char* desc) :
-		desc(desc) {
+bool indexer::module_index::add_function(indexer::function_index* function) {
+	if (get_function(function->get_name(), function->get_parameter_types())
+			!= nullptr) {
+		return false;
+	}
+	add_names(function);
+	positions_by_file[function->get_file()].functions.push_back(
+			functions.size());
+	functions.push_back(function);
+	return true;
+}
+bool indexer::module_index::add_module(indexer::module_index* ns) {
+	if (ns->has_name() && get_module(ns->get_name()) != nullptr) {
+		return false;
+	}
+	add_names(ns);
+	positions_by_file[ns->get_file()].modules.push_back(modules.size());
+	modules.push_back(ns);
+	return true;
 }
 
-indexer::indexer_exception::~indexer_exception() {
-	delete desc;
+void report_duplicate(diagnostics::diagnostic_buffer* diags, const char* kind,
+		const std::string& name) {
+	if (diags != nullptr) {
+		diags->report(diagnostics::stage::INDEX,
+				std::string("Duplicate ") + kind + " " + name,
+				diagnostics::NO_POS);
+	}
 }
 
-const char* indexer::indexer_exception::what() {
-	return desc;
+bool indexer::module_index::merge(indexer::module_index* other,
+		diagnostics::diagnostic_buffer* diags) {
+	other->close_gaps();
+	// check everything first so that nothing is moved if there's a duplicate
+	for (indexer::module_index* ns : other->modules) {
+		if (ns->has_name() && get_module(ns->get_name()) != nullptr) {
+			report_duplicate(diags, "namespace", ns->get_name());
+			return false;
+		}
+	}
+	for (indexer::field_index* field : other->fields) {
+		if (get_field(field->get_name()) != nullptr) {
+			report_duplicate(diags, "field", field->get_name());
+			return false;
+		}
+	}
+	for (indexer::function_index* function : other->functions) {
+		if (get_function(function->get_name(), function->get_parameter_types())
+				!= nullptr) {
+			report_duplicate(diags, "function", function->get_name());
+			return false;
+		}
+	}
+	for (indexer::module_index* ns : other->modules) {
+		add_module(ns);
+	}
+	for (indexer::field_index* field : other->fields) {
+		add_field(field);
+	}
+	for (indexer::function_index* function : other->functions) {
+		add_function(function);
+	}
+	other->modules.clear();
+	other->fields.clear();
+	other->functions.clear();
+	other->modules_by_name.clear();
+	other->fields_by_name.clear();
+	other->overloads_by_name.clear();
+	other->functions_by_signature.clear();
+	other->positions_by_file.clear();
+	delete other->qualified;
+	other->qualified = nullptr;
+	return true;
+}
+indexer::module_index* indexer::module_index::retract_file(int file) {
+	indexer::module_index* retracted = new indexer::module_index;
+	std::unordered_map<int, indexer::module_index::file_positions>::iterator it =
+			positions_by_file.find(file);
+	if (it == positions_by_file.end()) {
+		return retracted;
+	}
+	// only what's taken out is touched. It leaves gaps, so that everything
+	// else stays where it is until the gaps are closed up
+	indexer::module_index::file_positions& positions = it->second;
+	for (std::size_t pos : positions.modules) {
+		remove_names(modules[pos]);
+		retracted->add_module(modules[pos]);
+		modules[pos] = nullptr;
+	}
+	for (std::size_t pos : positions.fields) {
+		remove_names(fields[pos]);
+		retracted->add_field(fields[pos]);
+		fields[pos] = nullptr;
+	}
+	for (std::size_t pos : positions.functions) {
+		remove_names(functions[pos]);
+		retracted->add_function(functions[pos]);
+		functions[pos] = nullptr;
+	}
+	gap_count += positions.modules.size() + positions.fields.size()
+			+ positions.functions.size();
+	retracted->retracted_layout_version = layout_version;
+	retracted->retracted_positions = std::move(positions);
+	positions_by_file.erase(it);
+	return retracted;
+}
+void indexer::module_index::restore_file(indexer::module_index* retracted) {
+	retracted->close_gaps();
+	if (retracted->retracted_layout_version != layout_version) {
+		merge(retracted, nullptr);
+		return;
+	}
+	indexer::module_index::file_positions& from =
+			retracted->retracted_positions;
+	for (std::size_t i = 0, e = from.modules.size(); i < e; i++) {
+		indexer::module_index* ns = retracted->modules[i];
+		modules[from.modules[i]] = ns;
+		add_names(ns);
+		positions_by_file[ns->get_file()].modules.push_back(from.modules[i]);
+	}
+	for (std::size_t i = 0, e = from.fields.size(); i < e; i++) {
+		indexer::field_index* field = retracted->fields[i];
+		fields[from.fields[i]] = field;
+		add_names(field);
+		positions_by_file[field->get_file()].fields.push_back(from.fields[i]);
+	}
+	for (std::size_t i = 0, e = from.functions.size(); i < e; i++) {
+		indexer::function_index* function = retracted->functions[i];
+		functions[from.functions[i]] = function;
+		add_names(function);
+		positions_by_file[function->get_file()].functions.push_back(
+				from.functions[i]);
+	}
+	gap_count -= from.modules.size() + from.fields.size()
+			+ from.functions.size();
+	// the retracted index doesn't own any of it any more
+	retracted->modules.clear();
+	retracted->fields.clear();
+	retracted->functions.clear();
+	retracted->modules_by_name.clear();
+	retracted->fields_by_name.clear();
+	retracted->overloads_by_name.clear();
+	retracted->functions_by_signature.clear();
+	retracted->positions_by_file.clear();
+	delete retracted->qualified;
+	retracted->qualified = nullptr;
+}
+indexer::qualified_index* indexer::module_index::get_qualified_index() {
+	if (qualified == nullptr) {
+		qualified = new indexer::qualified_index(this);
+	}
+	return qualified;
+}
+indexer::qualified_index* indexer::module_index::find_qualified_index(
+		std::string& path) {
+	indexer::module_index* root = this;
+	while (root->parent != nullptr) {
+		root = root->parent;
+	}
+	if (root->qualified == nullptr) {
+		return nullptr;
+	}
+	path.clear();
+	for (indexer::module_index* ns = this; ns != root; ns = ns->parent) {
+		if (ns->has_name()) {
+			path = path.empty() ? ns->name : ns->name + "::" + path;
+		}
+	}
+	return root->qualified;
+}
+// moves everything down over the gaps left by retract_file(), which moves
+// everything after them, so where each file's members are is found again
+template<typename T>
+void close_vector_gaps(std::vector<T*>& entries) {
+	std::size_t kept = 0;
+	for (T* entry : entries) {
+		if (entry != nullptr) {
+			entries[kept++] = entry;
+		}
+	}
+	entries.resize(kept);
+}
+void indexer::module_index::close_gaps() {
+	if (gap_count == 0) {
+		return;
+	}
+	close_vector_gaps(modules);
+	close_vector_gaps(fields);
+	close_vector_gaps(functions);
+	positions_by_file.clear();
+	for (std::size_t i = 0, e = modules.size(); i < e; i++) {
+		positions_by_file[modules[i]->get_file()].modules.push_back(i);
+	}
+	for (std::size_t i = 0, e = fields.size(); i < e; i++) {
+		positions_by_file[fields[i]->get_file()].fields.push_back(i);
+	}
+	for (std::size_t i = 0, e = functions.size(); i < e; i++) {
+		positions_by_file[functions[i]->get_file()].functions.push_back(i);
+	}
+	gap_count = 0;
+	layout_version++;
+}
+void indexer::module_index::add_names(indexer::module_index* ns) {
+	if (ns->has_name()) {
+		modules_by_name[ns->get_name()] = ns;
+	}
+	// it isn't the outermost index any more
+	delete ns->qualified;
+	ns->qualified = nullptr;
+	ns->parent = this;
+	std::string path;
+	indexer::qualified_index* names = find_qualified_index(path);
+	if (names != nullptr) {
+		names->add_module(path, ns);
+	}
+}
+void indexer::module_index::add_names(indexer::field_index* field) {
+	fields_by_name[field->get_name()] = field;
+	std::string path;
+	indexer::qualified_index* names = find_qualified_index(path);
+	if (names != nullptr) {
+		names->add_field(path, field);
+	}
+}
+void indexer::module_index::add_names(indexer::function_index* function) {
+	functions_by_signature.insert(
+			std::make_pair(function->get_signature_hash(), function));
+	overloads_by_name[function->get_name()].push_back(function);
+	std::string path;
+	indexer::qualified_index* names = find_qualified_index(path);
+	if (names != nullptr) {
+		names->add_function(path, function);
+	}
+}
+void indexer::module_index::remove_names(indexer::module_index* ns) {
+	if (ns->has_name()) {
+		modules_by_name.erase(ns->get_name());
+	}
+	std::string path;
+	indexer::qualified_index* names = find_qualified_index(path);
+	if (names != nullptr) {
+		names->remove_module(path, ns);
+	}
+	ns->parent = nullptr;
+}
+void indexer::module_index::remove_names(indexer::field_index* field) {
+	fields_by_name.erase(field->get_name());
+	std::string path;
+	indexer::qualified_index* names = find_qualified_index(path);
+	if (names != nullptr) {
+		names->remove_field(path, field);
+	}
+}
+void indexer::module_index::remove_names(indexer::function_index* function) {
+	std::pair<
+			std::unordered_multimap<std::size_t, indexer::function_index*>::iterator,
+			std::unordered_multimap<std::size_t, indexer::function_index*>::iterator> range =
+			functions_by_signature.equal_range(function->get_signature_hash());
+	for (; range.first != range.second; ++range.first) {
+		if (range.first->second == function) {
+			functions_by_signature.erase(range.first);
+			break;
+		}
+	}
+	std::vector<indexer::function_index*>& overloads =
+			overloads_by_name[function->get_name()];
+	for (std::vector<indexer::function_index*>::iterator it = overloads.begin();
+			it != overloads.end(); ++it) {
+		if (*it == function) {
+			overloads.erase(it);
+			break;
+		}
+	}
+	if (overloads.empty()) {
+		overloads_by_name.erase(function->get_name());
+	}
+	std::string path;
+	indexer::qualified_index* names = find_qualified_index(path);
+	if (names != nullptr) {
+		names->remove_function(path, function);
+	}
 }
 
-class indexer_visitor: public ast::ast_visitor {
+// a duplicate is reported and left out, and the rest of the tree is still
+// indexed, so that every duplicate in it is found
+class indexer_pass: public passes::pass {
+	indexer::index* dictionary;
+	int file;
+	diagnostics::diagnostic_buffer* diags;
 	std::vector<indexer::module_index*> module_stack;
+	// duplicate namespaces, which are thrown away once they've been visited
+	std::vector<indexer::module_index*> rejected_modules;
+	bool found_duplicate = false;
 public:
-	indexer_visitor(indexer::index* dictionary) :
-			module_stack(1, dictionary) {
+	indexer_pass(indexer::index* dictionary, int file,
+			diagnostics::diagnostic_buffer* diags) :
+			dictionary(dictionary), file(file), diags(diags), module_stack(1,
+					dictionary) {
+	}
+	std::string get_name() {
+		return "indexer";
+	}
+	int get_node_kinds() {
+		return passes::AST_NODES;
+	}
+	passes::traversal_order get_traversal_order() {
+		return passes::traversal_order::PRE_AND_POST_ORDER;
+	}
+	void begin_tree(std::vector<ast::ast_node*>* nodes) {
+		module_stack.assign(1, dictionary);
 	}
 	void visit_field_node(ast::field_node* field) {
 		bool global = field->get_modifiers()->find(ast::modifier::GLOBAL)
 				!= field->get_modifiers()->end();
-		module_stack.back()->add_field(
-				new indexer::field_index(global, field->get_name(),
-						field->get_type()));
+		indexer::field_index* idx = new indexer::field_index(global,
+				field->get_name(), field->get_type());
+		idx->set_file(file);
+		if (!module_stack.back()->add_field(idx)) {
+			report_duplicate(diags, "field", idx->get_name());
+			found_duplicate = true;
+			delete idx;
+		}
 	}
 	void visit_function_node(ast::function_node* func) {
 		bool global = func->get_modifiers()->find(ast::modifier::GLOBAL)
@@ -164,41 +509,206 @@ public:
 		for (ast::field_node* field : *(func->get_parameters())) {
 			param_types->push_back(field->get_type());
 		}
-		module_stack.back()->add_function(
-				new indexer::function_index(global, func->get_name(),
-						func->get_return_type(), param_types));
+		indexer::function_index* idx = new indexer::function_index(global,
+				func->get_name(), func->get_return_type(), param_types);
+		idx->set_file(file);
+		if (!module_stack.back()->add_function(idx)) {
+			report_duplicate(diags, "function", idx->get_name());
+			found_duplicate = true;
+			delete idx;
+		}
 	}
 	void visit_module_node(ast::module_node* module) {
 		std::string ns = module->get_namespace();
 		indexer::module_index * idx;
 		if (ns.empty()) {
-			idx = new indexer::module_index(
-					new std::set<indexer::module_index*>,
-					new std::set<indexer::field_index*>,
-					new std::set<indexer::function_index*>);
+			idx = new indexer::module_index;
 		} else {
-			idx = new indexer::module_index(ns,
-					new std::set<indexer::module_index*>,
-					new std::set<indexer::field_index*>,
-					new std::set<indexer::function_index*>);
+			idx = new indexer::module_index(ns);
+		}
+		idx->set_file(file);
+		if (!module_stack.back()->add_module(idx)) {
+			report_duplicate(diags, "namespace", idx->get_name());
+			found_duplicate = true;
+			// what's in it is still checked against itself, then thrown away
+			rejected_modules.push_back(idx);
 		}
-		module_stack.back()->add_module(idx);
 		module_stack.push_back(idx);
 	}
-	void visit_ast_node(ast::ast_node* node) {
-		ast::ast_visitor::visit_ast_node(node);
+	void leave_ast_node(ast::ast_node*& node) {
 		if (node->is_of_ast_node_kind(ast::ast_node_kind::MODULE)) {
+			if (!rejected_modules.empty()
+					&& rejected_modules.back() == module_stack.back()) {
+				delete rejected_modules.back();
+				rejected_modules.pop_back();
+			}
 			module_stack.pop_back();
 		}
 	}
 	indexer::index* get_top_index() {
 		return module_stack.back();
 	}
+	bool has_duplicates() {
+		return found_duplicate;
+	}
 };
 
-void indexer::index_ast_tree(std::vector<ast::ast_node*>* tree,
-		indexer::index* dictionary) {
-	indexer_visitor* visitor = new indexer_visitor(dictionary);
-	visitor->visit_all(tree);
-	delete visitor;
+void indexer::add_indexer_pass(passes::pass_manager* manager,
+		indexer::index* dictionary, diagnostics::diagnostic_buffer* diags) {
+	add_indexer_pass(manager, dictionary, indexer::NO_FILE, diags);
+}
+void indexer::add_indexer_pass(passes::pass_manager* manager,
+		indexer::index* dictionary, int file,
+		diagnostics::diagnostic_buffer* diags) {
+	manager->add_pass(new indexer_pass(dictionary, file, diags));
+}
+bool indexer::index_ast_tree(std::vector<ast::ast_node*>* tree,
+		indexer::index* dictionary, diagnostics::diagnostic_buffer* diags) {
+	return index_ast_tree(tree, dictionary, indexer::NO_FILE, diags);
+}
+bool indexer::index_ast_tree(std::vector<ast::ast_node*>* tree,
+		indexer::index* dictionary, int file,
+		diagnostics::diagnostic_buffer* diags) {
+	passes::pass_manager manager;
+	indexer_pass* pass = new indexer_pass(dictionary, file, diags);
+	manager.add_pass(pass);
+	manager.run(tree);
+	return !pass->has_duplicates();
+}
+
+bool indexer::reindex_file(std::vector<ast::ast_node*>* tree,
+		indexer::index* dictionary, int file,
+		diagnostics::diagnostic_buffer* diags) {
+	// a duplicate within the file itself is found before anything changes
+	indexer::index* replacement = new indexer::index;
+	if (!index_ast_tree(tree, replacement, file, diags)) {
+		delete replacement;
+		return false;
+	}
+	indexer::index* old_entries = dictionary->retract_file(file);
+	bool merged = dictionary->merge(replacement, diags);
+	if (!merged) {
+		// merging either moves everything or nothing, so the old entries can
+		// just be put back where they were
+		dictionary->restore_file(old_entries);
+	}
+	delete replacement;
+	delete old_entries;
+	return merged;
+}
+
+void indexer::index_ast_trees_separately(
+		std::vector<std::vector<ast::ast_node*>*>* trees,
+		std::vector<indexer::index*>* indexes, concurrency::thread_pool* pool) {
+	std::vector<std::function<void(int)>> tasks;
+	for (int i = 0, e = trees->size(); i < e; i++) {
+		if ((*indexes)[i] != nullptr) {
+			continue;
+		}
+		tasks.push_back([i, trees, indexes](int worker) {
+			tracing::span span("index", i);
+			indexer::index* idx = new indexer::index;
+			// the duplicates are reported when the trees are indexed again
+			// one at a time
+			if (!indexer::index_ast_tree((*trees)[i], idx, i, nullptr)) {
+				delete idx;
+				return;
+			}
+			(*indexes)[i] = idx;
+		});
+	}
+	pool->run_all(&tasks);
+}
+
+void delete_indexes(std::vector<indexer::index*>* indexes) {
+	for (indexer::index* idx : *indexes) {
+		delete idx;
+	}
+	indexes->clear();
+}
+
+bool merge_indexes_in_parallel(std::vector<indexer::index*>* indexes,
+		indexer::index* dictionary, concurrency::thread_pool* pool) {
+	int index_count = indexes->size();
+	for (indexer::index* idx : *indexes) {
+		if (idx == nullptr) {
+			return false;
+		}
+	}
+	std::vector<std::function<void(int)>> tasks;
+	// merge neighbouring indexes in rounds, so that each index is always
+	// merged into the one for the trees before it
+	for (int step = 1; step < index_count; step *= 2) {
+		tasks.clear();
+		// one flag for each merge, so the tasks don't share anything
+		std::vector<char> failed((index_count + step * 2 - 1) / (step * 2), 0);
+		for (int i = 0; i + step < index_count; i += step * 2) {
+			tasks.push_back([i, step, indexes, &failed](int worker) {
+				if (!(*indexes)[i]->merge((*indexes)[i + step], nullptr)) {
+					failed[i / (step * 2)] = 1;
+					return;
+				}
+				delete (*indexes)[i + step];
+				(*indexes)[i + step] = nullptr;
+			});
+		}
+		pool->run_all(&tasks);
+		for (char f : failed) {
+			if (f) {
+				return false;
+			}
+		}
+	}
+	return index_count == 0 || dictionary->merge((*indexes)[0], nullptr);
+}
+
+bool indexer::merge_indexes(std::vector<std::vector<ast::ast_node*>*>* trees,
+		std::vector<indexer::index*>* indexes, indexer::index* dictionary,
+		concurrency::thread_pool* pool, int& failed_tree,
+		diagnostics::diagnostic_buffer* diags) {
+	return merge_indexes([trees](int i) {
+		return (*trees)[i];
+	}, indexes, dictionary, pool, failed_tree, diags);
+}
+bool indexer::merge_indexes(
+		const std::function<std::vector<ast::ast_node*>*(int)>& get_tree,
+		std::vector<indexer::index*>* indexes, indexer::index* dictionary,
+		concurrency::thread_pool* pool, int& failed_tree,
+		diagnostics::diagnostic_buffer* diags) {
+	int tree_count = indexes->size();
+	for (int i = 0, e = indexes->size(); i < e; i++) {
+		// indexes loaded from a cache don't know which file they're for
+		if ((*indexes)[i] != nullptr) {
+			(*indexes)[i]->set_file(i);
+		}
+	}
+	bool merged;
+	{
+		tracing::span span("merge indexes");
+		merged = merge_indexes_in_parallel(indexes, dictionary, pool);
+	}
+	delete_indexes(indexes);
+	if (merged) {
+		return true;
+	}
+	// the merges don't find duplicates in the same order as indexing the
+	// trees one after another would. The dictionary hasn't been touched, so
+	// index the trees again one at a time to find the first duplicate
+	for (int i = 0; i < tree_count; i++) {
+		std::vector<ast::ast_node*>* tree = get_tree(i);
+		if (tree == nullptr
+				|| !indexer::index_ast_tree(tree, dictionary, i, diags)) {
+			failed_tree = i;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool indexer::index_ast_trees(std::vector<std::vector<ast::ast_node*>*>* trees,
+		indexer::index* dictionary, concurrency::thread_pool* pool,
+		int& failed_tree, diagnostics::diagnostic_buffer* diags) {
+	std::vector<indexer::index*> indexes(trees->size(), nullptr);
+	index_ast_trees_separately(trees, &indexes, pool);
+	return merge_indexes(trees, &indexes, dictionary, pool, failed_tree, diags);
 }
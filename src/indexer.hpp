@@ -5,73 +5,200 @@
 #ifndef INDEXER_HPP_
 #define INDEXER_HPP_
 
-#include <set>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "crosslang_ast.hpp"
+#include "diagnostics.hpp"
+#include "pass_manager.hpp"
+#include "thread_pool.hpp"
 
 namespace indexer {
 
+// the file of an entry which didn't come from any file in particular
+const int NO_FILE = -1;
+
 class field_index {
 	bool global;
 	std::string name;
 	ast::type_ref type;
+	int file = NO_FILE;
 public:
 	field_index(bool global, std::string name, ast::type_ref type);
 	bool is_global();
-	std::string get_name();
+	const std::string& get_name();
 	ast::type_ref get_type();
+	// the position of the file it came from in the list of files
+	int get_file();
+	void set_file(int file);
 };
 
+// the hash of a function's name and parameter types, which is all that tells
+// one overload apart from another
+std::size_t hash_signature(const std::string& name,
+		std::vector<ast::type_ref>* parameter_types);
+
 class function_index {
 	bool global;
 	std::string name;
 	ast::type_ref return_type;
 	std::vector<ast::type_ref>* parameters;
+	std::size_t signature_hash;
+	int file = NO_FILE;
 public:
 	function_index(bool global, std::string name, ast::type_ref return_type,
 			std::vector<ast::type_ref>* parameters);
 	bool is_global();
-	std::string get_name();
+	const std::string& get_name();
 	ast::type_ref get_return_type();
 	std::vector<ast::type_ref>* get_parameter_types();
+	std::size_t get_signature_hash();
+	bool has_parameter_types(std::vector<ast::type_ref>* parameter_types);
+	int get_file();
+	void set_file(int file);
 };
 
+class qualified_index;
+
 class module_index {
+	// where the members which came from one file are in the vectors
+	struct file_positions {
+		std::vector<std::size_t> modules;
+		std::vector<std::size_t> fields;
+		std::vector<std::size_t> functions;
+	};
 	bool name_exists;
 	std::string name;
-	std::set<module_index*>* modules;
-	std::set<field_index*>* fields;
-	std::set<function_index*>* functions;
+	// the vectors keep everything in the order it was added, and the maps
+	// are for looking things up by name. Retracting a file leaves nullptr
+	// gaps in the vectors, which are closed up before they're next read
+	std::vector<module_index*> modules;
+	std::vector<field_index*> fields;
+	std::vector<function_index*> functions;
+	std::unordered_map<std::string, module_index*> modules_by_name;
+	std::unordered_map<std::string, field_index*> fields_by_name;
+	std::unordered_map<std::string, std::vector<function_index*>> overloads_by_name;
+	std::unordered_multimap<std::size_t, function_index*> functions_by_signature;
+	std::unordered_map<int, file_positions> positions_by_file;
+	std::size_t gap_count = 0;
+	// counts how many times the gaps have been closed up, which moves
+	// everything after them
+	int layout_version = 0;
+	// for an index returned by retract_file(), where its members were
+	int retracted_layout_version = -1;
+	file_positions retracted_positions;
+	int file = NO_FILE;
+	// the module this one has been added to, if any
+	module_index* parent = nullptr;
+	// only the outermost index has one, once it has been asked for
+	qualified_index* qualified = nullptr;
 public:
 	module_index();
-	module_index(std::set<module_index*>* modules,
-			std::set<field_index*>* fields,
-			std::set<function_index*>* functions);
-	module_index(std::string name, std::set<module_index*>* modules,
-			std::set<field_index*>* fields,
-			std::set<function_index*>* functions);
+	module_index(std::string name);
 	~module_index();
 	bool has_name();
-	std::string get_name();
-	std::set<module_index*>* get_modules();
-	std::set<field_index*>* get_fields();
-	std::set<function_index*>* get_functions();
-	void add_module(module_index* ns);
-	void add_field(field_index* field);
-	void add_function(function_index* function);
+	const std::string& get_name();
+	int get_file();
+	// sets the file of this module and of everything in it. It can't have
+	// been added to another module yet
+	void set_file(int file);
+	std::vector<module_index*>* get_modules();
+	std::vector<field_index*>* get_fields();
+	std::vector<function_index*>* get_functions();
+	// these return nullptr if there's nothing with that name
+	module_index* get_module(const std::string& name);
+	field_index* get_field(const std::string& name);
+	std::vector<function_index*>* get_overloads(const std::string& name);
+	// finds the overload whose parameter types are exactly the given types
+	function_index* get_function(const std::string& name,
+			std::vector<ast::type_ref>* parameter_types);
+	// these add nothing and return false if it would be a duplicate
+	bool add_module(module_index* ns);
+	bool add_field(field_index* field);
+	bool add_function(function_index* function);
+	// moves everything in the other index into this one, leaving the other
+	// index empty. If anything would be a duplicate, neither index is changed,
+	// the duplicate is reported to the diagnostics unless they're nullptr,
+	// and false is returned
+	bool merge(module_index* other, diagnostics::diagnostic_buffer* diags);
+	// Takes everything which came from the file out of this index, and
+	// returns a new index holding it. A module and everything in it always
+	// come from the same file, so only the members of this module which came
+	// from the file are looked at. The order of everything else is kept
+	module_index* retract_file(int file);
+	// puts what retract_file() returned back where it was, leaving the
+	// retracted index empty. Nothing else from its file can have been added
+	// since. If the gaps have been closed up in the meantime, it's added to
+	// the end instead
+	void restore_file(module_index* retracted);
+	// everything in this index by its fully qualified name. It's made the
+	// first time it's asked for, and kept up to date from then on as
+	// anything is added to or taken out of this index or the modules in it.
+	// This index can't be in another module
+	qualified_index* get_qualified_index();
+private:
+	// the qualified index of the outermost index this module is in, if it
+	// has one, and the qualified name of this module in it
+	qualified_index* find_qualified_index(std::string& path);
+	void close_gaps();
+	void add_names(module_index* ns);
+	void add_names(field_index* field);
+	void add_names(function_index* function);
+	void remove_names(module_index* ns);
+	void remove_names(field_index* field);
+	void remove_names(function_index* function);
 };
 
 typedef module_index index;
 
-class indexer_exception: public std::exception {
-	const char* desc;
-public:
-	indexer_exception(const char* desc);
-	~indexer_exception() throw ();
-	const char* what();
-};
-
-void index_ast_tree(std::vector<ast::ast_node*>* tree, index* dictionary);
+// returns false if anything in the tree is a duplicate. Every duplicate is
+// reported to the diagnostics unless they're nullptr, and everything else is
+// still indexed
+bool index_ast_tree(std::vector<ast::ast_node*>* tree, index* dictionary,
+		diagnostics::diagnostic_buffer* diags);
+// the same, marking everything as having come from the given file
+bool index_ast_tree(std::vector<ast::ast_node*>* tree, index* dictionary,
+		int file, diagnostics::diagnostic_buffer* diags);
+// indexes each tree into its own index on the pool's workers, then merges
+// them into the dictionary. Duplicates are reported as if the trees were
+// indexed one after another, so if false is returned, the diagnostics are for
+// the first tree in the list which has a duplicate, and failed_tree is set to
+// its position
+bool index_ast_trees(std::vector<std::vector<ast::ast_node*>*>* trees,
+		index* dictionary, concurrency::thread_pool* pool, int& failed_tree,
+		diagnostics::diagnostic_buffer* diags);
+// the two halves of index_ast_trees(). The first indexes each tree which
+// doesn't have an index yet, leaving trees with a duplicate in them without
+// one. The second merges the indexes into the dictionary and deletes them.
+// Everything is marked as having come from the file at the same position as
+// its tree
+void index_ast_trees_separately(std::vector<std::vector<ast::ast_node*>*>* trees,
+		std::vector<index*>* indexes, concurrency::thread_pool* pool);
+bool merge_indexes(std::vector<std::vector<ast::ast_node*>*>* trees,
+		std::vector<index*>* indexes, index* dictionary,
+		concurrency::thread_pool* pool, int& failed_tree,
+		diagnostics::diagnostic_buffer* diags);
+// the same, but the trees are only asked for if they have to be indexed
+// again, so a tree which doesn't exist yet need not be made unless there's a
+// duplicate. A null tree fails as if it had a duplicate in it
+bool merge_indexes(
+		const std::function<std::vector<ast::ast_node*>*(int)>& get_tree,
+		std::vector<index*>* indexes, index* dictionary,
+		concurrency::thread_pool* pool, int& failed_tree,
+		diagnostics::diagnostic_buffer* diags);
+// replaces what a file added to the dictionary with the index of its new
+// tree. Only the names in the new tree are checked for duplicates. If there
+// is a duplicate, the dictionary is left with the file's old entries, the
+// duplicates are reported and false is returned
+bool reindex_file(std::vector<ast::ast_node*>* tree, index* dictionary,
+		int file, diagnostics::diagnostic_buffer* diags);
+// duplicates found by the pass are reported to the diagnostics
+void add_indexer_pass(passes::pass_manager* manager, index* dictionary,
+		diagnostics::diagnostic_buffer* diags);
+void add_indexer_pass(passes::pass_manager* manager, index* dictionary,
+		int file, diagnostics::diagnostic_buffer* diags);
 
 }
 
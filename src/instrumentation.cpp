@@ -0,0 +1,203 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <sys/resource.h>
+#include "arena.hpp"
+#include "instrumentation.hpp"
+
+thread_local long thread_allocations = 0;
+thread_local long thread_allocated_bytes = 0;
+bool counting_allocations = false;
+
+void instrumentation::start_counting_allocations() {
+	if (!counting_allocations) {
+		counting_allocations = true;
+		memory::add_allocation_hook();
+	}
+}
+void instrumentation::note_allocation(std::size_t size) {
+	if (counting_allocations) {
+		thread_allocations++;
+		thread_allocated_bytes += size;
+	}
+}
+
+long instrumentation::get_thread_allocations() {
+	return thread_allocations;
+}
+long instrumentation::get_thread_allocated_bytes() {
+	return thread_allocated_bytes;
+}
+double instrumentation::get_thread_cpu_seconds() {
+	timespec time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+		return 0;
+	}
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+long instrumentation::get_peak_rss_kb() {
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+	return usage.ru_maxrss;
+}
+
+instrumentation::phase_scope::phase_scope(
+		std::vector<instrumentation::phase_sample>* samples,
+		const std::string& phase) :
+		samples(samples) {
+	if (samples == nullptr) {
+		return;
+	}
+	this->phase = phase;
+	start_cpu = get_thread_cpu_seconds();
+	start_allocations = thread_allocations;
+	start_bytes = thread_allocated_bytes;
+	start = std::chrono::steady_clock::now();
+}
+instrumentation::phase_scope::~phase_scope() {
+	if (samples == nullptr) {
+		return;
+	}
+	instrumentation::phase_sample sample;
+	sample.wall_seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	sample.cpu_seconds = get_thread_cpu_seconds() - start_cpu;
+	sample.allocations = thread_allocations - start_allocations;
+	sample.allocated_bytes = thread_allocated_bytes - start_bytes;
+	sample.phase = phase;
+	samples->push_back(sample);
+}
+
+void instrumentation::phase_report::add_file(const std::string& file,
+		std::vector<instrumentation::phase_sample>& phases) {
+	files.push_back(file);
+	samples.push_back(phases);
+}
+std::vector<instrumentation::phase_sample> instrumentation::phase_report::get_totals() {
+	std::vector<instrumentation::phase_sample> totals;
+	for (std::vector<instrumentation::phase_sample>& phases : samples) {
+		for (instrumentation::phase_sample& sample : phases) {
+			instrumentation::phase_sample* total = nullptr;
+			for (instrumentation::phase_sample& t : totals) {
+				if (t.phase == sample.phase) {
+					total = &t;
+					break;
+				}
+			}
+			if (total == nullptr) {
+				totals.push_back(instrumentation::phase_sample());
+				total = &totals.back();
+				total->phase = sample.phase;
+				total->has_cpu_and_memory = sample.has_cpu_and_memory;
+			}
+			total->wall_seconds += sample.wall_seconds;
+			total->cpu_seconds += sample.cpu_seconds;
+			total->allocations += sample.allocations;
+			total->allocated_bytes += sample.allocated_bytes;
+		}
+	}
+	return totals;
+}
+
+void print_time_row(std::ostream& out, instrumentation::phase_sample& sample) {
+	out << "  " << std::left << std::setw(32) << sample.phase << std::right
+			<< std::setw(12) << sample.wall_seconds * 1000;
+	if (sample.has_cpu_and_memory) {
+		out << std::setw(12) << sample.cpu_seconds * 1000;
+	}
+	out << std::endl;
+}
+void instrumentation::phase_report::print_times(std::ostream& out) {
+	std::ios::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(3);
+	out << std::left << std::setw(34) << "Phase" << std::right << std::setw(12)
+			<< "Wall (ms)" << std::setw(12) << "CPU (ms)" << std::endl;
+	for (int i = 0, e = files.size(); i < e; i++) {
+		out << files[i] << std::endl;
+		for (instrumentation::phase_sample& sample : samples[i]) {
+			print_time_row(out, sample);
+		}
+	}
+	out << "Total" << std::endl;
+	for (instrumentation::phase_sample& sample : get_totals()) {
+		print_time_row(out, sample);
+	}
+	out.flags(flags);
+}
+void instrumentation::phase_report::print_memory(std::ostream& out) {
+	out << std::left << std::setw(34) << "Phase" << std::right << std::setw(14)
+			<< "Allocations" << std::setw(16) << "Bytes" << std::endl;
+	for (instrumentation::phase_sample& sample : get_totals()) {
+		if (!sample.has_cpu_and_memory) {
+			continue;
+		}
+		out << "  " << std::left << std::setw(32) << sample.phase << std::right
+				<< std::setw(14) << sample.allocations << std::setw(16)
+				<< sample.allocated_bytes << std::endl;
+	}
+	out << "Peak RSS: " << get_peak_rss_kb() << " KB" << std::endl;
+}
+
+void instrumentation::write_json_string(std::ostream& out,
+		const std::string& str) {
+	out << '"';
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			out << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+void write_json_phases(std::ostream& out,
+		std::vector<instrumentation::phase_sample>& phases, bool times,
+		bool memory) {
+	out << "[";
+	for (int i = 0, e = phases.size(); i < e; i++) {
+		instrumentation::phase_sample& sample = phases[i];
+		out << (i == 0 ? "" : ", ") << "{\"phase\": ";
+		instrumentation::write_json_string(out, sample.phase);
+		if (times) {
+			out << ", \"wall_ms\": " << sample.wall_seconds * 1000;
+			if (sample.has_cpu_and_memory) {
+				out << ", \"cpu_ms\": " << sample.cpu_seconds * 1000;
+			}
+		}
+		if (memory && sample.has_cpu_and_memory) {
+			out << ", \"allocations\": " << sample.allocations
+					<< ", \"allocated_bytes\": " << sample.allocated_bytes;
+		}
+		out << "}";
+	}
+	out << "]";
+}
+void instrumentation::phase_report::write_json(std::ostream& out, bool times,
+		bool memory) {
+	out << "{";
+	if (memory) {
+		out << "\"peak_rss_kb\": " << get_peak_rss_kb() << ", ";
+	}
+	out << "\"files\": [";
+	for (int i = 0, e = files.size(); i < e; i++) {
+		out << (i == 0 ? "" : ", ") << "{\"file\": ";
+		instrumentation::write_json_string(out, files[i]);
+		out << ", \"phases\": ";
+		write_json_phases(out, samples[i], times, memory);
+		out << "}";
+	}
+	out << "], \"totals\": ";
+	std::vector<instrumentation::phase_sample> totals = get_totals();
+	write_json_phases(out, totals, times, memory);
+	out << "}" << std::endl;
+}
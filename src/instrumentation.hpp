@@ -0,0 +1,80 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef INSTRUMENTATION_HPP_
+#define INSTRUMENTATION_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Measuring how long each phase of the compiler takes, and how much memory it
+// allocates. Once counting has started, every allocation through operator new
+// is counted on the thread which makes it, so a phase's allocations are the
+// difference in the count from when it started to when it finished, as long
+// as it runs on one thread.
+namespace instrumentation {
+
+struct phase_sample {
+	std::string phase;
+	double wall_seconds = 0;
+	// passes which are walked together can only be timed by the wall clock,
+	// so they don't have the rest
+	bool has_cpu_and_memory = true;
+	double cpu_seconds = 0;
+	long allocations = 0;
+	long allocated_bytes = 0;
+};
+
+// allocations aren't counted until this is called, so that operator new
+// costs nothing extra when nothing is being measured. It has to be called
+// before any other threads are started
+void start_counting_allocations();
+// called by operator new for every allocation
+void note_allocation(std::size_t size);
+// the number of allocations and the bytes allocated by this thread so far
+long get_thread_allocations();
+long get_thread_allocated_bytes();
+// the CPU time used by this thread so far
+double get_thread_cpu_seconds();
+// the most memory the process has had at once, in kilobytes
+long get_peak_rss_kb();
+
+// writes a string as a JSON string, in quotes
+void write_json_string(std::ostream& out, const std::string& str);
+
+// measures a phase on one thread, from when it's created until it goes out
+// of scope. Nothing is measured if there's nowhere to put the sample
+class phase_scope {
+	std::vector<phase_sample>* samples;
+	std::string phase;
+	std::chrono::steady_clock::time_point start;
+	double start_cpu = 0;
+	long start_allocations = 0;
+	long start_bytes = 0;
+public:
+	phase_scope(std::vector<phase_sample>* samples, const std::string& phase);
+	~phase_scope();
+};
+
+// the samples for every file, and for the phases which work on all the files
+// at once, which are reported as the file "(all files)"
+class phase_report {
+	std::vector<std::string> files;
+	std::vector<std::vector<phase_sample>> samples;
+public:
+	void add_file(const std::string& file, std::vector<phase_sample>& phases);
+	void print_times(std::ostream& out);
+	void print_memory(std::ostream& out);
+	void write_json(std::ostream& out, bool times, bool memory);
+private:
+	// the totals of each phase, in the order they first turn up
+	std::vector<phase_sample> get_totals();
+};
+
+}
+
+#endif /* INSTRUMENTATION_HPP_ */
@@ -0,0 +1,94 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef LOOKUP_TABLE_HPP_
+#define LOOKUP_TABLE_HPP_
+
+#include <cstddef>
+
+// Fixed tables of names, such as the operators and keywords, as sorted arrays
+// which are built by the compiler rather than when the program starts, and
+// looked up by binary search. A table is either an array of names, or an
+// array of structs with a name member. Everything here is constexpr, so a
+// table can be checked to be sorted with a static_assert.
+namespace lookup {
+
+constexpr int compare(const char* a, const char* b) {
+	return *a != *b ? (static_cast<unsigned char>(*a)
+			< static_cast<unsigned char>(*b) ? -1 : 1) :
+			*a == '\0' ? 0 : compare(a + 1, b + 1);
+}
+
+// whether the string starts with the prefix
+constexpr bool starts_with(const char* str, const char* prefix) {
+	return *prefix == '\0' ? true :
+			*str != *prefix ? false : starts_with(str + 1, prefix + 1);
+}
+
+constexpr const char* get_name(const char* entry) {
+	return entry;
+}
+template<typename T>
+constexpr const char* get_name(const T& entry) {
+	return entry.name;
+}
+
+// the first entry in [first, last) whose name isn't less than the key
+template<typename T, std::size_t N>
+constexpr std::size_t lower_bound(const T (&table)[N], const char* key,
+		std::size_t first, std::size_t last) {
+	return first == last ? first :
+			compare(get_name(table[first + (last - first) / 2]), key) < 0 ?
+					lower_bound(table, key, first + (last - first) / 2 + 1,
+							last) :
+					lower_bound(table, key, first, first + (last - first) / 2);
+}
+template<typename T, std::size_t N>
+constexpr std::size_t lower_bound(const T (&table)[N], const char* key) {
+	return lower_bound(table, key, 0, N);
+}
+
+template<typename T, std::size_t N>
+constexpr int index_of(const T (&table)[N], const char* key,
+		std::size_t found) {
+	return found != N && compare(get_name(table[found]), key) == 0 ?
+			static_cast<int>(found) : -1;
+}
+// returns -1 if there's no entry with the name
+template<typename T, std::size_t N>
+constexpr int index_of(const T (&table)[N], const char* key) {
+	return index_of(table, key, lower_bound(table, key));
+}
+template<typename T, std::size_t N>
+constexpr bool contains(const T (&table)[N], const char* key) {
+	return index_of(table, key) != -1;
+}
+
+// whether any entry's name starts with the prefix. Those entries are all
+// together, starting from where the prefix would be
+template<typename T, std::size_t N>
+constexpr bool contains_prefix(const T (&table)[N], const char* prefix,
+		std::size_t found) {
+	return found != N && starts_with(get_name(table[found]), prefix);
+}
+template<typename T, std::size_t N>
+constexpr bool contains_prefix(const T (&table)[N], const char* prefix) {
+	return contains_prefix(table, prefix, lower_bound(table, prefix));
+}
+
+template<typename T, std::size_t N>
+constexpr bool is_sorted(const T (&table)[N], std::size_t from) {
+	return from + 1 >= N ? true :
+			compare(get_name(table[from]), get_name(table[from + 1])) >= 0 ?
+					false : is_sorted(table, from + 1);
+}
+// whether the names are in order, with none repeated
+template<typename T, std::size_t N>
+constexpr bool is_sorted(const T (&table)[N]) {
+	return is_sorted(table, 0);
+}
+
+}
+
+#endif /* LOOKUP_TABLE_HPP_ */
@@ -5,38 +5,39 @@
 #include <fstream>
 #include <vector>
 #include <iostream>
+#include <cerrno>
+#include <climits>
 #include <cstdlib>
 #include <ctime>
+#include <functional>
 #include <map>
 
 #include "tokenizer.hpp"
 #include "crosslang_ast.hpp"
 #include "parser.hpp"
 #include "indexer.hpp"
+#include "frozen_index.hpp"
+#include "constant_folder.hpp"
+#include "compilation_cache.hpp"
+#include "pass_manager.hpp"
+#include "thread_pool.hpp"
+#include "frontend.hpp"
+#include "batch_mode.hpp"
+#include "compiler_daemon.hpp"
+#include "file_watcher.hpp"
+#include "instrumentation.hpp"
+#include "tracing.hpp"
 #include "errorcodes.hpp"
 
-int get_line_number(std::vector<int> line_numbers, int pos) {
-	int size = line_numbers.size();
-	if (size == 0) {
-		return 1;
-	}
-	for (int i = 0; i < size; i++) {
-		if (line_numbers[i] > pos) {
-			return i + 1;
-		}
-	}
-	return size;
-}
-
-void print_field_index(indexer::field_index* idx) {
-	std::cout << "Field: " << idx->get_type().to_string() << " "
-			<< idx->get_name() << std::endl;
+void print_field_index(const indexer::frozen_field* idx) {
+	std::cout << "Field: " << idx->type->to_string() << " "
+			<< idx->name.to_string() << std::endl;
 }
 
-void print_function_index(indexer::function_index* idx) {
+void print_function_index(const indexer::frozen_function* idx) {
 	std::string params = "(";
 	bool first = true;
-	for (ast::type_ref& type : *(idx->get_parameter_types())) {
+	for (const ast::type_ref& type : idx->parameter_types) {
 		if (!first) {
 			params += ", ";
 		}
@@ -44,109 +45,351 @@ void print_function_index(indexer::function_index* idx) {
 		params += type.to_string();
 	}
 	params += ")";
-	std::cout << "Function: " << idx->get_return_type().to_string() << " "
-			<< idx->get_name() << " " << params << std::endl;
+	std::cout << "Function: " << idx->return_type->to_string() << " "
+			<< idx->name.to_string() << " " << params << std::endl;
 }
 
-void print_module_index(indexer::module_index* idx) {
+// the index is frozen first, so everything is printed sorted by name
+void print_module_index(const indexer::frozen_module* idx) {
 	std::string str = "Module";
-	if (idx->has_name()) {
-		str += " " + idx->get_name();
+	if (idx->has_name) {
+		str += " " + idx->name.to_string();
 	}
 	str += ":";
 	std::cout << str << std::endl;
 	std::cout << "{" << std::endl;
-	for (indexer::module_index* submodule : *(idx->get_modules())) {
-		print_module_index(submodule);
+	for (const indexer::frozen_module& submodule : idx->modules) {
+		print_module_index(&submodule);
 	}
-	for (indexer::field_index* subfield : *(idx->get_fields())) {
-		print_field_index(subfield);
+	for (const indexer::frozen_field& subfield : idx->fields) {
+		print_field_index(&subfield);
 	}
-	for (indexer::function_index* subfunction : *(idx->get_functions())) {
-		print_function_index(subfunction);
+	for (const indexer::frozen_function& subfunction : idx->functions) {
+		print_function_index(&subfunction);
 	}
 	std::cout << "}" << std::endl;
 }
 
-void print_random_witty_comment() {
-	std::cerr << "-----------------------" << std::endl;
-	const int LENGTH = 4;
-	const std::string comments[LENGTH] = {
-			"And you call yourself a programmer?",
-			"Unlike you, I don't make mitsakes",
-			"What on Earth were you thinking when you typed that?",
-			"Wrong! Try again!" };
-	std::cerr << comments[rand() % LENGTH] << std::endl;
+// writes the entries for the files which weren't in the cache, now that
+// they've been indexed. Files with errors in them aren't cached
+void store_cache_entries(std::vector<indexer::index*>* indexes,
+		std::vector<cache::cache_entry*>* new_entries,
+		cache::compilation_cache* cache, concurrency::thread_pool* pool) {
+	std::vector<std::function<void(int)>> tasks;
+	for (int i = 0, e = new_entries->size(); i < e; i++) {
+		cache::cache_entry* entry = (*new_entries)[i];
+		if (entry == nullptr) {
+			continue;
+		}
+		(*new_entries)[i] = nullptr;
+		entry->index = (*indexes)[i];
+		tasks.push_back([entry, cache](int worker) {
+			if (entry->index != nullptr) {
+				cache->store(*entry);
+			}
+			delete entry;
+		});
+	}
+	pool->run_all(&tasks);
+}
+
+// indexes the trees parsed so far, which are in the same order as the files.
+// Trees loaded from the cache already have an index, and are left out of the
+// trees. They're only made from their entries if there's a duplicate
+bool index_files(std::vector<std::string>& files,
+		std::vector<std::vector<ast::ast_node*>*>* trees,
+		std::vector<indexer::index*>* indexes,
+		std::vector<cache::cache_entry*>* cached_entries,
+		std::vector<cache::cache_entry*>* new_entries,
+		indexer::index* dictionary, cache::compilation_cache* cache,
+		concurrency::thread_pool* pool,
+		std::vector<instrumentation::phase_sample>* phases) {
+	tracing::span span("index and merge");
+	instrumentation::phase_scope scope(phases, "index and merge");
+	indexer::index_ast_trees_separately(trees, indexes, pool);
+	if (cache != nullptr) {
+		store_cache_entries(indexes, new_entries, cache, pool);
+	}
+	int failed_tree;
+	diagnostics::diagnostic_buffer diags;
+	std::function<std::vector<ast::ast_node*>*(int)> get_tree =
+			[trees, cached_entries, &diags](int i) {
+				if ((*cached_entries)[i] == nullptr) {
+					return (*trees)[i];
+				}
+				std::vector<ast::ast_node*>* tree =
+						cache::get_tree(*(*cached_entries)[i]);
+				if (tree == nullptr) {
+					diags.report(diagnostics::stage::INDEX,
+							"The cached tree is broken, delete the cache",
+							diagnostics::NO_POS);
+				}
+				return tree;
+			};
+	if (!indexer::merge_indexes(get_tree, indexes, dictionary, pool,
+			failed_tree, &diags)) {
+		frontend::report_index_error(files[failed_tree], &diags);
+		return false;
+	}
+	return true;
+}
+
+// indexes the loaded files, and reports the first error in the order of the
+// files, as if they were done one after another. Returns the exit code
+int build_files(std::vector<std::string>& files,
+		std::vector<frontend::loaded_file>& loaded, indexer::index* dictionary,
+		cache::compilation_cache* cache, concurrency::thread_pool* pool,
+		std::vector<instrumentation::phase_sample>* phases) {
+	std::map<std::string, std::vector<ast::ast_node * > * > ast_by_filename;
+	std::vector<std::vector<ast::ast_node*>*> trees;
+	std::vector<indexer::index*> indexes;
+	std::vector<cache::cache_entry*> cached_entries;
+	std::vector<cache::cache_entry*> new_entries;
+	int ret = SUCCESS;
+	for (int i = 0, e = files.size(); i < e; i++) {
+		frontend::loaded_file& result = loaded[i];
+		if (result.status != frontend::file_status::LOADED) {
+			// the files before this one would have been indexed by now if
+			// they were done one at a time, so their errors come first
+			if (!index_files(files, &trees, &indexes, &cached_entries,
+					&new_entries, dictionary, cache, pool, phases)) {
+				ret = ERR_INDEX_FAILED;
+			} else {
+				ret = frontend::report_file_error(files[i], result);
+			}
+			break;
+		}
+		cache::cache_entry* entry = result.entry;
+		ast_by_filename[files[i]] = entry->tree;
+		trees.push_back(entry->tree);
+		indexes.push_back(result.index);
+		if (result.from_cache) {
+			cached_entries.push_back(entry);
+			new_entries.push_back(nullptr);
+		} else {
+			cached_entries.push_back(nullptr);
+			if (cache != nullptr) {
+				new_entries.push_back(entry);
+			} else {
+				new_entries.push_back(nullptr);
+				delete entry;
+			}
+		}
+	}
+
+	if (ret == SUCCESS
+			&& !index_files(files, &trees, &indexes, &cached_entries,
+					&new_entries, dictionary, cache, pool, phases)) {
+		ret = ERR_INDEX_FAILED;
+	}
+	// the cached entries hold their files' images
+	for (cache::cache_entry* entry : cached_entries) {
+		delete entry;
+	}
+	return ret;
+}
+
+// compiles the files one after another, each a piece at a time, so that the
+// memory used doesn't grow with the size of the files. Nothing is cached
+int stream_files(std::vector<std::string>& files,
+		indexer::index* dictionary) {
+	passes::pass_manager post_parse_passes;
+	frontend::add_post_parse_passes(&post_parse_passes);
+	for (int i = 0, e = files.size(); i < e; i++) {
+		frontend::loaded_file result;
+		diagnostics::diagnostic_buffer index_diags;
+		if (frontend::stream_file(files[i], i, result, dictionary,
+				&post_parse_passes, &index_diags)) {
+			continue;
+		}
+		if (result.status != frontend::file_status::LOADED) {
+			return frontend::report_file_error(files[i], result);
+		}
+		frontend::report_index_error(files[i], &index_diags);
+		return ERR_INDEX_FAILED;
+	}
+	return SUCCESS;
+}
+
+// returns false if the value isn't a number of jobs. 0 is one per core
+bool parse_job_count(const std::string& value, int& jobs) {
+	if (value.empty()) {
+		return false;
+	}
+	char* end;
+	errno = 0;
+	long count = strtol(value.c_str(), &end, 10);
+	if (*end != '\0' || errno != 0 || count < 0 || count > INT_MAX) {
+		return false;
+	}
+	jobs = count;
+	return true;
+}
+
+// prints everything in the dictionary once the build has finished with it
+void dump_index(indexer::index* dictionary) {
+	indexer::frozen_index* frozen = indexer::freeze(dictionary);
+	print_module_index(frozen->get_root());
+	delete frozen;
 }
 
 int main(const int argc, char* argv[]) {
 	srand(time(NULL));
 
 	std::vector<std::string> args;
+	cache::compilation_cache* cache = nullptr;
+	// files are built one at a time unless -j says otherwise, and -j 0
+	// means one thread per core
+	int jobs = 1;
+	bool pipelined = false;
+	bool show_stage_stats = false;
+	std::string daemon_socket;
+	std::string client_socket;
+	std::string stop_socket;
+	bool watch = false;
+	bool streaming = false;
+	bool dump = false;
+	bool time_passes = false;
+	bool mem_stats = false;
+	std::string stats_json;
+	std::string trace_file;
+	bool batch_mode = false;
+	batch::framing batch_framing = batch::framing::NUL_DELIMITED;
 	for (int i = 1; i < argc; i++) {
 		std::string str(argv[i]);
-		args.push_back(str);
+		if (str.compare(0, 12, "--cache-dir=") == 0) {
+			cache = new cache::compilation_cache(str.substr(12));
+		} else if (str.compare(0, 9, "--daemon=") == 0) {
+			daemon_socket = str.substr(9);
+		} else if (str.compare(0, 10, "--connect=") == 0) {
+			client_socket = str.substr(10);
+		} else if (str.compare(0, 14, "--stop-daemon=") == 0) {
+			stop_socket = str.substr(14);
+		} else if (str == "--time-passes") {
+			time_passes = true;
+		} else if (str == "--mem-stats") {
+			mem_stats = true;
+		} else if (str.compare(0, 13, "--stats-json=") == 0) {
+			stats_json = str.substr(13);
+		} else if (str.compare(0, 8, "--trace=") == 0) {
+			trace_file = str.substr(8);
+		} else if (str == "--batch" || str == "--batch=nul") {
+			batch_mode = true;
+			batch_framing = batch::framing::NUL_DELIMITED;
+		} else if (str == "--batch=length") {
+			batch_mode = true;
+			batch_framing = batch::framing::LENGTH_PREFIXED;
+		} else if (str == "--watch") {
+			watch = true;
+		} else if (str == "--stream") {
+			streaming = true;
+		} else if (str == "--dump-index") {
+			dump = true;
+		} else if (str == "--pipeline") {
+			pipelined = true;
+		} else if (str == "--pipeline-stats") {
+			pipelined = true;
+			show_stage_stats = true;
+		} else if (str.compare(0, 2, "-j") == 0) {
+			std::string value;
+			if (str.size() > 2) {
+				value = str.substr(2);
+			} else if (i + 1 < argc) {
+				value = argv[++i];
+			}
+			if (!parse_job_count(value, jobs)) {
+				std::cerr << "Expected a number of jobs after -j" << std::endl;
+				return ERR_BAD_ARGUMENTS;
+			}
+		} else {
+			args.push_back(str);
+		}
 	}
 
-	std::map<std::string, std::vector<ast::ast_node * > * > ast_by_filename;
-	indexer::index* dictionary = new indexer::index;
-
-	for (std::string file : args) {
-		std::ifstream in;
-		in.open(file);
-		if (!in.good()) {
-			std::cerr << "Failed to open file " << file << std::endl;
+	// nothing may be recorded for a trace while the batch arena is active,
+	// and batch mode doesn't measure or dump anything
+	if (batch_mode) {
+		if (!trace_file.empty() || time_passes || mem_stats
+				|| !stats_json.empty() || dump) {
+			std::cerr << "--batch can't be used with --trace, --time-passes, "
+					"--mem-stats, --stats-json or --dump-index" << std::endl;
+			return ERR_BAD_ARGUMENTS;
+		}
+		return batch::run_batch(batch_framing);
+	}
+	if (!trace_file.empty()) {
+		if (!tracing::start_tracing(trace_file)) {
+			std::cerr << "Failed to open file " << trace_file << std::endl;
 			return ERR_FOPEN_FAILED;
 		}
-		std::string text = tokenizer::read_input_stream(in);
-		in.close();
-
-		std::vector<tokenizer::token> tokens;
-		std::vector<int> line_numbers;
-		try {
-			tokenizer::tokenize(text, tokens, line_numbers);
-
-			std::vector<ast::ast_node*>* nodes = parser::parse(tokens);
-			ast_by_filename[file] = nodes;
-
-			indexer::index_ast_tree(nodes, dictionary);
-		} catch (tokenizer::tokenizer_exception& e) {
-			std::cerr << "COMPILATION FAILED WHILE TOKENIZING!" << std::endl;
-			std::cerr
-					<< "This means the compiler failed to split the file up into tokens (words)."
-					<< std::endl;
-			std::cerr
-					<< "This is normally caused by an unclosed string/comment."
-					<< std::endl;
-			std::cerr << "File: " << file << std::endl;
-			std::cerr << "Message: " << e.what() << std::endl;
-			print_random_witty_comment();
-			return ERR_TOKENIZE_FAILED;
-		} catch (parser::parser_exception& e) {
-			std::cerr << "COMPILATION FAILED WHILE PARSING!" << std::endl;
-			std::cerr
-					<< "This means the compiler was unable to deduce the structure of the code."
-					<< std::endl;
-			std::cerr << "This is normally caused by a syntax error."
-					<< std::endl;
-			std::cerr << "File: " << file << std::endl;
-			std::cerr << "Message: " << e.what() << std::endl;
-			std::cerr << "Line number: "
-					<< get_line_number(line_numbers, e.get_pos()) << std::endl;
-			print_random_witty_comment();
-			return ERR_TOKENIZE_FAILED;
-		} catch (indexer::indexer_exception& e) {
-			std::cerr << "COMPILATION FAILED WHILE INDEXING!" << std::endl;
-			std::cerr
-					<< "This occurs when the compiler is trying to build an index (dictionary) of fields, functions, etc."
-					<< std::endl;
-			std::cerr << "File: " << file << std::endl;
-			std::cerr << "Message: " << e.what() << std::endl;
-			print_random_witty_comment();
-			return ERR_INDEX_FAILED;
+		tracing::set_file_names(args);
+	}
+
+	if (!daemon_socket.empty()) {
+		return compiler_daemon::run_daemon(daemon_socket, jobs);
+	}
+	if (!stop_socket.empty()) {
+		return compiler_daemon::stop_daemon(stop_socket);
+	}
+	if (!client_socket.empty()) {
+		return compiler_daemon::run_client(client_socket, args);
+	}
+	if (watch) {
+		return file_watch::watch_files(args, jobs);
+	}
+	indexer::index* dictionary = new indexer::index;
+	if (streaming) {
+		int exit_code = stream_files(args, dictionary);
+		if (exit_code == SUCCESS && dump) {
+			dump_index(dictionary);
 		}
+		return exit_code;
 	}
 
-	return SUCCESS;
-}
+	if (mem_stats || !stats_json.empty()) {
+		instrumentation::start_counting_allocations();
+	}
+	concurrency::thread_pool pool(jobs);
+	bool measuring = time_passes || mem_stats || !stats_json.empty();
+	std::vector<frontend::loaded_file> loaded(args.size());
+	for (frontend::loaded_file& result : loaded) {
+		result.measure = measuring;
+	}
+	if (pipelined) {
+		frontend::load_files_pipelined(args, loaded, cache, show_stage_stats);
+	} else {
+		frontend::load_files_in_parallel(args, loaded, cache, &pool);
+	}
+
+	std::vector<instrumentation::phase_sample> all_file_phases;
+	int exit_code = build_files(args, loaded, dictionary, cache, &pool,
+			measuring ? &all_file_phases : nullptr);
+	if (exit_code == SUCCESS && dump) {
+		dump_index(dictionary);
+	}
 
+	if (measuring) {
+		instrumentation::phase_report report;
+		for (int i = 0, e = args.size(); i < e; i++) {
+			report.add_file(args[i], loaded[i].phases);
+		}
+		// indexing runs on the pool, so only its wall clock time means anything
+		for (instrumentation::phase_sample& sample : all_file_phases) {
+			sample.has_cpu_and_memory = false;
+		}
+		report.add_file("(all files)", all_file_phases);
+		if (time_passes) {
+			report.print_times(std::cerr);
+		}
+		if (mem_stats) {
+			report.print_memory(std::cerr);
+		}
+		if (!stats_json.empty()) {
+			std::ofstream out(stats_json);
+			// with neither of the other options, everything is written
+			report.write_json(out, time_passes || !mem_stats,
+					mem_stats || !time_passes);
+		}
+	}
+	return exit_code;
+}
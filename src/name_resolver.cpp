@@ -0,0 +1,269 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include "name_resolver.hpp"
+#include "qualified_index.hpp"
+
+name_resolver::resolution* name_resolver::resolution_table::get_resolution(
+		ast::expression* expr) {
+	std::unordered_map<ast::expression*, name_resolver::resolution>::iterator it =
+			resolutions.find(expr);
+	return it == resolutions.end() ? nullptr : &it->second;
+}
+std::vector<ast::expression*>* name_resolver::resolution_table::get_unresolved() {
+	return &unresolved;
+}
+
+// the locals declared in one block, or the parameters of a function
+struct local_scope {
+	std::unordered_map<std::string, ast::variable_declaration_statement*> variables;
+	std::unordered_map<std::string, ast::field_node*> parameters;
+};
+
+// what a name was found to be, and the names which were tried on the way
+struct cached_lookup {
+	indexer::qualified_entry* entry;
+	std::vector<std::string> tried;
+};
+
+typedef std::unordered_map<std::string, cached_lookup> lookup_cache;
+
+class name_resolution_pass: public passes::pass {
+	indexer::index* dictionary;
+	name_resolver::resolution_table* table;
+	indexer::qualified_index* names = nullptr;
+	std::vector<std::string> module_paths;
+	std::vector<local_scope> local_scopes;
+	// looking names up in the dictionary is remembered per module, since the
+	// same names tend to be used over and over again
+	std::unordered_map<std::string, lookup_cache> caches;
+	lookup_cache* cache = nullptr;
+public:
+	name_resolution_pass(indexer::index* dictionary,
+			name_resolver::resolution_table* table) :
+			dictionary(dictionary), table(table) {
+	}
+	std::string get_name() {
+		return "name resolution";
+	}
+	passes::traversal_order get_traversal_order() {
+		return passes::traversal_order::PRE_AND_POST_ORDER;
+	}
+	void begin_tree(std::vector<ast::ast_node*>* nodes) {
+		// the dictionary keeps the map up to date, but it may have changed
+		// since the last tree, so the entries which were found can't be kept
+		names = dictionary->get_qualified_index();
+		caches.clear();
+		module_paths.assign(1, "");
+		cache = &caches[""];
+		local_scopes.clear();
+	}
+	void enter_ast_node(ast::ast_node*& node) {
+		switch (node->get_ast_node_kind()) {
+		case ast::ast_node_kind::MODULE: {
+			std::string ns = static_cast<ast::module_node*>(node)->get_namespace();
+			module_paths.push_back(
+					ns.empty() ?
+							module_paths.back() :
+							indexer::qualify(module_paths.back(), ns));
+			cache = &caches[module_paths.back()];
+			break;
+		}
+		case ast::ast_node_kind::FUNCTION: {
+			local_scopes.push_back(local_scope());
+			for (ast::field_node* param : *static_cast<ast::function_node*>(node)->get_parameters()) {
+				local_scopes.back().parameters[param->get_name()] = param;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	void leave_ast_node(ast::ast_node*& node) {
+		switch (node->get_ast_node_kind()) {
+		case ast::ast_node_kind::MODULE:
+			module_paths.pop_back();
+			cache = &caches[module_paths.back()];
+			break;
+		case ast::ast_node_kind::FUNCTION:
+			local_scopes.pop_back();
+			break;
+		default:
+			break;
+		}
+	}
+	void enter_statement(ast::statement*& stmt) {
+		switch (stmt->get_statement_kind()) {
+		case ast::statement_kind::BLOCK:
+			local_scopes.push_back(local_scope());
+			break;
+		case ast::statement_kind::FOR: {
+			local_scopes.push_back(local_scope());
+			// the condition is walked before the initializer, so a variable
+			// declared in the initializer has to be added now
+			ast::statement* initializer =
+					static_cast<ast::for_statement*>(stmt)->get_initializer();
+			if (initializer != nullptr
+					&& initializer->is_of_statement_kind(
+							ast::statement_kind::VARIABLE_DECLARATION)) {
+				declare(
+						static_cast<ast::variable_declaration_statement*>(initializer));
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	void leave_statement(ast::statement*& stmt) {
+		switch (stmt->get_statement_kind()) {
+		case ast::statement_kind::BLOCK:
+		case ast::statement_kind::FOR:
+			local_scopes.pop_back();
+			break;
+		case ast::statement_kind::VARIABLE_DECLARATION:
+			// declared after its initializer, so the initializer can't refer
+			// to it
+			if (!local_scopes.empty()) {
+				declare(static_cast<ast::variable_declaration_statement*>(stmt));
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	void enter_expression(ast::expression*& expr) {
+		if (table->resolutions.find(expr) != table->resolutions.end()) {
+			// a part of a namespace expression which has already been done
+			return;
+		}
+		std::string name;
+		if (!indexer::get_referenced_name(expr, name)) {
+			return;
+		}
+		name_resolver::resolution res;
+		ast::expression* target = get_target(expr);
+		if (target->is_of_expression_kind(ast::expression_kind::CALL)) {
+			resolve_call(name, static_cast<ast::call_expression*>(target), res);
+		} else {
+			resolve_variable(name, expr == target, res);
+		}
+		if (res.kind == name_resolver::resolution_kind::UNRESOLVED) {
+			table->unresolved.push_back(expr);
+		}
+		// give every part of a namespace expression the same resolution
+		while (true) {
+			table->resolutions[expr] = res;
+			if (!expr->is_of_expression_kind(ast::expression_kind::NAMESPACE)) {
+				break;
+			}
+			expr = static_cast<ast::namespace_expression*>(expr)->get_operand();
+		}
+	}
+	void leave_expression(ast::expression*& expr) {
+	}
+private:
+	void declare(ast::variable_declaration_statement* var) {
+		local_scopes.back().variables[var->get_name()] = var;
+	}
+	// the identifier or call at the end of a namespace expression
+	ast::expression* get_target(ast::expression* expr) {
+		while (expr->is_of_expression_kind(ast::expression_kind::NAMESPACE)) {
+			expr = static_cast<ast::namespace_expression*>(expr)->get_operand();
+		}
+		return expr;
+	}
+	// the names which are tried are added to the resolution
+	indexer::qualified_entry* lookup(const std::string& name,
+			name_resolver::resolution& res) {
+		lookup_cache::iterator it = cache->find(name);
+		if (it == cache->end()) {
+			cached_lookup& found = (*cache)[name];
+			found.entry = names->resolve(module_paths.back(), name,
+					&found.tried);
+			res.looked_up = found.tried;
+			return found.entry;
+		}
+		res.looked_up = it->second.tried;
+		return it->second.entry;
+	}
+	void resolve_variable(const std::string& name, bool unqualified,
+			name_resolver::resolution& res) {
+		if (unqualified) {
+			// locals hide everything else, innermost first
+			for (int i = local_scopes.size() - 1; i >= 0; i--) {
+				std::unordered_map<std::string,
+						ast::variable_declaration_statement*>::iterator var =
+						local_scopes[i].variables.find(name);
+				if (var != local_scopes[i].variables.end()) {
+					res.kind = name_resolver::resolution_kind::LOCAL_VARIABLE;
+					res.local_variable = var->second;
+					return;
+				}
+				std::unordered_map<std::string, ast::field_node*>::iterator param =
+						local_scopes[i].parameters.find(name);
+				if (param != local_scopes[i].parameters.end()) {
+					res.kind = name_resolver::resolution_kind::PARAMETER;
+					res.parameter = param->second;
+					return;
+				}
+			}
+		}
+		indexer::qualified_entry* entry = lookup(name, res);
+		if (entry == nullptr) {
+			res.diagnostic = "Unknown variable " + name;
+		} else if (entry->fields.empty()) {
+			res.diagnostic = name + " is not a variable";
+		} else if (entry->fields.size() > 1) {
+			// fields with the same name in different unnamed modules
+			res.diagnostic = "Ambiguous variable " + name;
+		} else {
+			res.kind = name_resolver::resolution_kind::FIELD;
+			res.qualified_name = entry->name;
+			res.field = entry->fields[0];
+		}
+	}
+	void resolve_call(const std::string& name, ast::call_expression* call,
+			name_resolver::resolution& res) {
+		indexer::qualified_entry* entry = lookup(name, res);
+		if (entry == nullptr) {
+			res.diagnostic = "Unknown function " + name;
+			return;
+		}
+		if (entry->overloads.empty()) {
+			res.diagnostic = name + " is not a function";
+			return;
+		}
+		std::vector<indexer::function_index*>::size_type arg_count =
+				call->get_operands()->size();
+		for (indexer::function_index* function : entry->overloads) {
+			if (function->get_parameter_types()->size() == arg_count) {
+				res.overloads.push_back(function);
+			}
+		}
+		res.qualified_name = entry->name;
+		if (res.overloads.empty()) {
+			res.diagnostic = "No overload of " + name + " takes "
+					+ std::to_string(arg_count) + " arguments";
+		} else if (res.overloads.size() == 1) {
+			res.kind = name_resolver::resolution_kind::FUNCTION;
+			res.function = res.overloads[0];
+			res.overloads.clear();
+		} else {
+			res.kind = name_resolver::resolution_kind::OVERLOADS;
+		}
+	}
+};
+
+void name_resolver::add_name_resolution_pass(passes::pass_manager* manager,
+		indexer::index* dictionary, name_resolver::resolution_table* table) {
+	manager->add_pass(new name_resolution_pass(dictionary, table));
+}
+void name_resolver::resolve_names(std::vector<ast::ast_node*>* tree,
+		indexer::index* dictionary, name_resolver::resolution_table* table) {
+	passes::pass_manager manager;
+	add_name_resolution_pass(&manager, dictionary, table);
+	manager.run(tree);
+}
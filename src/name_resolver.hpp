@@ -0,0 +1,70 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef NAME_RESOLVER_HPP_
+#define NAME_RESOLVER_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "indexer.hpp"
+#include "pass_manager.hpp"
+
+class name_resolution_pass;
+
+namespace name_resolver {
+
+enum class resolution_kind {
+	UNRESOLVED, LOCAL_VARIABLE, PARAMETER, FIELD, FUNCTION, OVERLOADS
+};
+
+// What a reference refers to. Only the member for the kind is set. A call
+// is resolved to a single function if only one overload takes that many
+// arguments, and otherwise to the overloads which do, until there's a type
+// checker to pick between them
+struct resolution {
+	resolution_kind kind = resolution_kind::UNRESOLVED;
+	// the fully qualified name of a field or function
+	std::string qualified_name;
+	ast::variable_declaration_statement* local_variable = nullptr;
+	ast::field_node* parameter = nullptr;
+	indexer::field_index* field = nullptr;
+	indexer::function_index* function = nullptr;
+	std::vector<indexer::function_index*> overloads;
+	// the fully qualified names which were looked up in the dictionary,
+	// innermost module first, whether or not it was resolved. Something
+	// being declared with any of these names could change the resolution
+	std::vector<std::string> looked_up;
+	// why it couldn't be resolved
+	std::string diagnostic;
+};
+
+// The resolutions of the identifier, call and namespace expressions in a
+// tree. Every part of a namespace expression, down to the identifier or
+// call at the end, has the resolution of the whole thing.
+class resolution_table {
+	friend class ::name_resolution_pass;
+	std::unordered_map<ast::expression*, resolution> resolutions;
+	std::vector<ast::expression*> unresolved;
+public:
+	// returns nullptr if the expression isn't a reference
+	resolution* get_resolution(ast::expression* expr);
+	// the references which couldn't be resolved, in the order they appear
+	std::vector<ast::expression*>* get_unresolved();
+};
+
+// Resolves every reference in the tree against locals, parameters and the
+// dictionary. A field whose qualified name is shared with a field in another
+// unnamed module is ambiguous, and left unresolved. The table refers to
+// expressions by address, so any pass which replaces expressions has to be
+// run before this one, in an earlier walk
+void resolve_names(std::vector<ast::ast_node*>* tree,
+		indexer::index* dictionary, resolution_table* table);
+void add_name_resolution_pass(passes::pass_manager* manager,
+		indexer::index* dictionary, resolution_table* table);
+
+}
+
+#endif /* NAME_RESOLVER_HPP_ */
@@ -0,0 +1,32 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include "parallel_walker.hpp"
+
+void collect_units(std::vector<ast::ast_node*>* nodes,
+		std::vector<ast::ast_node*>* units) {
+	for (ast::ast_node* node : *nodes) {
+		switch (node->get_ast_node_kind()) {
+		case ast::ast_node_kind::MODULE:
+			collect_units(static_cast<ast::module_node*>(node)->get_children(),
+					units);
+			break;
+		case ast::ast_node_kind::FIELD:
+			if (static_cast<ast::field_node*>(node)->has_initialization_expression()) {
+				units->push_back(node);
+			}
+			break;
+		case ast::ast_node_kind::FUNCTION:
+			units->push_back(node);
+			break;
+		}
+	}
+}
+
+std::vector<ast::ast_node*>* parallel_walker::collect_units(
+		std::vector<ast::ast_node*>* tree) {
+	std::vector<ast::ast_node*>* units = new std::vector<ast::ast_node*>;
+	::collect_units(tree, units);
+	return units;
+}
@@ -0,0 +1,85 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef PARALLEL_WALKER_HPP_
+#define PARALLEL_WALKER_HPP_
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "thread_pool.hpp"
+
+namespace parallel_walker {
+
+// A visitor which is run over one unit at a time, where a unit is a function
+// or a field with an initializer. Functions and fields don't depend on each
+// other once they've been indexed, so units can be visited in parallel.
+// Each worker thread gets its own visitor, which may be given any number of
+// units one after the other. Whatever a visitor wants to report about a unit
+// is returned from end_unit(), so the results don't depend on which thread
+// visited which unit.
+template<typename R>
+class unit_visitor: public ast::ast_visitor {
+public:
+	virtual void begin_unit(ast::ast_node* unit) {
+	}
+	virtual R end_unit(ast::ast_node* unit) = 0;
+};
+
+// finds every function and every field with an initializer, including those
+// inside modules, in the order they appear in the tree
+std::vector<ast::ast_node*>* collect_units(std::vector<ast::ast_node*>* tree);
+
+// visits every unit with visitors created by the factory, one per worker,
+// and returns the result for each unit in the same order as collect_units()
+template<typename R>
+std::vector<R>* visit_units(std::vector<ast::ast_node*>* tree,
+		std::function<unit_visitor<R>*()> visitor_factory,
+		concurrency::thread_pool* pool) {
+	std::vector<ast::ast_node*>* units = collect_units(tree);
+	// each unit's result gets its own slot, rather than a vector element, so
+	// that workers never write to memory shared with another slot, as they
+	// would in a std::vector<bool>
+	std::unique_ptr<R[]> slots(new R[units->size()]);
+	std::vector<unit_visitor<R>*> visitors;
+	for (int i = 0, e = pool->get_thread_count(); i < e; i++) {
+		visitors.push_back(visitor_factory());
+	}
+	std::vector<std::function<void(int)>> tasks;
+	for (int i = 0, e = units->size(); i < e; i++) {
+		R* slot = &slots[i];
+		tasks.push_back([i, units, slot, &visitors](int worker) {
+			ast::ast_node* unit = (*units)[i];
+			unit_visitor<R>* visitor = visitors[worker];
+			visitor->begin_unit(unit);
+			visitor->visit_ast_node(unit);
+			*slot = visitor->end_unit(unit);
+		});
+	}
+	try {
+		pool->run_all(&tasks);
+	} catch (...) {
+		for (unit_visitor<R>* visitor : visitors) {
+			delete visitor;
+		}
+		delete units;
+		throw;
+	}
+	for (unit_visitor<R>* visitor : visitors) {
+		delete visitor;
+	}
+	std::vector<R>* results = new std::vector<R>;
+	results->reserve(units->size());
+	for (int i = 0, e = units->size(); i < e; i++) {
+		results->push_back(std::move(slots[i]));
+	}
+	delete units;
+	return results;
+}
+
+}
+
+#endif /* PARALLEL_WALKER_HPP_ */
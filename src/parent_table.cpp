@@ -0,0 +1,132 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include "parent_table.hpp"
+
+const std::uintptr_t TAG_MASK = 3;
+const std::uintptr_t AST_NODE_TAG = 1;
+const std::uintptr_t STATEMENT_TAG = 2;
+const std::uintptr_t EXPRESSION_TAG = 3;
+
+ast::parent_ref::parent_ref() :
+		tagged(0) {
+}
+ast::parent_ref::parent_ref(ast::ast_node* node) :
+		tagged(reinterpret_cast<std::uintptr_t>(node) | AST_NODE_TAG) {
+}
+ast::parent_ref::parent_ref(ast::statement* stmt) :
+		tagged(reinterpret_cast<std::uintptr_t>(stmt) | STATEMENT_TAG) {
+}
+ast::parent_ref::parent_ref(ast::expression* expr) :
+		tagged(reinterpret_cast<std::uintptr_t>(expr) | EXPRESSION_TAG) {
+}
+bool ast::parent_ref::has_parent() {
+	return tagged != 0;
+}
+bool ast::parent_ref::is_ast_node() {
+	return (tagged & TAG_MASK) == AST_NODE_TAG;
+}
+bool ast::parent_ref::is_statement() {
+	return (tagged & TAG_MASK) == STATEMENT_TAG;
+}
+bool ast::parent_ref::is_expression() {
+	return (tagged & TAG_MASK) == EXPRESSION_TAG;
+}
+ast::ast_node* ast::parent_ref::get_ast_node() {
+	return is_ast_node() ?
+			reinterpret_cast<ast::ast_node*>(tagged & ~TAG_MASK) : nullptr;
+}
+ast::statement* ast::parent_ref::get_statement() {
+	return is_statement() ?
+			reinterpret_cast<ast::statement*>(tagged & ~TAG_MASK) : nullptr;
+}
+ast::expression* ast::parent_ref::get_expression() {
+	return is_expression() ?
+			reinterpret_cast<ast::expression*>(tagged & ~TAG_MASK) : nullptr;
+}
+
+ast::parent_table::parent_table(std::vector<ast::ast_node*>* tree) {
+	for (ast::ast_node* node : *tree) {
+		add_ast_node(node, ast::parent_ref());
+	}
+}
+ast::parent_ref ast::parent_table::get_parent(ast::ast_node* node) {
+	return find(node);
+}
+ast::parent_ref ast::parent_table::get_parent(ast::statement* stmt) {
+	return find(stmt);
+}
+ast::parent_ref ast::parent_table::get_parent(ast::expression* expr) {
+	return find(expr);
+}
+void ast::parent_table::set_parent(ast::ast_node* node,
+		ast::parent_ref parent) {
+	parents[node] = parent;
+}
+void ast::parent_table::set_parent(ast::statement* stmt,
+		ast::parent_ref parent) {
+	parents[stmt] = parent;
+}
+void ast::parent_table::set_parent(ast::expression* expr,
+		ast::parent_ref parent) {
+	parents[expr] = parent;
+}
+void ast::parent_table::add_ast_node(ast::ast_node* node,
+		ast::parent_ref parent) {
+	if (parent.has_parent()) {
+		parents[node] = parent;
+	}
+	std::vector<ast::expression**>* child_expressions =
+			node->get_child_expressions();
+	for (ast::expression** child : *child_expressions) {
+		add_expression(*child, node);
+	}
+	delete child_expressions;
+	std::vector<ast::statement**>* child_statements =
+			node->get_child_statements();
+	for (ast::statement** child : *child_statements) {
+		add_statement(*child, node);
+	}
+	delete child_statements;
+	std::vector<ast::ast_node**>* child_nodes = node->get_child_nodes();
+	for (ast::ast_node** child : *child_nodes) {
+		add_ast_node(*child, node);
+	}
+	delete child_nodes;
+}
+void ast::parent_table::add_statement(ast::statement* stmt,
+		ast::parent_ref parent) {
+	parents[stmt] = parent;
+	std::vector<ast::expression**>* child_expressions =
+			stmt->get_child_expressions();
+	for (ast::expression** child : *child_expressions) {
+		if (*child != nullptr) {
+			add_expression(*child, stmt);
+		}
+	}
+	delete child_expressions;
+	std::vector<ast::statement**>* child_statements =
+			stmt->get_child_statements();
+	for (ast::statement** child : *child_statements) {
+		add_statement(*child, stmt);
+	}
+	delete child_statements;
+}
+void ast::parent_table::add_expression(ast::expression* expr,
+		ast::parent_ref parent) {
+	parents[expr] = parent;
+	std::vector<ast::expression**>* children = expr->get_children();
+	for (ast::expression** child : *children) {
+		add_expression(*child, expr);
+	}
+	delete children;
+}
+ast::parent_ref ast::parent_table::find(const void* node) {
+	std::unordered_map<const void*, ast::parent_ref>::iterator it =
+			parents.find(node);
+	if (it == parents.end()) {
+		return ast::parent_ref();
+	}
+	return it->second;
+}
@@ -0,0 +1,57 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef PARENT_TABLE_HPP_
+#define PARENT_TABLE_HPP_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "crosslang_ast.hpp"
+
+namespace ast {
+
+// The parent of a node, which may be an ast_node, a statement or an
+// expression. Which one it is is kept in the low bits of the pointer, which
+// are always free because nodes are allocated with new.
+class parent_ref {
+	std::uintptr_t tagged;
+public:
+	parent_ref();
+	parent_ref(ast_node* node);
+	parent_ref(statement* stmt);
+	parent_ref(expression* expr);
+	bool has_parent();
+	bool is_ast_node();
+	bool is_statement();
+	bool is_expression();
+	ast_node* get_ast_node();
+	statement* get_statement();
+	expression* get_expression();
+};
+
+// Nodes don't store their parents themselves, as most passes don't need
+// them. Instead, a parent table is built from the tree when they're needed.
+// It reflects the tree as it was when it was built, so anything which moves
+// nodes around afterwards has to call set_parent() to keep it up to date.
+class parent_table {
+	std::unordered_map<const void*, parent_ref> parents;
+public:
+	parent_table(std::vector<ast_node*>* tree);
+	parent_ref get_parent(ast_node* node);
+	parent_ref get_parent(statement* stmt);
+	parent_ref get_parent(expression* expr);
+	void set_parent(ast_node* node, parent_ref parent);
+	void set_parent(statement* stmt, parent_ref parent);
+	void set_parent(expression* expr, parent_ref parent);
+private:
+	void add_ast_node(ast_node* node, parent_ref parent);
+	void add_statement(statement* stmt, parent_ref parent);
+	void add_expression(expression* expr, parent_ref parent);
+	parent_ref find(const void* node);
+};
+
+}
+
+#endif /* PARENT_TABLE_HPP_ */
@@ -5,115 +5,101 @@
 #include <iostream>
 #include <cstdlib>
 #include <vector>
-#include <map>
 #include <set>
+#include <iterator>
+#include <utility>
 #include "crosslang_ast.hpp"
+#include "lookup_table.hpp"
 #include "tokenizer.hpp"
 #include "parser.hpp"
+#include "pass_manager.hpp"
 
-parser::parser_exception::parser_exception(const char* desc, int pos) :
-		pos(pos), desc(desc) {
-}
-parser::parser_exception::~parser_exception() {
-	delete desc;
-}
-const char* parser::parser_exception::what() {
-	return desc;
-}
-int parser::parser_exception::get_pos() {
-	return pos;
-}
-
-std::map<std::string, ast::modifier> create_modifiers() {
-	std::map<std::string, ast::modifier> modifiers;
-	modifiers["global"] = ast::modifier::GLOBAL;
-	return modifiers;
-}
-std::map<std::string, ast::modifier> modifiers = create_modifiers();
-std::set<std::string> create_left_unary_operators() {
-	std::set<std::string> operators;
-	operators.insert("!");
-	operators.insert("~");
-	operators.insert("+");
-	operators.insert("-");
-	operators.insert("++");
-	operators.insert("--");
-	return operators;
-}
-std::set<std::string> left_unary_operators = create_left_unary_operators();
-std::set<std::string> create_right_unary_operators() {
-	std::set<std::string> operators;
-	operators.insert("++");
-	operators.insert("--");
-	return operators;
-}
-std::set<std::string> right_unary_operators = create_right_unary_operators();
-std::set<std::string> create_operators() {
-	std::set<std::string> operators;
-	operators.insert("+");
-	operators.insert("-");
-	operators.insert("*");
-	operators.insert("/");
-	operators.insert("%");
-	operators.insert("&");
-	operators.insert("|");
-	operators.insert("^");
-	operators.insert(">>");
-	operators.insert("<<");
-	operators.insert("&&");
-	operators.insert("||");
-	operators.insert("^^");
-	operators.insert("==");
-	operators.insert("!=");
-	operators.insert("<");
-	operators.insert("<=");
-	operators.insert(">");
-	operators.insert(">=");
-	return operators;
-}
-std::set<std::string> operators = create_operators();
-std::set<std::string> create_assignment_operators() {
-	std::set<std::string> operators;
-	operators.insert("=");
-	operators.insert("+=");
-	operators.insert("-=");
-	operators.insert("*=");
-	operators.insert("/=");
-	operators.insert("%=");
-	operators.insert("&=");
-	operators.insert("|=");
-	operators.insert("^=");
-	operators.insert(">>=");
-	operators.insert("<<=");
-	return operators;
-}
-std::set<std::string> assignment_operators = create_assignment_operators();
+// these tables are sorted, so that they can be binary searched
+struct modifier_entry {
+	const char* name;
+	ast::modifier modifier;
+};
+constexpr modifier_entry modifiers[] = { { "global", ast::modifier::GLOBAL } };
+static_assert(lookup::is_sorted(modifiers), "modifiers must be sorted");
+constexpr const char* left_unary_operators[] = { "!", "+", "++", "-", "--",
+		"~" };
+static_assert(lookup::is_sorted(left_unary_operators),
+		"left_unary_operators must be sorted");
+constexpr const char* right_unary_operators[] = { "++", "--" };
+static_assert(lookup::is_sorted(right_unary_operators),
+		"right_unary_operators must be sorted");
+constexpr const char* operators[] = { "!=", "%", "&", "&&", "*", "+", "-", "/",
+		"<", "<<", "<=", "==", ">", ">=", ">>", "^", "^^", "|", "||" };
+static_assert(lookup::is_sorted(operators), "operators must be sorted");
+constexpr const char* assignment_operators[] = { "%=", "&=", "*=", "+=", "-=",
+		"/=", "<<=", "=", ">>=", "^=", "|=" };
+static_assert(lookup::is_sorted(assignment_operators),
+		"assignment_operators must be sorted");
 
+// Every consume function returns as soon as anything fails to parse, leaving
+// the failure for its caller to see. Where there's more than one way to read
+// the tokens, the failure is thrown away and the next way is tried. Failures
+// which can't be backtracked past are reported to the diagnostics, and
+// parsing carries on from the next declaration.
 class parser_cls {
 	std::vector<tokenizer::token>* tokens;
 	std::vector<tokenizer::token>::size_type next_index = 0;
 	std::vector<std::vector<tokenizer::token>::size_type> saved_next_indices;
+	diagnostics::diagnostic_buffer* diags;
+	bool failed = false;
+	const char* failure_message = nullptr;
+	std::int64_t failure_pos = diagnostics::NO_POS;
+	bool reported = false;
+	// the braces which were open where parsing carried on after an error,
+	// innermost last. True for the brace of a module. They're kept by the
+	// caller, so that parsing can carry on from one list of tokens to the next
+	std::vector<bool>& open_braces;
 public:
-	parser_cls(std::vector<tokenizer::token>* tokens) :
-			tokens(tokens) {
-	}
-	~parser_cls() {
-		delete tokens;
+	parser_cls(std::vector<tokenizer::token>* tokens,
+			diagnostics::diagnostic_buffer* diags,
+			std::vector<bool>& open_braces) :
+			tokens(tokens), diags(diags), open_braces(open_braces) {
 	}
 	std::vector<ast::ast_node*>* consume_root() {
-		std::vector<ast::ast_node*>* ret = consume_ast_node_list();
-		consume_eof();
-		return ret;
+		std::vector<ast::ast_node*>* nodes = new std::vector<ast::ast_node*>;
+		while (true) {
+			std::vector<tokenizer::token>::size_type resumed_at = next_index;
+			consume_ast_node_list(nodes);
+			if (!failed && !open_braces.empty() && open_braces.back()
+					&& is_close_brace(next_token())) {
+				// the end of a module which had an error in it
+				consume_token();
+				open_braces.pop_back();
+				continue;
+			}
+			if (!failed) {
+				consume_eof();
+			}
+			if (!failed) {
+				return nodes;
+			}
+			report_failure();
+			skip_to_next_ast_node(resumed_at);
+		}
+	}
+	bool has_reported() {
+		return reported;
+	}
+	static bool starts_ast_node(tokenizer::token* t) {
+		return is_ast_node_token(t);
 	}
 private:
-	std::vector<ast::ast_node*>* consume_ast_node_list() {
-		std::vector<ast::ast_node*>* nodes = new std::vector<ast::ast_node*>;
+	// adds the nodes to the list until there are no more
+	void consume_ast_node_list(std::vector<ast::ast_node*>* nodes) {
 		tokenizer::token* t = next_token();
 		while (is_ast_node_token(t)) {
-			nodes->push_back(consume_ast_node());
+			ast::ast_node* node = consume_ast_node();
+			if (failed) {
+				return;
+			}
+			nodes->push_back(node);
 			t = next_token();
 		}
-		return nodes;
 	}
 	ast::ast_node* consume_ast_node() {
 		tokenizer::token* t = next_token();
@@ -124,7 +110,8 @@ private:
 		} else if (is_function_token(t)) {
 			return consume_function_node();
 		} else {
-			throw parser::parser_exception("Unexpected token", token_pos(t));
+			fail("Unexpected token", token_pos(t));
+			return nullptr;
 		}
 	}
 	ast::module_node* consume_module_node() {
@@ -138,20 +125,36 @@ private:
 			namespace_name = "";
 		}
 		consume_token(is_open_brace);
-		std::vector<ast::ast_node*>* children = consume_ast_node_list();
+		if (failed) {
+			return nullptr;
+		}
+		std::vector<ast::ast_node*>* children = new std::vector<ast::ast_node*>;
+		consume_ast_node_list(children);
+		if (failed) {
+			return nullptr;
+		}
 		consume_token(is_close_brace);
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::module_node(namespace_name, children);
 	}
 	ast::field_node* consume_field_node() {
 		consume_token(is_field_token);
 		std::set<ast::modifier>* modifiers = consume_modifier_list();
 		ast::type_ref type = consume_type_ref();
-		std::string name = consume_token(is_identifier)->text;
+		std::string name = consume_text(is_identifier);
+		if (failed) {
+			return nullptr;
+		}
 		ast::expression* initialization_expression = nullptr;
 		tokenizer::token* t = next_token();
 		if (is_equals(t)) {
 			consume_token(is_equals);
 			initialization_expression = consume_expression();
+			if (failed) {
+				return nullptr;
+			}
 		}
 		consume_end_statement();
 		return new ast::field_node(modifiers, type, name,
@@ -161,8 +164,11 @@ private:
 		consume_token(is_function_token);
 		std::set<ast::modifier>* modifiers = consume_modifier_list();
 		ast::type_ref type = consume_type_ref();
-		std::string name = consume_token(is_identifier)->text;
+		std::string name = consume_text(is_identifier);
 		consume_token(is_open_parenthesis);
+		if (failed) {
+			return nullptr;
+		}
 		std::vector<ast::field_node*>* parameters = new std::vector<
 				ast::field_node*>;
 		tokenizer::token* t = next_token();
@@ -172,12 +178,18 @@ private:
 			}
 			std::set<ast::modifier>* modifiers = consume_modifier_list();
 			ast::type_ref type = consume_type_ref();
-			std::string name = consume_token(is_identifier)->text;
+			std::string name = consume_text(is_identifier);
+			if (failed) {
+				return nullptr;
+			}
 			ast::expression* initialization_expression = nullptr;
 			t = next_token();
 			if (is_equals(t)) {
 				consume_token(is_equals);
 				initialization_expression = consume_expression();
+				if (failed) {
+					return nullptr;
+				}
 				t = next_token();
 			}
 			parameters->push_back(
@@ -186,28 +198,42 @@ private:
 		}
 		consume_token(is_close_parenthesis);
 		ast::statement* body = consume_statement(false);
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::function_node(modifiers, type, name, parameters, body);
 	}
 	std::set<ast::modifier>* consume_modifier_list() {
 		std::set<ast::modifier>* modifier_list = new std::set<ast::modifier>;
+		if (failed) {
+			return modifier_list;
+		}
 		tokenizer::token* t = next_token();
 		while (is_modifier(t)) {
 			consume_token(is_modifier);
-			modifier_list->insert(modifiers[t->text]);
+			modifier_list->insert(
+					modifiers[lookup::index_of(modifiers, t->text.c_str())].modifier);
 			t = next_token();
 		}
 		return modifier_list;
 	}
+	// what's returned is only complete if nothing failed
 	ast::type_ref consume_type_ref() {
 		std::vector<std::string>* namespaces = new std::vector<std::string>;
-		std::string type_name = consume_token(is_identifier)->text;
 		std::vector<ast::type_ref>* generic_args =
 				new std::vector<ast::type_ref>;
+		std::string type_name = consume_text(is_identifier);
+		if (failed) {
+			return ast::type_ref(namespaces, type_name, generic_args);
+		}
 		tokenizer::token* t = next_token();
 		while (is_namespace_operator(t)) {
 			consume_token(is_namespace_operator);
 			namespaces->push_back(type_name);
-			type_name = consume_token(is_identifier)->text;
+			type_name = consume_text(is_identifier);
+			if (failed) {
+				return ast::type_ref(namespaces, type_name, generic_args);
+			}
 			t = next_token();
 		}
 		if (is_open_angled_bracket(t)) {
@@ -218,6 +244,9 @@ private:
 					consume_token(is_comma);
 				}
 				generic_args->push_back(consume_type_ref());
+				if (failed) {
+					return ast::type_ref(namespaces, type_name, generic_args);
+				}
 				t = next_token();
 			}
 			consume_token(is_close_angled_bracket);
@@ -225,8 +254,15 @@ private:
 		return ast::type_ref(namespaces, type_name, generic_args);
 	}
 	ast::expression* consume_expression() {
+		if (failed) {
+			return nullptr;
+		}
 		tokenizer::token* t = next_token();
-		int initial_pos = t->pos;
+		if (t == nullptr) {
+			fail("Unexpected token - expected expression", token_pos(t));
+			return nullptr;
+		}
+		std::int64_t initial_pos = t->pos;
 		if (is_operator(t)) {
 			if (is_open_parenthesis(t)) {
 				// if the expression starts with ( it is either a cast or
@@ -236,19 +272,22 @@ private:
 				void* enclosed;
 				bool is_enclosed_type_ref;
 				push_saved_state();
-				try {
-					// first try parsing it as a type ref (for a cast). If we're wrong,
-					// we convert later
-					ast::type_ref type = consume_type_ref();
-					consume_token(is_close_parenthesis);
+				// first try parsing it as a type ref (for a cast). If we're wrong,
+				// we convert later
+				ast::type_ref type = consume_type_ref();
+				consume_token(is_close_parenthesis);
+				if (!failed) {
 					enclosed = &type;
 					is_enclosed_type_ref = true;
 					discard_saved_state();
-				} catch (parser::parser_exception& e) {
+				} else {
 					// otherwise consume it as an expression
 					revert_saved_state();
 					enclosed = consume_expression();
 					consume_token(is_close_parenthesis);
+					if (failed) {
+						return nullptr;
+					}
 					is_enclosed_type_ref = false;
 				}
 				t = next_token();
@@ -262,7 +301,11 @@ private:
 						&& t->text != "-") || is_open_parenthesis(t)
 						|| is_identifier(t)) && is_enclosed_type_ref) {
 					ast::type_ref type = *static_cast<ast::type_ref*>(enclosed);
-					return new ast::cast_expression(type, consume_expression());
+					ast::expression* operand = consume_expression();
+					if (failed) {
+						return nullptr;
+					}
+					return new ast::cast_expression(type, operand);
 				} else {
 					// we have a parenthesized expression
 					ast::expression* enclosed_expr;
@@ -272,9 +315,9 @@ private:
 						ast::type_ref type =
 								*static_cast<ast::type_ref*>(enclosed);
 						if (!type.get_generic_args()->empty()) {
-							throw parser::parser_exception(
-									"Unexpected type reference in parenthesized expression",
+							fail("Unexpected type reference in parenthesized expression",
 									initial_pos);
+							return nullptr;
 						}
 						enclosed_expr = new ast::identifier_expression(
 								type.get_type_name());
@@ -297,6 +340,9 @@ private:
 						std::string operator_name = consume_token(
 								is_middle_binary_operator)->text;
 						ast::expression* rhs = consume_expression();
+						if (failed) {
+							return nullptr;
+						}
 						return new ast::operator_expression(expr, operator_name,
 								rhs);
 					} else if (is_right_unary_operator(t)) {
@@ -313,6 +359,9 @@ private:
 				std::string operator_name = consume_token(
 						is_left_unary_operator)->text;
 				ast::expression* operand = consume_expression();
+				if (failed) {
+					return nullptr;
+				}
 				return new ast::unary_operator_left_expression(operator_name,
 						operand);
 			}
@@ -342,7 +391,8 @@ private:
 			}
 
 			if (text.empty()) {
-				throw parser::parser_exception("Invalid number", t->pos);
+				fail("Invalid number", t->pos);
+				return nullptr;
 			}
 			// integers don't contain a decimal point or exponent
 			if (text.find(".") == std::string::npos
@@ -357,34 +407,36 @@ private:
 				case ast::radix::OCTAL:
 					base = 8;
 					break;
-				case ast::radix::DECIMAL:
-					base = 10;
-					break;
 				case ast::radix::HEX:
 					base = 16;
 					break;
+				default:
+					base = 10;
+					break;
 				}
 				// this is a good way to check if the entire string was
 				// converted to an integer
 				char* end_ptr;
 				int value = std::strtol(text.c_str(), &end_ptr, base);
 				if ((*end_ptr) != '\0') {
-					throw parser::parser_exception("Invalid number", t->pos);
+					fail("Invalid number", t->pos);
+					return nullptr;
 				}
 				number_expr = new ast::const_integer_expression(value, rad);
 			} else {
 				// only decimal numbers are allowed for non-integral types
 				if (rad != ast::radix::DECIMAL) {
-					throw parser::parser_exception(
-							"Not allowed non-integer values for non-decimal numbers",
+					fail("Not allowed non-integer values for non-decimal numbers",
 							t->pos);
+					return nullptr;
 				}
 				// this is a good way to check if the entire string was
 				// converted to a double
 				char* end_ptr;
 				double value = std::strtod(text.c_str(), &end_ptr);
 				if ((*end_ptr) != '\0') {
-					throw parser::parser_exception("Invalid number", t->pos);
+					fail("Invalid number", t->pos);
+					return nullptr;
 				}
 				number_expr = new ast::const_double_expression(value);
 			}
@@ -394,6 +446,9 @@ private:
 				std::string operator_name = consume_token(
 						is_middle_binary_operator)->text;
 				ast::expression* rhs = consume_expression();
+				if (failed) {
+					return nullptr;
+				}
 				return new ast::operator_expression(number_expr, operator_name,
 						rhs);
 			}
@@ -403,6 +458,9 @@ private:
 			// operator, which would require a recursive function to
 			// consume the tokens, so ya, here it is
 			ast::expression* expr = consume_expression_identifier_part();
+			if (failed) {
+				return nullptr;
+			}
 			t = next_token();
 			// check for binary operators, which would not be allowed as part
 			// of a namespace expression
@@ -410,6 +468,9 @@ private:
 				std::string operator_name = consume_token(
 						is_middle_binary_operator)->text;
 				ast::expression* rhs = consume_expression();
+				if (failed) {
+					return nullptr;
+				}
 				expr = new ast::operator_expression(expr, operator_name, rhs);
 			}
 			return expr;
@@ -425,12 +486,15 @@ private:
 				std::string operator_name = consume_token(
 						is_middle_binary_operator)->text;
 				ast::expression* rhs = consume_expression();
+				if (failed) {
+					return nullptr;
+				}
 				expr = new ast::operator_expression(expr, operator_name, rhs);
 			}
 			return expr;
 		}
-		throw parser::parser_exception("Unexpected token - expected expression",
-				initial_pos);
+		fail("Unexpected token - expected expression", initial_pos);
+		return nullptr;
 	}
 	ast::expression* consume_expression_identifier_part() {
 		std::string text = consume_token(is_identifier)->text;
@@ -449,6 +513,9 @@ private:
 						consume_token(is_comma);
 					}
 					operands->push_back(consume_expression());
+					if (failed) {
+						return nullptr;
+					}
 					t = next_token();
 				}
 				consume_token(is_close_parenthesis);
@@ -456,7 +523,14 @@ private:
 			} else if (is_namespace_operator(t)) {
 				// if it's a :: then it's a namespace expression
 				consume_token(is_namespace_operator);
+				if (!is_identifier(next_token())) {
+					fail("Unexpected token", token_pos(next_token()));
+					return nullptr;
+				}
 				ast::expression* operand = consume_expression_identifier_part();
+				if (failed) {
+					return nullptr;
+				}
 				expr = new ast::namespace_expression(text, operand);
 			} else {
 				// otherwise it's just a plain identifier expression
@@ -491,6 +565,9 @@ private:
 					consume_token(is_comma);
 				}
 				indices->push_back(consume_expression());
+				if (failed) {
+					return nullptr;
+				}
 				t = next_token();
 			}
 			consume_token(is_close_square_bracket);
@@ -513,11 +590,17 @@ private:
 		tokenizer::token* t = next_token();
 		while (!end_condition(t)) {
 			statements->push_back(consume_statement(true));
+			if (failed) {
+				return nullptr;
+			}
 			t = next_token();
 		}
 		return statements;
 	}
 	ast::statement* consume_statement(bool allow_semicolon) {
+		if (failed) {
+			return nullptr;
+		}
 		tokenizer::token* t = next_token();
 		ast::statement* stmt;
 		if (is_open_brace(t)) {
@@ -538,21 +621,28 @@ private:
 			stmt = consume_return_statement();
 		} else {
 			push_saved_state();
-			try {
-				stmt = consume_variable_declaration_statement();
+			stmt = consume_variable_declaration_statement();
+			if (!failed) {
 				discard_saved_state();
-			} catch (parser::parser_exception& e) {
+			} else {
 				revert_saved_state();
 				push_saved_state();
-				try {
-					stmt = consume_assignment_statement();
+				stmt = consume_assignment_statement();
+				if (!failed) {
 					discard_saved_state();
-				} catch (parser::parser_exception& e) {
+				} else {
 					revert_saved_state();
-					stmt = new ast::expression_statement(consume_expression());
+					ast::expression* expr = consume_expression();
+					if (failed) {
+						return nullptr;
+					}
+					stmt = new ast::expression_statement(expr);
 				}
 			}
 		}
+		if (failed) {
+			return nullptr;
+		}
 		if (allow_semicolon) {
 			consume_end_statement();
 		}
@@ -563,83 +653,105 @@ private:
 		std::vector<ast::statement*>* children = consume_statement_list(
 				is_close_brace);
 		consume_token(is_close_brace);
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::block_statement(children);
 	}
 	ast::variable_declaration_statement* consume_variable_declaration_statement() {
 		std::set<ast::modifier> *modifiers = consume_modifier_list();
 		ast::type_ref type = consume_type_ref();
-		std::string name = consume_token(is_identifier)->text;
+		std::string name = consume_text(is_identifier);
+		if (failed) {
+			return nullptr;
+		}
 		ast::expression* initialization_expression = nullptr;
 		tokenizer::token* t = next_token();
 		if (is_equals(t)) {
 			consume_token(is_equals);
 			initialization_expression = consume_expression();
+			if (failed) {
+				return nullptr;
+			}
 		}
 		return new ast::variable_declaration_statement(modifiers, type, name,
 				initialization_expression);
 	}
 	ast::assignment_statement* consume_assignment_statement() {
 		ast::expression* lhs = consume_expression();
-		std::string operator_name = consume_token(is_assignment_operator)->text;
+		std::string operator_name = consume_text(is_assignment_operator);
 		ast::expression* rhs = consume_expression();
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::assignment_statement(lhs, operator_name, rhs);
 	}
-	ast::if_statement* consume_if_statement() {
-		consume_token(is_if_token);
-		tokenizer::token* t = next_token();
-		bool condition_in_parentheses = is_open_parenthesis(t);
-		if (condition_in_parentheses) {
+	// the condition of an if, while, do-while or repeat, which may or may not
+	// be in parentheses
+	ast::expression* consume_condition() {
+		bool in_parentheses = is_open_parenthesis(next_token());
+		if (in_parentheses) {
 			consume_token(is_open_parenthesis);
 		}
 		ast::expression* condition = consume_expression();
-		if (condition_in_parentheses) {
+		if (in_parentheses) {
 			consume_token(is_close_parenthesis);
 		}
-		t = next_token();
+		return failed ? nullptr : condition;
+	}
+	ast::if_statement* consume_if_statement() {
+		consume_token(is_if_token);
+		ast::expression* condition = consume_condition();
+		if (failed) {
+			return nullptr;
+		}
+		tokenizer::token* t = next_token();
 		if (is_then_token(t)) {
 			consume_token(is_then_token);
 		}
 		ast::statement* if_clause = consume_statement(false);
+		if (failed) {
+			return nullptr;
+		}
 		ast::statement* else_clause = nullptr;
 		t = next_token();
 		if (is_else_token(t)) {
 			consume_token(is_else_token);
 			else_clause = consume_statement(false);
+			if (failed) {
+				return nullptr;
+			}
 		}
 		return new ast::if_statement(condition, if_clause, else_clause);
 	}
 	ast::while_statement* consume_while_statement() {
 		consume_token(is_while_token);
-		tokenizer::token* t = next_token();
-		bool condition_in_parentheses = is_open_parenthesis(t);
-		if (condition_in_parentheses) {
-			consume_token(is_open_parenthesis);
-		}
-		ast::expression* condition = consume_expression();
-		if (condition_in_parentheses) {
-			consume_token(is_close_parenthesis);
+		ast::expression* condition = consume_condition();
+		if (failed) {
+			return nullptr;
 		}
 		ast::statement* while_clause = consume_statement(false);
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::while_statement(condition, while_clause);
 	}
 	ast::do_while_statement* consume_do_while_statement() {
 		consume_token(is_do_token);
 		ast::statement* do_while_clause = consume_statement(false);
 		consume_token(is_while_token);
-		tokenizer::token* t = next_token();
-		bool condition_in_parentheses = is_open_parenthesis(t);
-		if (condition_in_parentheses) {
-			consume_token(is_open_parenthesis);
-		}
-		ast::expression* condition = consume_expression();
-		if (condition_in_parentheses) {
-			consume_token(is_close_parenthesis);
+		ast::expression* condition = consume_condition();
+		if (failed) {
+			return nullptr;
 		}
 		return new ast::do_while_statement(do_while_clause, condition);
 	}
 	ast::for_statement* consume_for_statement() {
 		consume_token(is_for_token);
 		consume_token(is_open_parenthesis);
+		if (failed) {
+			return nullptr;
+		}
 
 		tokenizer::token* t = next_token();
 		ast::statement* initializer;
@@ -649,6 +761,9 @@ private:
 			initializer = consume_statement(false);
 		}
 		consume_token(is_semicolon);
+		if (failed) {
+			return nullptr;
+		}
 
 		t = next_token();
 		ast::expression* condition;
@@ -658,6 +773,9 @@ private:
 			condition = consume_expression();
 		}
 		consume_token(is_semicolon);
+		if (failed) {
+			return nullptr;
+		}
 
 		t = next_token();
 		ast::statement* increment;
@@ -667,33 +785,43 @@ private:
 			increment = consume_statement(false);
 		}
 		consume_token(is_close_parenthesis);
+		if (failed) {
+			return nullptr;
+		}
 
 		ast::statement* for_clause = consume_statement(false);
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::for_statement(initializer, condition, increment,
 				for_clause);
 	}
 	ast::forever_statement* consume_forever_statement() {
 		consume_token(is_forever_token);
 		ast::statement* forever_clause = consume_statement(false);
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::forever_statement(forever_clause);
 	}
 	ast::repeat_statement* consume_repeat_statement() {
 		consume_token(is_repeat_token);
-		tokenizer::token* t = next_token();
-		bool times_in_parentheses = is_open_parenthesis(t);
-		if (times_in_parentheses) {
-			consume_token(is_open_parenthesis);
-		}
-		ast::expression* times = consume_expression();
-		if (times_in_parentheses) {
-			consume_token(is_close_parenthesis);
+		ast::expression* times = consume_condition();
+		if (failed) {
+			return nullptr;
 		}
 		ast::statement* repeat_clause = consume_statement(false);
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::repeat_statement(times, repeat_clause);
 	}
 	ast::return_statement* consume_return_statement() {
 		consume_token(is_return_token);
 		ast::expression* operand = consume_expression();
+		if (failed) {
+			return nullptr;
+		}
 		return new ast::return_statement(operand);
 	}
 	void consume_end_statement() {
@@ -701,7 +829,6 @@ private:
 			consume_token(is_semicolon);
 		}
 	}
-
 	static bool is_identifier(tokenizer::token* t) {
 		return t != nullptr && t->kind == tokenizer::token_kind::IDENTIFIER;
 	}
@@ -760,7 +887,7 @@ private:
 		return is_identifier(t) && t->text == "return";
 	}
 	static bool is_modifier(tokenizer::token* t) {
-		return is_identifier(t) && modifiers.count(t->text);
+		return is_identifier(t) && lookup::contains(modifiers, t->text.c_str());
 	}
 	static bool is_open_brace(tokenizer::token* t) {
 		return is_operator(t) && t->text == "{";
@@ -800,21 +927,18 @@ private:
 	}
 	static bool is_left_unary_operator(tokenizer::token* t) {
 		return is_operator(t)
-				&& left_unary_operators.find(t->text)
-						!= left_unary_operators.end();
+				&& lookup::contains(left_unary_operators, t->text.c_str());
 	}
 	static bool is_right_unary_operator(tokenizer::token* t) {
 		return is_operator(t)
-				&& right_unary_operators.find(t->text)
-						!= right_unary_operators.end();
+				&& lookup::contains(right_unary_operators, t->text.c_str());
 	}
 	static bool is_middle_binary_operator(tokenizer::token* t) {
-		return is_operator(t) && operators.find(t->text) != operators.end();
+		return is_operator(t) && lookup::contains(operators, t->text.c_str());
 	}
 	static bool is_assignment_operator(tokenizer::token* t) {
 		return is_operator(t)
-				&& assignment_operators.find(t->text)
-						!= assignment_operators.end();
+				&& lookup::contains(assignment_operators, t->text.c_str());
 	}
 
 	tokenizer::token* next_token() {
@@ -837,13 +961,65 @@ private:
 		next_index++;
 		return ret;
 	}
+	// returns nullptr if the token doesn't match, or something has already
+	// failed
 	tokenizer::token* consume_token(bool (*filter)(tokenizer::token*)) {
+		if (failed) {
+			return nullptr;
+		}
 		tokenizer::token* t = consume_token();
 		if (t == nullptr || !filter(t)) {
-			throw parser::parser_exception("Unexpected token", token_pos(t));
+			fail("Unexpected token", token_pos(t));
+			return nullptr;
 		}
 		return t;
 	}
+	// the same, but only the text is wanted
+	std::string consume_text(bool (*filter)(tokenizer::token*)) {
+		tokenizer::token* t = consume_token(filter);
+		return t == nullptr ? "" : t->text;
+	}
+	// only the first failure is kept, since everything after it is only
+	// returning
+	void fail(const char* message, std::int64_t pos) {
+		if (!failed) {
+			failed = true;
+			failure_message = message;
+			failure_pos = pos;
+		}
+	}
+	void report_failure() {
+		diags->report(diagnostics::stage::PARSE, failure_message, failure_pos);
+		failed = false;
+		reported = true;
+	}
+	// Carries on after an error from the next module, field or function. The
+	// braces from where parsing last carried on are followed, so that the
+	// close brace of a module which the error was in isn't taken for a stray
+	// one, but any other close brace is
+	void skip_to_next_ast_node(
+			std::vector<tokenizer::token>::size_type resumed_at) {
+		for (std::vector<tokenizer::token>::size_type i = resumed_at;
+				i < next_index; i++) {
+			follow_braces(i);
+		}
+		while (next_token() != nullptr && !is_ast_node_token(next_token())) {
+			follow_braces(next_index);
+			consume_token();
+		}
+	}
+	void follow_braces(std::vector<tokenizer::token>::size_type index) {
+		tokenizer::token* t = &(*tokens)[index];
+		if (is_open_brace(t)) {
+			// after either "module" or "module name"
+			bool module = (index >= 1 && is_module_token(&(*tokens)[index - 1]))
+					|| (index >= 2 && is_identifier(&(*tokens)[index - 1])
+							&& is_module_token(&(*tokens)[index - 2]));
+			open_braces.push_back(module);
+		} else if (is_close_brace(t) && !open_braces.empty()) {
+			open_braces.pop_back();
+		}
+	}
 	void push_saved_state() {
 		saved_next_indices.push_back(next_index);
 	}
@@ -853,6 +1029,7 @@ private:
 		}
 		saved_next_indices.pop_back();
 	}
+	// goes back to the saved state, forgetting any failure since then
 	void revert_saved_state() {
 		if (saved_next_indices.empty()) {
 			std::cerr << "State has not been saved!" << std::endl;
@@ -860,192 +1037,163 @@ private:
 		}
 		next_index = saved_next_indices[saved_next_indices.size() - 1];
 		saved_next_indices.pop_back();
+		failed = false;
 	}
 	void consume_eof() {
 		tokenizer::token* t = consume_token();
 		if (t != nullptr) {
-			throw parser::parser_exception("Expected end of file", t->pos);
+			fail("Expected end of file", t->pos);
 		}
 	}
-	int token_pos(tokenizer::token* t) {
-		return t == nullptr ? -1 : t->pos;
+	// running out of tokens is reported where the last token is
+	std::int64_t token_pos(tokenizer::token* t) {
+		if (t != nullptr) {
+			return t->pos;
+		}
+		return tokens->empty() ? diagnostics::NO_POS : tokens->back().pos;
 	}
 };
 
-enum class node_type {
-	AST_NODE, STATEMENT, EXPRESSION
-};
-
-class parentifier_visitor: public ast::ast_visitor {
-	std::vector<void*> parent_stack;
-	std::vector<node_type> types;
-public:
-	void visit_ast_node(ast::ast_node* node) {
-		if (!parent_stack.empty()) {
-			node->set_parent_node(
-					static_cast<ast::ast_node*>(parent_stack.back()));
-		}
-		parent_stack.push_back(node);
-		types.push_back(node_type::AST_NODE);
-		ast::ast_visitor::visit_ast_node(node);
-		parent_stack.pop_back();
-		types.pop_back();
-	}
-	void visit_statement(ast::statement* stmt) {
-		void* parent = parent_stack.back();
-		node_type type = types.back();
-		if (type == node_type::STATEMENT) {
-			stmt->set_parent_statement(static_cast<ast::statement*>(parent));
-		} else {
-			stmt->set_parent_node(static_cast<ast::ast_node*>(parent));
-		}
-		parent_stack.push_back(stmt);
-		types.push_back(node_type::STATEMENT);
-		ast::ast_visitor::visit_statement(stmt);
-		parent_stack.pop_back();
-		types.pop_back();
-	}
-	void visit_expression(ast::expression* expr) {
-		void* parent = parent_stack.back();
-		node_type type = types.back();
-		if (type == node_type::EXPRESSION) {
-			expr->set_parent_expression(static_cast<ast::expression*>(parent));
-		} else if (type == node_type::STATEMENT) {
-			expr->set_parent_statement(static_cast<ast::statement*>(parent));
-		} else {
-			expr->set_parent_node(static_cast<ast::ast_node*>(parent));
-		}
-		parent_stack.push_back(expr);
-		types.push_back(node_type::EXPRESSION);
-		ast::ast_visitor::visit_expression(expr);
-		parent_stack.pop_back();
-		types.pop_back();
-	}
+// the lower the level, the tighter the operator binds
+struct precedence_entry {
+	const char* name;
+	int level;
 };
+constexpr precedence_entry op_precedence[] = { { "!=", 2 }, { "%", 0 },
+		{ "&", 4 }, { "&&", 3 }, { "*", 0 }, { "+", 1 }, { "-", 1 }, { "/", 0 },
+		{ "<", 2 }, { "<<", 4 }, { "<=", 2 }, { "==", 2 }, { ">", 2 },
+		{ ">=", 2 }, { ">>", 4 }, { "^", 4 }, { "^^", 3 }, { "|", 4 },
+		{ "||", 3 } };
+static_assert(lookup::is_sorted(op_precedence), "op_precedence must be sorted");
+// anything else binds the loosest of all
+const int UNKNOWN_OP_PRECEDENCE = 5;
 
-std::vector<std::set<std::string>> create_op_precedence() {
-	std::vector<std::set<std::string>> levels;
-	{
-		std::set<std::string> level;
-		level.insert("*");
-		level.insert("/");
-		level.insert("%");
-		levels.push_back(level);
-	}
-	{
-		std::set<std::string> level;
-		level.insert("+");
-		level.insert("-");
-		levels.push_back(level);
-	}
-	{
-		std::set<std::string> level;
-		level.insert("==");
-		level.insert("!=");
-		level.insert("<");
-		level.insert("<=");
-		level.insert(">");
-		level.insert(">=");
-		levels.push_back(level);
-	}
-	{
-		std::set<std::string> level;
-		level.insert("&&");
-		level.insert("||");
-		level.insert("^^");
-		levels.push_back(level);
-	}
-	{
-		std::set<std::string> level;
-		level.insert("&");
-		level.insert("|");
-		level.insert("^");
-		level.insert(">>");
-		level.insert("<<");
-		levels.push_back(level);
-	}
-	return levels;
+constexpr int get_op_precedence(const char* operator_name) {
+	return lookup::index_of(op_precedence, operator_name) == -1 ?
+			UNKNOWN_OP_PRECEDENCE :
+			op_precedence[lookup::index_of(op_precedence, operator_name)].level;
 }
-std::vector<std::set<std::string>> op_precedence = create_op_precedence();
 
-class operator_precedence_fix_visitor: public ast::ast_visitor {
+class operator_precedence_fix_pass: public passes::pass {
 	// by default, 1 * 2 - 3 / 4 is encoded as (1 * (2 - (3 / 4)))
-	// this is changed by this visitor into    ((1 * 2) - (3 / 4))
-	std::set<ast::operator_expression*> already_visited;
+	// this is changed by this pass into       ((1 * 2) - (3 / 4))
 public:
-	void visit_operator_expression(ast::operator_expression* expr) {
-		if (already_visited.find(expr) != already_visited.end()) {
-			return;
-		}
-		already_visited.insert(expr);
-		ast::expression* parent = expr->get_parent_expression();
-		if (parent == nullptr
-				|| !parent->is_of_expression_kind(
-						ast::expression_kind::OPERATOR)) {
-			return;
-		}
-		ast::operator_expression* parent_op =
-				static_cast<ast::operator_expression*>(parent);
-
-		int this_op_precedence = 0;
-		for (std::set<std::string>& level : op_precedence) {
-			if (level.find(expr->get_operator()) != level.end()) {
+	std::string get_name() {
+		return "operator precedence fix";
+	}
+	int get_node_kinds() {
+		return passes::EXPRESSIONS;
+	}
+	bool modifies_tree() {
+		return true;
+	}
+	void enter_expression(ast::expression*& expr) {
+		// the parser always puts the rest of the expression in the rhs, so
+		// keep rotating the rhs up while it doesn't bind more tightly than us
+		while (expr->is_of_expression_kind(ast::expression_kind::OPERATOR)) {
+			ast::operator_expression* op =
+					static_cast<ast::operator_expression*>(expr);
+			ast::expression* rhs = op->get_rhs();
+			if (!rhs->is_of_expression_kind(ast::expression_kind::OPERATOR)) {
 				break;
 			}
-			this_op_precedence++;
-		}
-
-		int parent_op_precedence = 0;
-		for (std::set<std::string>& level : op_precedence) {
-			if (level.find(parent_op->get_operator()) != level.end()) {
+			ast::operator_expression* rhs_op =
+					static_cast<ast::operator_expression*>(rhs);
+			if (get_op_precedence(op->get_operator().c_str())
+					> get_op_precedence(rhs_op->get_operator().c_str())) {
 				break;
 			}
-			parent_op_precedence++;
-		}
-
-		if (parent_op_precedence <= this_op_precedence) {
-			// precedence in wrong order, change it
-			parent_op->set_rhs(expr->get_lhs());
-			expr->set_lhs(parent_op);
-			std::vector<ast::expression**>* parent_parent_children;
-			if (parent_op->get_parent_expression() != nullptr) {
-				expr->set_parent_expression(parent_op->get_parent_expression());
-				parent_parent_children =
-						parent_op->get_parent_expression()->get_children();
-			} else if (parent_op->get_parent_statement() != nullptr) {
-				expr->set_parent_expression(nullptr);
-				expr->set_parent_statement(parent_op->get_parent_statement());
-				parent_parent_children =
-						parent_op->get_parent_statement()->get_child_expressions();
-				parent_op->set_parent_statement(nullptr);
-			} else {
-				expr->set_parent_expression(nullptr);
-				expr->set_parent_node(parent_op->get_parent_node());
-				parent_parent_children =
-						parent_op->get_parent_node()->get_child_expressions();
-				parent_op->set_parent_node(nullptr);
-			}
-			parent_op->set_parent_expression(expr);
-			for (ast::expression**& child_ptr : *parent_parent_children) {
-				if (*child_ptr == parent_op) {
-					*child_ptr = expr;
-					break;
-				}
-			}
-			delete parent_parent_children;
+			op->set_rhs(rhs_op->get_lhs());
+			rhs_op->set_lhs(op);
+			expr = rhs_op;
 		}
 	}
 };
-std::vector<ast::ast_node*>* parser::parse(
-		std::vector<tokenizer::token> tokens) {
-	parser_cls p(&tokens);
+
+void parser::add_post_processing_passes(passes::pass_manager* manager) {
+	manager->add_pass(new operator_precedence_fix_pass);
+}
+std::vector<ast::ast_node*>* parse_tokens(
+		std::vector<tokenizer::token>& tokens,
+		diagnostics::diagnostic_buffer* diags, std::vector<bool>& open_braces) {
+	parser_cls p(&tokens, diags, open_braces);
 	std::vector<ast::ast_node*>* nodes = p.consume_root();
-	ast::ast_visitor* visitor = new parentifier_visitor;
-	visitor->visit_all(nodes);
-	delete visitor;
-	visitor = new operator_precedence_fix_visitor;
-	visitor->visit_all(nodes);
-	delete visitor;
+	if (p.has_reported()) {
+		for (ast::ast_node* node : *nodes) {
+			delete node;
+		}
+		delete nodes;
+		return nullptr;
+	}
 	return nodes;
 }
+std::vector<ast::ast_node*>* parser::parse_unprocessed(
+		std::vector<tokenizer::token>& tokens,
+		diagnostics::diagnostic_buffer* diags) {
+	std::vector<bool> open_braces;
+	return parse_tokens(tokens, diags, open_braces);
+}
+void parser::stream_parser::add_tokens(
+		std::vector<tokenizer::token>& tokens) {
+	for (tokenizer::token& t : tokens) {
+		pending.push_back(std::move(t));
+	}
+	tokens.clear();
+}
+// a top-level node is complete once the next one starts outside of any
+// brackets, which is how recovering from an error finds the next node too
+void parser::stream_parser::scan() {
+	for (std::size_t e = pending.size(); scanned < e; scanned++) {
+		tokenizer::token* t = &pending[scanned];
+		if (depth == 0 && scanned != 0 && parser_cls::starts_ast_node(t)) {
+			complete = scanned;
+		}
+		if (t->kind != tokenizer::token_kind::OPERATOR) {
+			continue;
+		}
+		if (t->text == "(" || t->text == "[" || t->text == "{") {
+			depth++;
+		} else if ((t->text == ")" || t->text == "]" || t->text == "}")
+				&& depth > 0) {
+			depth--;
+		}
+	}
+}
+bool parser::stream_parser::parse_complete_nodes(
+		std::vector<ast::ast_node*>& nodes, bool at_end,
+		diagnostics::diagnostic_buffer* diags) {
+	scan();
+	std::size_t end = at_end ? pending.size() : complete;
+	if (end == 0) {
+		return true;
+	}
+	std::vector<tokenizer::token> node_tokens(
+			std::make_move_iterator(pending.begin()),
+			std::make_move_iterator(pending.begin() + end));
+	pending.erase(pending.begin(), pending.begin() + end);
+	scanned -= end;
+	complete = 0;
+	// a module with an error in it can carry on past where the nodes were
+	// split, so what the recovery knows is kept for the next ones
+	std::vector<ast::ast_node*>* parsed = parse_tokens(node_tokens, diags,
+			open_braces);
+	if (parsed == nullptr) {
+		return false;
+	}
+	nodes.insert(nodes.end(), parsed->begin(), parsed->end());
+	delete parsed;
+	return true;
+}
 
+std::vector<ast::ast_node*>* parser::parse(
+		std::vector<tokenizer::token>& tokens,
+		diagnostics::diagnostic_buffer* diags) {
+	std::vector<ast::ast_node*>* nodes = parse_unprocessed(tokens, diags);
+	if (nodes == nullptr) {
+		return nullptr;
+	}
+	passes::pass_manager manager;
+	add_post_processing_passes(&manager);
+	manager.run(nodes);
+	return nodes;
+}
@@ -5,23 +5,52 @@
 #ifndef PARSER_HPP_
 #define PARSER_HPP_
 
+#include <cstddef>
 #include <vector>
 #include "tokenizer.hpp"
 #include "crosslang_ast.hpp"
+#include "diagnostics.hpp"
+#include "pass_manager.hpp"
 
 namespace parser {
 
-class parser_exception: public std::exception {
-	int pos;
-	const char* desc;
+// returns nullptr if there were any errors, which are added to the
+// diagnostics. Parsing carries on after an error from the next module, field
+// or function, so that every error in the file is found
+std::vector<ast::ast_node*>* parse(std::vector<tokenizer::token>& tokens,
+		diagnostics::diagnostic_buffer* diags);
+// parses without running the post-processing passes, which the caller must
+// then run itself, e.g. fused with its own passes
+std::vector<ast::ast_node*>* parse_unprocessed(
+		std::vector<tokenizer::token>& tokens,
+		diagnostics::diagnostic_buffer* diags);
+void add_post_processing_passes(passes::pass_manager* manager);
+
+// parses tokens which are given a piece at a time, such as from a
+// tokenizer::stream_tokenizer. Each top-level node is parsed once all of its
+// tokens have been seen, so only the tokens of the nodes which aren't
+// finished yet are kept
+class stream_parser {
+	std::vector<tokenizer::token> pending;
+	// how far through the pending tokens has been looked at, and how deep in
+	// brackets that is
+	std::size_t scanned = 0;
+	int depth = 0;
+	// where the last complete top-level node in the pending tokens ends
+	std::size_t complete = 0;
+	// the braces left open by recovering from errors in the nodes so far
+	std::vector<bool> open_braces;
+	void scan();
 public:
-	parser_exception(const char* desc, int pos);
-	~parser_exception() throw ();
-	const char* what();
-	int get_pos();
+	// moves the tokens to the end of the pending ones, leaving the vector empty
+	void add_tokens(std::vector<tokenizer::token>& tokens);
+	// parses the top-level nodes which are complete, or everything left at
+	// the end of the tokens, without the post-processing passes. The nodes
+	// are added to the vector. If there are errors, they're added to the
+	// diagnostics, nothing is added and false is returned
+	bool parse_complete_nodes(std::vector<ast::ast_node*>& nodes, bool at_end,
+			diagnostics::diagnostic_buffer* diags);
 };
 
-std::vector<ast::ast_node*>* parse(std::vector<tokenizer::token> tokens);
-
 }
 #endif /* PARSER_HPP_ */
@@ -0,0 +1,240 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include "pass_manager.hpp"
+
+int passes::pass::get_node_kinds() {
+	return passes::ALL_NODES;
+}
+passes::traversal_order passes::pass::get_traversal_order() {
+	return passes::traversal_order::PRE_ORDER;
+}
+bool passes::pass::modifies_tree() {
+	return false;
+}
+void passes::pass::begin_tree(std::vector<ast::ast_node*>* nodes) {
+}
+void passes::pass::end_tree(std::vector<ast::ast_node*>* nodes) {
+}
+void passes::pass::enter_ast_node(ast::ast_node*& node) {
+	node->accept(this);
+}
+// a pre and post order pass has already visited the node on the way in
+void passes::pass::leave_ast_node(ast::ast_node*& node) {
+	if (get_traversal_order() == passes::traversal_order::POST_ORDER) {
+		node->accept(this);
+	}
+}
+void passes::pass::enter_statement(ast::statement*& stmt) {
+	stmt->accept(this);
+}
+void passes::pass::leave_statement(ast::statement*& stmt) {
+	if (get_traversal_order() == passes::traversal_order::POST_ORDER) {
+		stmt->accept(this);
+	}
+}
+void passes::pass::enter_expression(ast::expression*& expr) {
+	expr->accept(this);
+}
+void passes::pass::leave_expression(ast::expression*& expr) {
+	if (get_traversal_order() == passes::traversal_order::POST_ORDER) {
+		expr->accept(this);
+	}
+}
+ast::parent_table* passes::pass::get_parent_table() {
+	return manager->get_parent_table();
+}
+
+class fused_walk {
+	typedef std::chrono::steady_clock clock;
+	std::vector<passes::pass*> passes;
+	std::vector<passes::pass_statistics*> statistics;
+	std::vector<int> pre_kinds;
+	std::vector<int> post_kinds;
+	bool walk_statements = false;
+	bool walk_expressions = false;
+	bool timed;
+public:
+	fused_walk(bool timed) :
+			timed(timed) {
+	}
+	void add_pass(passes::pass* p, passes::pass_statistics* stats) {
+		passes.push_back(p);
+		statistics.push_back(stats);
+		int kinds = p->get_node_kinds();
+		passes::traversal_order order = p->get_traversal_order();
+		bool pre = order != passes::traversal_order::POST_ORDER;
+		bool post = order != passes::traversal_order::PRE_ORDER;
+		pre_kinds.push_back(pre ? kinds : 0);
+		post_kinds.push_back(post ? kinds : 0);
+		// statements have to be walked to get to the expressions inside them
+		if (kinds & (passes::STATEMENTS | passes::EXPRESSIONS)) {
+			walk_statements = true;
+		}
+		if (kinds & passes::EXPRESSIONS) {
+			walk_expressions = true;
+		}
+	}
+	void walk(std::vector<ast::ast_node*>* nodes) {
+		for (passes::pass* p : passes) {
+			p->begin_tree(nodes);
+		}
+		for (ast::ast_node*& node : *nodes) {
+			walk_ast_node(node);
+		}
+		for (passes::pass* p : passes) {
+			p->end_tree(nodes);
+		}
+	}
+private:
+	template<typename T>
+	void enter(T*& node, int kind, void (passes::pass::*hook)(T*&)) {
+		for (int i = 0, e = passes.size(); i < e; i++) {
+			if (pre_kinds[i] & kind) {
+				call_hook(i, node, hook);
+				statistics[i]->node_count++;
+			}
+		}
+	}
+	template<typename T>
+	void leave(T*& node, int kind, void (passes::pass::*hook)(T*&)) {
+		// leave hooks are called in the opposite order to the enter hooks so
+		// that passes nest properly
+		for (int i = passes.size() - 1; i >= 0; i--) {
+			if (post_kinds[i] & kind) {
+				call_hook(i, node, hook);
+				if (!(pre_kinds[i] & kind)) {
+					statistics[i]->node_count++;
+				}
+			}
+		}
+	}
+	template<typename T>
+	void call_hook(int i, T*& node, void (passes::pass::*hook)(T*&)) {
+		if (!timed) {
+			(passes[i]->*hook)(node);
+			return;
+		}
+		clock::time_point start = clock::now();
+		(passes[i]->*hook)(node);
+		statistics[i]->time += clock::now() - start;
+	}
+	void walk_child_expressions(std::vector<ast::expression**>* children) {
+		for (ast::expression** child : *children) {
+			// optional children, such as a missing initializer, are null
+			if (*child != nullptr) {
+				walk_expression(*child);
+			}
+		}
+		delete children;
+	}
+	void walk_child_statements(std::vector<ast::statement**>* children) {
+		for (ast::statement** child : *children) {
+			if (*child != nullptr) {
+				walk_statement(*child);
+			}
+		}
+		delete children;
+	}
+	void walk_ast_node(ast::ast_node*& node) {
+		enter(node, passes::AST_NODES, &passes::pass::enter_ast_node);
+		if (walk_expressions) {
+			walk_child_expressions(node->get_child_expressions());
+		}
+		if (walk_statements) {
+			walk_child_statements(node->get_child_statements());
+		}
+		std::vector<ast::ast_node**>* children = node->get_child_nodes();
+		for (ast::ast_node** child : *children) {
+			walk_ast_node(*child);
+		}
+		delete children;
+		leave(node, passes::AST_NODES, &passes::pass::leave_ast_node);
+	}
+	void walk_statement(ast::statement*& stmt) {
+		enter(stmt, passes::STATEMENTS, &passes::pass::enter_statement);
+		if (walk_expressions) {
+			walk_child_expressions(stmt->get_child_expressions());
+		}
+		walk_child_statements(stmt->get_child_statements());
+		leave(stmt, passes::STATEMENTS, &passes::pass::leave_statement);
+	}
+	void walk_expression(ast::expression*& expr) {
+		enter(expr, passes::EXPRESSIONS, &passes::pass::enter_expression);
+		walk_child_expressions(expr->get_children());
+		leave(expr, passes::EXPRESSIONS, &passes::pass::leave_expression);
+	}
+};
+
+passes::pass_manager::pass_manager() {
+}
+passes::pass_manager::~pass_manager() {
+	for (passes::pass* p : passes) {
+		delete p;
+	}
+	delete parents;
+}
+void passes::pass_manager::add_pass(passes::pass* p) {
+	// a pass can share the current walk unless it modifies the tree and an
+	// earlier pass in the walk looks at the same kinds of node
+	bool new_walk = walk_starts.empty();
+	if (!new_walk && p->modifies_tree()) {
+		for (std::vector<passes::pass*>::size_type i = walk_starts.back(), e =
+				passes.size(); i < e; i++) {
+			if (passes[i]->get_node_kinds() & p->get_node_kinds()) {
+				new_walk = true;
+				break;
+			}
+		}
+	}
+	if (new_walk) {
+		walk_starts.push_back(passes.size());
+	}
+	passes.push_back(p);
+	p->manager = this;
+	passes::pass_statistics stats;
+	stats.name = p->get_name();
+	stats.walk = walk_starts.size();
+	stats.node_count = 0;
+	stats.time = std::chrono::steady_clock::duration::zero();
+	statistics.push_back(stats);
+}
+void passes::pass_manager::run(std::vector<ast::ast_node*>* nodes) {
+	current_tree = nodes;
+	for (std::vector<passes::pass*>::size_type w = 0, e = walk_starts.size();
+			w < e; w++) {
+		std::vector<passes::pass*>::size_type end =
+				w + 1 < e ? walk_starts[w + 1] : passes.size();
+		fused_walk walk(timing);
+		bool modifies_tree = false;
+		for (std::vector<passes::pass*>::size_type i = walk_starts[w]; i < end;
+				i++) {
+			walk.add_pass(passes[i], &statistics[i]);
+			modifies_tree |= passes[i]->modifies_tree();
+		}
+		walk.walk(nodes);
+		if (modifies_tree) {
+			delete parents;
+			parents = nullptr;
+		}
+	}
+	delete parents;
+	parents = nullptr;
+	current_tree = nullptr;
+}
+ast::parent_table* passes::pass_manager::get_parent_table() {
+	if (parents == nullptr) {
+		parents = new ast::parent_table(current_tree);
+	}
+	return parents;
+}
+int passes::pass_manager::get_walk_count() {
+	return walk_starts.size();
+}
+void passes::pass_manager::set_timing(bool timing) {
+	this->timing = timing;
+}
+std::vector<passes::pass_statistics>* passes::pass_manager::get_statistics() {
+	return &statistics;
+}
@@ -0,0 +1,95 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef PASS_MANAGER_HPP_
+#define PASS_MANAGER_HPP_
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "parent_table.hpp"
+
+namespace passes {
+
+class pass_manager;
+
+// the kinds of node a pass wants to be called for. These are bit flags, so a
+// pass can ask for any combination of them
+const int AST_NODES = 1;
+const int STATEMENTS = 2;
+const int EXPRESSIONS = 4;
+const int ALL_NODES = AST_NODES | STATEMENTS | EXPRESSIONS;
+
+enum class traversal_order {
+	PRE_ORDER, POST_ORDER, PRE_AND_POST_ORDER
+};
+
+// A pass is a visitor which doesn't walk the tree itself. Instead, the pass
+// manager walks the tree once for as many passes as it can and calls the
+// enter_* hooks before a node's children are walked and the leave_* hooks
+// after. By default the hook for the pass's traversal order calls accept() on
+// the node, so a pass only needs to override the visit_* functions it cares
+// about. A pre and post order pass's nodes are visited on the way in.
+// The hooks are given the slot the node is stored in, so a pass may replace
+// the node by assigning to it.
+class pass: public ast::ast_visitor {
+	friend class pass_manager;
+	pass_manager* manager = nullptr;
+public:
+	virtual std::string get_name() = 0;
+	virtual int get_node_kinds();
+	virtual traversal_order get_traversal_order();
+	// a pass which replaces or moves nodes around must return true, so that
+	// it's never run in the same walk as an earlier pass which would then
+	// see a mixture of the old and new tree
+	virtual bool modifies_tree();
+	virtual void begin_tree(std::vector<ast::ast_node*>* nodes);
+	virtual void end_tree(std::vector<ast::ast_node*>* nodes);
+	virtual void enter_ast_node(ast::ast_node*& node);
+	virtual void leave_ast_node(ast::ast_node*& node);
+	virtual void enter_statement(ast::statement*& stmt);
+	virtual void leave_statement(ast::statement*& stmt);
+	virtual void enter_expression(ast::expression*& expr);
+	virtual void leave_expression(ast::expression*& expr);
+protected:
+	// see pass_manager::get_parent_table()
+	ast::parent_table* get_parent_table();
+};
+
+struct pass_statistics {
+	std::string name;
+	int walk;
+	long node_count;
+	// only added up while the pass manager is timing its passes
+	std::chrono::steady_clock::duration time;
+};
+
+class pass_manager {
+	std::vector<pass*> passes;
+	std::vector<std::vector<pass*>::size_type> walk_starts;
+	std::vector<pass_statistics> statistics;
+	std::vector<ast::ast_node*>* current_tree = nullptr;
+	ast::parent_table* parents = nullptr;
+	bool timing = false;
+public:
+	pass_manager();
+	~pass_manager();
+	// takes ownership of the pass
+	void add_pass(pass* p);
+	void run(std::vector<ast::ast_node*>* nodes);
+	// the parents of the nodes in the tree being run on. The table is only
+	// built the first time a pass asks for it, and is thrown away after a
+	// walk with a pass that modifies the tree
+	ast::parent_table* get_parent_table();
+	int get_walk_count();
+	// reading the clock around every hook costs more than many of the hooks
+	// themselves, so the passes are only timed when it's asked for
+	void set_timing(bool timing);
+	std::vector<pass_statistics>* get_statistics();
+};
+
+}
+
+#endif /* PASS_MANAGER_HPP_ */
@@ -0,0 +1,127 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <chrono>
+#include <thread>
+#include "pipeline.hpp"
+
+// sent along after the last item
+const int END_OF_ITEMS = -1;
+
+double concurrency::stage_stats::get_utilization() {
+	double total = busy_seconds + starved_seconds + blocked_seconds;
+	return total == 0 ? 0 : busy_seconds / total;
+}
+
+concurrency::pipeline::pipeline(std::size_t queue_capacity) :
+		queue_capacity(queue_capacity) {
+}
+void concurrency::pipeline::add_stage(std::string name,
+		std::function<void(int)> work) {
+	stage s;
+	s.name = name;
+	s.work = work;
+	stages.push_back(s);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+void push_item(concurrency::bounded_queue<int>* queue, int item,
+		concurrency::stage_stats& stats) {
+	if (queue == nullptr) {
+		return;
+	}
+	if (queue->try_push(item)) {
+		return;
+	}
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	queue->push(item);
+	stats.blocked_seconds += seconds_since(start);
+}
+
+int pop_item(concurrency::bounded_queue<int>* queue,
+		concurrency::stage_stats& stats) {
+	int item;
+	if (queue->try_pop(item)) {
+		return item;
+	}
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	queue->pop(item);
+	stats.starved_seconds += seconds_since(start);
+	return item;
+}
+
+void concurrency::pipeline::run(int item_count,
+		std::function<bool(int)> should_start) {
+	int stage_count = stages.size();
+	stats.assign(stage_count, concurrency::stage_stats());
+	std::vector<concurrency::bounded_queue<int>*> queues;
+	for (int i = 1; i < stage_count; i++) {
+		queues.push_back(new concurrency::bounded_queue<int>(queue_capacity));
+	}
+	std::vector<std::exception_ptr> errors(stage_count);
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < stage_count; i++) {
+		threads.push_back(
+				std::thread(
+						[this, i, stage_count, item_count, &should_start, &queues,
+								&errors]() {
+							concurrency::stage_stats& my_stats = stats[i];
+							my_stats.name = stages[i].name;
+							concurrency::bounded_queue<int>* in =
+									i == 0 ? nullptr : queues[i - 1];
+							concurrency::bounded_queue<int>* out =
+									i == stage_count - 1 ? nullptr : queues[i];
+							for (int next = 0;; next++) {
+								int item;
+								if (in == nullptr) {
+									item = next < item_count && should_start(next) ?
+											next : END_OF_ITEMS;
+								} else {
+									item = pop_item(in, my_stats);
+								}
+								if (item == END_OF_ITEMS) {
+									break;
+								}
+								// after an exception, items are still taken so
+								// that the stage before isn't left waiting
+								if (errors[i] != nullptr) {
+									continue;
+								}
+								std::chrono::steady_clock::time_point start =
+										std::chrono::steady_clock::now();
+								try {
+									stages[i].work(item);
+								} catch (...) {
+									errors[i] = std::current_exception();
+									continue;
+								}
+								my_stats.busy_seconds += seconds_since(start);
+								my_stats.items++;
+								push_item(out, item, my_stats);
+							}
+							push_item(out, END_OF_ITEMS, my_stats);
+						}));
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	for (concurrency::bounded_queue<int>* queue : queues) {
+		delete queue;
+	}
+	for (std::exception_ptr& error : errors) {
+		if (error != nullptr) {
+			std::rethrow_exception(error);
+		}
+	}
+}
+std::vector<concurrency::stage_stats>* concurrency::pipeline::get_stats() {
+	return &stats;
+}
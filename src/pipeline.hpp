@@ -0,0 +1,169 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef PIPELINE_HPP_
+#define PIPELINE_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace concurrency {
+
+// A fixed size queue for exactly one thread pushing and one thread popping,
+// which doesn't lock unless one side has to wait for the other. Each side
+// only writes its own end of the queue.
+template<typename T>
+class bounded_queue {
+	// how many times a side tries again before it goes to sleep
+	static const int SPIN_COUNT = 64;
+	std::vector<T> slots;
+	// one slot is always left empty, to tell a full queue from an empty one
+	std::size_t capacity;
+	std::atomic<std::size_t> head;
+	std::atomic<std::size_t> tail;
+	// only used by a side which is asleep, and the side which wakes it
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::atomic<int> sleepers;
+public:
+	bounded_queue(std::size_t capacity) :
+			slots(capacity + 1), capacity(capacity + 1), head(0), tail(0), sleepers(
+					0) {
+	}
+	// returns false if the queue is full
+	bool try_push(const T& value) {
+		if (!push_quietly(value)) {
+			return false;
+		}
+		wake_sleepers();
+		return true;
+	}
+	// returns false if the queue is empty
+	bool try_pop(T& value) {
+		if (!pop_quietly(value)) {
+			return false;
+		}
+		wake_sleepers();
+		return true;
+	}
+	// these wait until there's room or an item. They spin for a while in case
+	// the other side is nearly done, then sleep until it wakes them
+	void push(const T& value) {
+		for (int i = 0; i < SPIN_COUNT; i++) {
+			if (try_push(value)) {
+				return;
+			}
+			std::this_thread::yield();
+		}
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			go_to_sleep();
+			while (!push_quietly(value)) {
+				changed.wait(lock);
+			}
+			sleepers.fetch_sub(1);
+		}
+		wake_sleepers();
+	}
+	void pop(T& value) {
+		for (int i = 0; i < SPIN_COUNT; i++) {
+			if (try_pop(value)) {
+				return;
+			}
+			std::this_thread::yield();
+		}
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			go_to_sleep();
+			while (!pop_quietly(value)) {
+				changed.wait(lock);
+			}
+			sleepers.fetch_sub(1);
+		}
+		wake_sleepers();
+	}
+private:
+	bool push_quietly(const T& value) {
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		std::size_t next = (t + 1) % capacity;
+		if (next == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		slots[t] = value;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+	bool pop_quietly(T& value) {
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = slots[h];
+		head.store((h + 1) % capacity, std::memory_order_release);
+		return true;
+	}
+	// The fences order counting a sleeper against the other side's push or
+	// pop, so either the sleeper sees the change before it waits, or the
+	// other side sees the sleeper and wakes it
+	void go_to_sleep() {
+		sleepers.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	void wake_sleepers() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) != 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			changed.notify_all();
+		}
+	}
+};
+
+// How a stage spent its time. A stage is starved while it waits for the
+// stage before it, and blocked while it waits for room in the queue to the
+// stage after it, so the stage with the highest utilization is the one
+// holding everything else up.
+struct stage_stats {
+	std::string name;
+	int items = 0;
+	double busy_seconds = 0;
+	double starved_seconds = 0;
+	double blocked_seconds = 0;
+	double get_utilization();
+};
+
+// Runs numbered items through a series of stages, each stage on its own
+// thread, so that while one item is in one stage the next item can be in the
+// stage before it. Every item goes through the stages in order, and each
+// stage sees the items in order. The queues between the stages only hold a
+// few items, so a fast stage waits for a slow one rather than running ahead
+// and keeping everything it has made in memory.
+class pipeline {
+	struct stage {
+		std::string name;
+		std::function<void(int)> work;
+	};
+	std::vector<stage> stages;
+	std::vector<stage_stats> stats;
+	std::size_t queue_capacity;
+public:
+	pipeline(std::size_t queue_capacity);
+	void add_stage(std::string name, std::function<void(int)> work);
+	// runs items 0 to item_count - 1 through the pipeline, and returns once
+	// they've all been through. The first stage stops starting items once
+	// should_start() returns false. If any stage throws, it stops taking
+	// items, and the exception from the earliest such stage is rethrown
+	void run(int item_count, std::function<bool(int)> should_start);
+	std::vector<stage_stats>* get_stats();
+};
+
+}
+
+#endif /* PIPELINE_HPP_ */
@@ -0,0 +1,166 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <algorithm>
+#include "qualified_index.hpp"
+
+bool indexer::qualified_entry::is_empty() {
+	return modules.empty() && fields.empty() && overloads.empty();
+}
+
+// removes one occurrence, if there is one
+template<typename T>
+void remove_from(std::vector<T*>& entries, T* entry) {
+	typename std::vector<T*>::iterator it = std::find(entries.begin(),
+			entries.end(), entry);
+	if (it != entries.end()) {
+		entries.erase(it);
+	}
+}
+
+indexer::qualified_index::qualified_index(indexer::index* dictionary) {
+	for (indexer::module_index* submodule : *dictionary->get_modules()) {
+		add_module("", submodule);
+	}
+	for (indexer::field_index* field : *dictionary->get_fields()) {
+		add_field("", field);
+	}
+	for (indexer::function_index* function : *dictionary->get_functions()) {
+		add_function("", function);
+	}
+}
+void indexer::qualified_index::add_module(const std::string& path,
+		indexer::module_index* module) {
+	std::string subpath = path;
+	if (module->has_name()) {
+		subpath = indexer::qualify(path, module->get_name());
+		get_entry(subpath).modules.push_back(module);
+	}
+	for (indexer::module_index* submodule : *module->get_modules()) {
+		add_module(subpath, submodule);
+	}
+	for (indexer::field_index* field : *module->get_fields()) {
+		add_field(subpath, field);
+	}
+	for (indexer::function_index* function : *module->get_functions()) {
+		add_function(subpath, function);
+	}
+}
+void indexer::qualified_index::add_field(const std::string& path,
+		indexer::field_index* field) {
+	get_entry(indexer::qualify(path, field->get_name())).fields.push_back(
+			field);
+}
+void indexer::qualified_index::add_function(const std::string& path,
+		indexer::function_index* function) {
+	get_entry(indexer::qualify(path, function->get_name())).overloads.push_back(
+			function);
+}
+void indexer::qualified_index::remove_module(const std::string& path,
+		indexer::module_index* module) {
+	std::string subpath = path;
+	if (module->has_name()) {
+		subpath = indexer::qualify(path, module->get_name());
+		remove_from(get_entry(subpath).modules, module);
+		remove_if_empty(subpath);
+	}
+	for (indexer::module_index* submodule : *module->get_modules()) {
+		remove_module(subpath, submodule);
+	}
+	for (indexer::field_index* field : *module->get_fields()) {
+		remove_field(subpath, field);
+	}
+	for (indexer::function_index* function : *module->get_functions()) {
+		remove_function(subpath, function);
+	}
+}
+void indexer::qualified_index::remove_field(const std::string& path,
+		indexer::field_index* field) {
+	std::string name = indexer::qualify(path, field->get_name());
+	remove_from(get_entry(name).fields, field);
+	remove_if_empty(name);
+}
+void indexer::qualified_index::remove_function(const std::string& path,
+		indexer::function_index* function) {
+	std::string name = indexer::qualify(path, function->get_name());
+	remove_from(get_entry(name).overloads, function);
+	remove_if_empty(name);
+}
+indexer::qualified_entry& indexer::qualified_index::get_entry(
+		const std::string& qualified_name) {
+	indexer::qualified_entry& entry = entries[qualified_name];
+	entry.name = qualified_name;
+	return entry;
+}
+void indexer::qualified_index::remove_if_empty(
+		const std::string& qualified_name) {
+	std::unordered_map<std::string, indexer::qualified_entry>::iterator it =
+			entries.find(qualified_name);
+	if (it != entries.end() && it->second.is_empty()) {
+		entries.erase(it);
+	}
+}
+indexer::qualified_entry* indexer::qualified_index::lookup(
+		const std::string& qualified_name) {
+	std::unordered_map<std::string, indexer::qualified_entry>::iterator it =
+			entries.find(qualified_name);
+	return it == entries.end() ? nullptr : &it->second;
+}
+indexer::qualified_entry* indexer::qualified_index::resolve(
+		const std::string& scope, const std::string& name) {
+	return resolve(scope, name, nullptr);
+}
+indexer::qualified_entry* indexer::qualified_index::resolve(
+		const std::string& scope, const std::string& name,
+		std::vector<std::string>* tried) {
+	std::string::size_type scope_end = scope.size();
+	while (true) {
+		std::string qualified_name = indexer::qualify(
+				scope.substr(0, scope_end), name);
+		indexer::qualified_entry* entry = lookup(qualified_name);
+		if (tried != nullptr) {
+			tried->push_back(qualified_name);
+		}
+		if (entry != nullptr || scope_end == 0) {
+			return entry;
+		}
+		// go out to the enclosing module
+		std::string::size_type separator = scope.rfind("::", scope_end - 1);
+		scope_end = separator == std::string::npos ? 0 : separator;
+	}
+}
+int indexer::qualified_index::get_entry_count() {
+	return entries.size();
+}
+
+std::string indexer::qualify(const std::string& scope,
+		const std::string& name) {
+	if (scope.empty()) {
+		return name;
+	}
+	return scope + "::" + name;
+}
+
+bool indexer::get_referenced_name(ast::expression* expr, std::string& name) {
+	switch (expr->get_expression_kind()) {
+	case ast::expression_kind::IDENTIFIER:
+		name = static_cast<ast::identifier_expression*>(expr)->get_identifier();
+		return true;
+	case ast::expression_kind::CALL:
+		name = static_cast<ast::call_expression*>(expr)->get_name();
+		return true;
+	case ast::expression_kind::NAMESPACE: {
+		ast::namespace_expression* ns =
+				static_cast<ast::namespace_expression*>(expr);
+		std::string rest;
+		if (!get_referenced_name(ns->get_operand(), rest)) {
+			return false;
+		}
+		name = ns->get_namespace() + "::" + rest;
+		return true;
+	}
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,76 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef QUALIFIED_INDEX_HPP_
+#define QUALIFIED_INDEX_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "indexer.hpp"
+
+namespace indexer {
+
+// everything with the same fully qualified name. A module, a field and
+// functions can all share a name, since they're used differently. There's
+// only more than one module or field with a name when they're in different
+// unnamed modules, which is up to whoever looks the name up to deal with
+struct qualified_entry {
+	std::string name;
+	std::vector<module_index*> modules;
+	std::vector<field_index*> fields;
+	std::vector<function_index*> overloads;
+	bool is_empty();
+};
+
+// A flat map from fully qualified names, such as "a::b::c", to what they
+// name, so that looking up a name doesn't have to go through each module on
+// the way. Members of unnamed modules are named as if they were members of
+// the enclosing module. The map belongs to a module_index, which keeps it up
+// to date as things are added to it and taken out, however deep down.
+class qualified_index {
+	std::unordered_map<std::string, qualified_entry> entries;
+public:
+	// starts with everything already in the index
+	qualified_index(index* dictionary);
+	// returns nullptr if nothing has this fully qualified name
+	qualified_entry* lookup(const std::string& qualified_name);
+	// looks a name up as it would be seen from inside the module with the
+	// given qualified name (the empty string being the top level). The
+	// enclosing modules are tried one at a time, innermost first, so for the
+	// scope "a::b" the name "c" is looked up as "a::b::c", then "a::c", then
+	// "c". Returns nullptr if none of them exist
+	qualified_entry* resolve(const std::string& scope, const std::string& name);
+	// the same, adding each qualified name it tries to the list, up to and
+	// including the one it finds
+	qualified_entry* resolve(const std::string& scope, const std::string& name,
+			std::vector<std::string>* tried);
+	int get_entry_count();
+	// these are for the module_index. The path is the qualified name of the
+	// module which the module, field or function is in. Adding or removing a
+	// module adds or removes everything in it too
+	void add_module(const std::string& path, module_index* module);
+	void add_field(const std::string& path, field_index* field);
+	void add_function(const std::string& path, function_index* function);
+	void remove_module(const std::string& path, module_index* module);
+	void remove_field(const std::string& path, field_index* field);
+	void remove_function(const std::string& path, function_index* function);
+private:
+	// creates the entry if it doesn't exist yet
+	qualified_entry& get_entry(const std::string& qualified_name);
+	// takes an entry out once nothing has its name
+	void remove_if_empty(const std::string& qualified_name);
+};
+
+std::string qualify(const std::string& scope, const std::string& name);
+
+// gets the name an identifier, call or namespace expression refers to,
+// joining the parts of a namespace expression with ::. Returns false for any
+// other kind of expression
+bool get_referenced_name(ast::expression* expr, std::string& name);
+
+}
+
+#endif /* QUALIFIED_INDEX_HPP_ */
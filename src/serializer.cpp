@@ -0,0 +1,761 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include "serializer.hpp"
+
+// written in place of an optional child which isn't there
+const std::uint8_t NULL_TAG = 0xff;
+
+serializer::serializer_exception::serializer_exception(
+		const char* description) :
+		description(description) {
+}
+const char* serializer::serializer_exception::what() {
+	return description;
+}
+
+serializer::binary_writer::binary_writer(std::ostream& out) :
+		out(out) {
+}
+void serializer::binary_writer::write_byte(std::uint8_t value) {
+	out.put(static_cast<char>(value));
+}
+void serializer::binary_writer::write_int(std::int32_t value) {
+	std::uint32_t bits = static_cast<std::uint32_t>(value);
+	for (int i = 0; i < 4; i++) {
+		write_byte(bits >> (i * 8));
+	}
+}
+void serializer::binary_writer::write_long(std::int64_t value) {
+	std::uint64_t bits = static_cast<std::uint64_t>(value);
+	for (int i = 0; i < 8; i++) {
+		write_byte(bits >> (i * 8));
+	}
+}
+void serializer::binary_writer::write_float(float value) {
+	std::int32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	write_int(bits);
+}
+void serializer::binary_writer::write_double(double value) {
+	std::int64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	write_long(bits);
+}
+void serializer::binary_writer::write_string(const std::string& value) {
+	write_int(value.size());
+	out.write(value.data(), value.size());
+}
+void serializer::binary_writer::write_varint(std::uint64_t value) {
+	while (value >= 0x80) {
+		write_byte((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	write_byte(value);
+}
+
+serializer::binary_reader::binary_reader(std::istream& in) :
+		in(in), remaining(std::numeric_limits<std::int64_t>::max()) {
+	std::istream::pos_type start = in.tellg();
+	if (start == std::istream::pos_type(-1)) {
+		return;
+	}
+	in.seekg(0, std::ios::end);
+	std::istream::pos_type end = in.tellg();
+	in.seekg(start);
+	if (end != std::istream::pos_type(-1)) {
+		remaining = end - start;
+	}
+}
+std::uint8_t serializer::binary_reader::read_byte() {
+	int value = in.get();
+	if (value == std::istream::traits_type::eof()) {
+		throw serializer::serializer_exception("Unexpected end of input");
+	}
+	remaining--;
+	return static_cast<std::uint8_t>(value);
+}
+std::int32_t serializer::binary_reader::read_int() {
+	std::uint32_t bits = 0;
+	for (int i = 0; i < 4; i++) {
+		bits |= static_cast<std::uint32_t>(read_byte()) << (i * 8);
+	}
+	return static_cast<std::int32_t>(bits);
+}
+std::int64_t serializer::binary_reader::read_long() {
+	std::uint64_t bits = 0;
+	for (int i = 0; i < 8; i++) {
+		bits |= static_cast<std::uint64_t>(read_byte()) << (i * 8);
+	}
+	return static_cast<std::int64_t>(bits);
+}
+float serializer::binary_reader::read_float() {
+	std::int32_t bits = read_int();
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+double serializer::binary_reader::read_double() {
+	std::int64_t bits = read_long();
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+std::string serializer::binary_reader::read_string() {
+	int size = read_count();
+	std::string value(size, '\0');
+	in.read(&value[0], size);
+	if (in.gcount() != size) {
+		throw serializer::serializer_exception("Unexpected end of input");
+	}
+	remaining -= size;
+	return value;
+}
+std::uint64_t serializer::binary_reader::read_varint() {
+	std::uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		std::uint8_t b = read_byte();
+		value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			return value;
+		}
+	}
+	throw serializer::serializer_exception("Varint too long");
+}
+int serializer::binary_reader::read_count() {
+	std::int32_t count = read_int();
+	if (count < 0) {
+		throw serializer::serializer_exception("Negative count");
+	}
+	// checked before anything is allocated for them, so a broken count
+	// can't make a huge allocation
+	if (count > remaining) {
+		throw serializer::serializer_exception("Count is past the end of input");
+	}
+	return count;
+}
+
+void serializer::write_tokens(serializer::binary_writer& writer,
+		std::vector<tokenizer::token>& tokens) {
+	writer.write_int(tokens.size());
+	std::int64_t last_pos = 0;
+	for (tokenizer::token& tok : tokens) {
+		writer.write_byte(static_cast<std::uint8_t>(tok.kind));
+		writer.write_string(tok.text);
+		// tokens are in order, so this is only negative in a broken file,
+		// where it wraps around and back again when it's read
+		writer.write_varint(static_cast<std::uint64_t>(tok.pos - last_pos));
+		last_pos = tok.pos;
+	}
+}
+void serializer::read_tokens(serializer::binary_reader& reader,
+		std::vector<tokenizer::token>& tokens) {
+	std::uint64_t last_pos = 0;
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		tokenizer::token tok;
+		std::uint8_t kind = reader.read_byte();
+		if (kind > static_cast<std::uint8_t>(tokenizer::token_kind::END_OF_FILE)) {
+			throw serializer::serializer_exception("Unknown token kind");
+		}
+		tok.kind = static_cast<tokenizer::token_kind>(kind);
+		tok.text = reader.read_string();
+		last_pos += reader.read_varint();
+		tok.pos = static_cast<std::int64_t>(last_pos);
+		tokens.push_back(tok);
+	}
+}
+
+void serializer::write_line_breaks(serializer::binary_writer& writer,
+		std::vector<std::int64_t>& line_breaks) {
+	writer.write_int(line_breaks.size());
+	std::int64_t last_line_break = 0;
+	for (std::int64_t line_break : line_breaks) {
+		writer.write_varint(
+				static_cast<std::uint64_t>(line_break - last_line_break));
+		last_line_break = line_break;
+	}
+}
+void serializer::read_line_breaks(serializer::binary_reader& reader,
+		std::vector<std::int64_t>& line_breaks) {
+	std::uint64_t last_line_break = 0;
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		last_line_break += reader.read_varint();
+		line_breaks.push_back(static_cast<std::int64_t>(last_line_break));
+	}
+}
+
+void serializer::write_type(serializer::binary_writer& writer,
+		ast::type_ref& type) {
+	writer.write_int(type.get_namespaces()->size());
+	for (std::string& ns : *type.get_namespaces()) {
+		writer.write_string(ns);
+	}
+	writer.write_string(type.get_type_name());
+	writer.write_int(type.get_generic_args()->size());
+	for (ast::type_ref& generic_arg : *type.get_generic_args()) {
+		write_type(writer, generic_arg);
+	}
+}
+ast::type_ref serializer::read_type(serializer::binary_reader& reader) {
+	// owned here until the type_ref takes them, in case a read throws
+	std::unique_ptr<std::vector<std::string>> namespaces(
+			new std::vector<std::string>);
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		namespaces->push_back(reader.read_string());
+	}
+	std::string type_name = reader.read_string();
+	std::unique_ptr<std::vector<ast::type_ref>> generic_args(
+			new std::vector<ast::type_ref>);
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		generic_args->push_back(read_type(reader));
+	}
+	return ast::type_ref(namespaces.release(), type_name,
+			generic_args.release());
+}
+
+void write_modifiers(serializer::binary_writer& writer,
+		std::set<ast::modifier>* modifiers) {
+	writer.write_int(modifiers->size());
+	for (ast::modifier mod : *modifiers) {
+		writer.write_byte(static_cast<std::uint8_t>(mod));
+	}
+}
+std::set<ast::modifier>* read_modifiers(serializer::binary_reader& reader) {
+	std::unique_ptr<std::set<ast::modifier>> modifiers(
+			new std::set<ast::modifier>);
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		std::uint8_t mod = reader.read_byte();
+		if (mod > static_cast<std::uint8_t>(ast::modifier::GLOBAL)) {
+			throw serializer::serializer_exception("Unknown modifier");
+		}
+		modifiers->insert(static_cast<ast::modifier>(mod));
+	}
+	return modifiers.release();
+}
+
+void write_expressions(serializer::binary_writer& writer,
+		std::vector<ast::expression*>* exprs) {
+	writer.write_int(exprs->size());
+	for (ast::expression* expr : *exprs) {
+		serializer::write_expression(writer, expr);
+	}
+}
+// deletes what has been read so far, if reading the rest of it throws
+template<typename T>
+void delete_list(std::vector<T*>* list) {
+	for (T* element : *list) {
+		delete element;
+	}
+	delete list;
+}
+
+std::vector<ast::expression*>* read_expressions(
+		serializer::binary_reader& reader) {
+	std::vector<ast::expression*>* exprs = new std::vector<ast::expression*>;
+	try {
+		for (int i = 0, e = reader.read_count(); i < e; i++) {
+			exprs->push_back(serializer::read_expression(reader));
+		}
+	} catch (serializer::serializer_exception& e) {
+		delete_list(exprs);
+		throw;
+	}
+	return exprs;
+}
+
+void serializer::write_expression(serializer::binary_writer& writer,
+		ast::expression* expr) {
+	if (expr == nullptr) {
+		writer.write_byte(NULL_TAG);
+		return;
+	}
+	writer.write_byte(static_cast<std::uint8_t>(expr->get_expression_kind()));
+	switch (expr->get_expression_kind()) {
+	case ast::expression_kind::IDENTIFIER:
+		writer.write_string(
+				static_cast<ast::identifier_expression*>(expr)->get_identifier());
+		break;
+	case ast::expression_kind::PARENTHESIZED:
+		write_expression(writer,
+				static_cast<ast::parenthesized_expression*>(expr)->get_child());
+		break;
+	case ast::expression_kind::CALL: {
+		ast::call_expression* call = static_cast<ast::call_expression*>(expr);
+		writer.write_string(call->get_name());
+		write_expressions(writer, call->get_operands());
+		break;
+	}
+	case ast::expression_kind::NAMESPACE: {
+		ast::namespace_expression* ns =
+				static_cast<ast::namespace_expression*>(expr);
+		writer.write_string(ns->get_namespace());
+		write_expression(writer, ns->get_operand());
+		break;
+	}
+	case ast::expression_kind::OPERATOR: {
+		ast::operator_expression* op =
+				static_cast<ast::operator_expression*>(expr);
+		write_expression(writer, op->get_lhs());
+		writer.write_string(op->get_operator());
+		write_expression(writer, op->get_rhs());
+		break;
+	}
+	case ast::expression_kind::UNARY_OPERATOR_LEFT: {
+		ast::unary_operator_left_expression* op =
+				static_cast<ast::unary_operator_left_expression*>(expr);
+		writer.write_string(op->get_operator());
+		write_expression(writer, op->get_operand());
+		break;
+	}
+	case ast::expression_kind::UNARY_OPERATOR_RIGHT: {
+		ast::unary_operator_right_expression* op =
+				static_cast<ast::unary_operator_right_expression*>(expr);
+		write_expression(writer, op->get_operand());
+		writer.write_string(op->get_operator());
+		break;
+	}
+	case ast::expression_kind::CONST_BOOLEAN:
+		writer.write_byte(
+				static_cast<ast::const_boolean_expression*>(expr)->get_value());
+		break;
+	case ast::expression_kind::CONST_INTEGER: {
+		ast::const_integer_expression* integer =
+				static_cast<ast::const_integer_expression*>(expr);
+		writer.write_int(integer->get_value());
+		writer.write_byte(static_cast<std::uint8_t>(integer->get_radix()));
+		break;
+	}
+	case ast::expression_kind::CONST_FLOAT:
+		writer.write_float(
+				static_cast<ast::const_float_expression*>(expr)->get_value());
+		break;
+	case ast::expression_kind::CONST_DOUBLE:
+		writer.write_double(
+				static_cast<ast::const_double_expression*>(expr)->get_value());
+		break;
+	case ast::expression_kind::CONST_STRING:
+		writer.write_string(
+				static_cast<ast::const_string_expression*>(expr)->get_value());
+		break;
+	case ast::expression_kind::CAST: {
+		ast::cast_expression* cast = static_cast<ast::cast_expression*>(expr);
+		ast::type_ref target_type = cast->get_target_type();
+		write_type(writer, target_type);
+		write_expression(writer, cast->get_operand());
+		break;
+	}
+	case ast::expression_kind::ARRAY: {
+		ast::array_expression* array = static_cast<ast::array_expression*>(expr);
+		write_expression(writer, array->get_target());
+		write_expressions(writer, array->get_indices());
+		break;
+	}
+	}
+}
+ast::expression* serializer::read_expression(
+		serializer::binary_reader& reader) {
+	std::uint8_t kind = reader.read_byte();
+	if (kind == NULL_TAG) {
+		return nullptr;
+	}
+	switch (static_cast<ast::expression_kind>(kind)) {
+	case ast::expression_kind::IDENTIFIER:
+		return new ast::identifier_expression(reader.read_string());
+	case ast::expression_kind::PARENTHESIZED:
+		return new ast::parenthesized_expression(read_expression(reader));
+	case ast::expression_kind::CALL: {
+		std::string name = reader.read_string();
+		return new ast::call_expression(name, read_expressions(reader));
+	}
+	case ast::expression_kind::NAMESPACE: {
+		std::string namespace_name = reader.read_string();
+		return new ast::namespace_expression(namespace_name,
+				read_expression(reader));
+	}
+	case ast::expression_kind::OPERATOR: {
+		std::unique_ptr<ast::expression> lhs(read_expression(reader));
+		std::string operator_name = reader.read_string();
+		ast::expression* rhs = read_expression(reader);
+		return new ast::operator_expression(lhs.release(), operator_name, rhs);
+	}
+	case ast::expression_kind::UNARY_OPERATOR_LEFT: {
+		std::string operator_name = reader.read_string();
+		return new ast::unary_operator_left_expression(operator_name,
+				read_expression(reader));
+	}
+	case ast::expression_kind::UNARY_OPERATOR_RIGHT: {
+		std::unique_ptr<ast::expression> operand(read_expression(reader));
+		std::string operator_name = reader.read_string();
+		return new ast::unary_operator_right_expression(operand.release(),
+				operator_name);
+	}
+	case ast::expression_kind::CONST_BOOLEAN:
+		return new ast::const_boolean_expression(reader.read_byte() != 0);
+	case ast::expression_kind::CONST_INTEGER: {
+		int value = reader.read_int();
+		std::uint8_t rad = reader.read_byte();
+		if (rad > static_cast<std::uint8_t>(ast::radix::HEX)) {
+			throw serializer::serializer_exception("Unknown radix");
+		}
+		return new ast::const_integer_expression(value,
+				static_cast<ast::radix>(rad));
+	}
+	case ast::expression_kind::CONST_FLOAT:
+		return new ast::const_float_expression(reader.read_float());
+	case ast::expression_kind::CONST_DOUBLE:
+		return new ast::const_double_expression(reader.read_double());
+	case ast::expression_kind::CONST_STRING:
+		return new ast::const_string_expression(reader.read_string());
+	case ast::expression_kind::CAST: {
+		ast::type_ref target_type = read_type(reader);
+		return new ast::cast_expression(target_type, read_expression(reader));
+	}
+	case ast::expression_kind::ARRAY: {
+		std::unique_ptr<ast::expression> target(read_expression(reader));
+		std::vector<ast::expression*>* indexes = read_expressions(reader);
+		return new ast::array_expression(target.release(), indexes);
+	}
+	default:
+		throw serializer::serializer_exception("Unknown expression kind");
+	}
+}
+
+void serializer::write_statement(serializer::binary_writer& writer,
+		ast::statement* stmt) {
+	if (stmt == nullptr) {
+		writer.write_byte(NULL_TAG);
+		return;
+	}
+	writer.write_byte(static_cast<std::uint8_t>(stmt->get_statement_kind()));
+	switch (stmt->get_statement_kind()) {
+	case ast::statement_kind::BLOCK: {
+		std::vector<ast::statement*>* children =
+				static_cast<ast::block_statement*>(stmt)->get_children();
+		writer.write_int(children->size());
+		for (ast::statement* child : *children) {
+			write_statement(writer, child);
+		}
+		break;
+	}
+	case ast::statement_kind::VARIABLE_DECLARATION: {
+		ast::variable_declaration_statement* var =
+				static_cast<ast::variable_declaration_statement*>(stmt);
+		write_modifiers(writer, var->get_modifiers());
+		ast::type_ref type = var->get_type();
+		write_type(writer, type);
+		writer.write_string(var->get_name());
+		write_expression(writer, var->get_initialization_expression());
+		break;
+	}
+	case ast::statement_kind::ASSIGNMENT: {
+		ast::assignment_statement* assignment =
+				static_cast<ast::assignment_statement*>(stmt);
+		write_expression(writer, assignment->get_lhs());
+		writer.write_string(assignment->get_assignment_operator());
+		write_expression(writer, assignment->get_rhs());
+		break;
+	}
+	case ast::statement_kind::IF: {
+		ast::if_statement* if_stmt = static_cast<ast::if_statement*>(stmt);
+		write_expression(writer, if_stmt->get_condition());
+		write_statement(writer, if_stmt->get_if_clause());
+		write_statement(writer, if_stmt->get_else_clause());
+		break;
+	}
+	case ast::statement_kind::WHILE: {
+		ast::while_statement* while_stmt =
+				static_cast<ast::while_statement*>(stmt);
+		write_expression(writer, while_stmt->get_condition());
+		write_statement(writer, while_stmt->get_while_clause());
+		break;
+	}
+	case ast::statement_kind::DO_WHILE: {
+		ast::do_while_statement* do_while_stmt =
+				static_cast<ast::do_while_statement*>(stmt);
+		write_statement(writer, do_while_stmt->get_do_while_clause());
+		write_expression(writer, do_while_stmt->get_condition());
+		break;
+	}
+	case ast::statement_kind::FOR: {
+		ast::for_statement* for_stmt = static_cast<ast::for_statement*>(stmt);
+		write_statement(writer, for_stmt->get_initializer());
+		write_expression(writer, for_stmt->get_condition());
+		write_statement(writer, for_stmt->get_increment());
+		write_statement(writer, for_stmt->get_for_clause());
+		break;
+	}
+	case ast::statement_kind::FOREVER:
+		write_statement(writer,
+				static_cast<ast::forever_statement*>(stmt)->get_forever_clause());
+		break;
+	case ast::statement_kind::REPEAT: {
+		ast::repeat_statement* repeat_stmt =
+				static_cast<ast::repeat_statement*>(stmt);
+		write_expression(writer, repeat_stmt->get_times());
+		write_statement(writer, repeat_stmt->get_repeat_clause());
+		break;
+	}
+	case ast::statement_kind::RETURN:
+		write_expression(writer,
+				static_cast<ast::return_statement*>(stmt)->get_operand());
+		break;
+	case ast::statement_kind::EXPRESSION:
+		write_expression(writer,
+				static_cast<ast::expression_statement*>(stmt)->get_expression());
+		break;
+	}
+}
+ast::statement* serializer::read_statement(serializer::binary_reader& reader) {
+	std::uint8_t kind = reader.read_byte();
+	if (kind == NULL_TAG) {
+		return nullptr;
+	}
+	switch (static_cast<ast::statement_kind>(kind)) {
+	case ast::statement_kind::BLOCK: {
+		std::vector<ast::statement*>* children =
+				new std::vector<ast::statement*>;
+		try {
+			for (int i = 0, e = reader.read_count(); i < e; i++) {
+				children->push_back(read_statement(reader));
+			}
+		} catch (serializer::serializer_exception& e) {
+			delete_list(children);
+			throw;
+		}
+		return new ast::block_statement(children);
+	}
+	case ast::statement_kind::VARIABLE_DECLARATION: {
+		std::unique_ptr<std::set<ast::modifier>> modifiers(
+				read_modifiers(reader));
+		ast::type_ref type = read_type(reader);
+		std::string name = reader.read_string();
+		ast::expression* value = read_expression(reader);
+		return new ast::variable_declaration_statement(modifiers.release(),
+				type, name, value);
+	}
+	case ast::statement_kind::ASSIGNMENT: {
+		std::unique_ptr<ast::expression> lhs(read_expression(reader));
+		std::string assignment_operator = reader.read_string();
+		ast::expression* rhs = read_expression(reader);
+		return new ast::assignment_statement(lhs.release(),
+				assignment_operator, rhs);
+	}
+	case ast::statement_kind::IF: {
+		std::unique_ptr<ast::expression> condition(read_expression(reader));
+		std::unique_ptr<ast::statement> if_clause(read_statement(reader));
+		ast::statement* else_clause = read_statement(reader);
+		return new ast::if_statement(condition.release(), if_clause.release(),
+				else_clause);
+	}
+	case ast::statement_kind::WHILE: {
+		std::unique_ptr<ast::expression> condition(read_expression(reader));
+		ast::statement* body = read_statement(reader);
+		return new ast::while_statement(condition.release(), body);
+	}
+	case ast::statement_kind::DO_WHILE: {
+		std::unique_ptr<ast::statement> do_while_clause(read_statement(reader));
+		ast::expression* condition = read_expression(reader);
+		return new ast::do_while_statement(do_while_clause.release(),
+				condition);
+	}
+	case ast::statement_kind::FOR: {
+		std::unique_ptr<ast::statement> initializer(read_statement(reader));
+		std::unique_ptr<ast::expression> condition(read_expression(reader));
+		std::unique_ptr<ast::statement> increment(read_statement(reader));
+		ast::statement* body = read_statement(reader);
+		return new ast::for_statement(initializer.release(),
+				condition.release(), increment.release(), body);
+	}
+	case ast::statement_kind::FOREVER:
+		return new ast::forever_statement(read_statement(reader));
+	case ast::statement_kind::REPEAT: {
+		std::unique_ptr<ast::expression> times(read_expression(reader));
+		ast::statement* body = read_statement(reader);
+		return new ast::repeat_statement(times.release(), body);
+	}
+	case ast::statement_kind::RETURN:
+		return new ast::return_statement(read_expression(reader));
+	case ast::statement_kind::EXPRESSION:
+		return new ast::expression_statement(read_expression(reader));
+	default:
+		throw serializer::serializer_exception("Unknown statement kind");
+	}
+}
+
+void serializer::write_ast_node(serializer::binary_writer& writer,
+		ast::ast_node* node) {
+	writer.write_byte(static_cast<std::uint8_t>(node->get_ast_node_kind()));
+	switch (node->get_ast_node_kind()) {
+	case ast::ast_node_kind::MODULE: {
+		ast::module_node* module = static_cast<ast::module_node*>(node);
+		writer.write_string(module->get_namespace());
+		write_tree(writer, module->get_children());
+		break;
+	}
+	case ast::ast_node_kind::FIELD: {
+		ast::field_node* field = static_cast<ast::field_node*>(node);
+		write_modifiers(writer, field->get_modifiers());
+		ast::type_ref type = field->get_type();
+		write_type(writer, type);
+		writer.write_string(field->get_name());
+		write_expression(writer, field->get_initialization_expression());
+		break;
+	}
+	case ast::ast_node_kind::FUNCTION: {
+		ast::function_node* func = static_cast<ast::function_node*>(node);
+		write_modifiers(writer, func->get_modifiers());
+		ast::type_ref return_type = func->get_return_type();
+		write_type(writer, return_type);
+		writer.write_string(func->get_name());
+		writer.write_int(func->get_parameters()->size());
+		for (ast::field_node* param : *func->get_parameters()) {
+			write_ast_node(writer, param);
+		}
+		write_statement(writer, func->get_body());
+		break;
+	}
+	}
+}
+ast::ast_node* serializer::read_ast_node(serializer::binary_reader& reader) {
+	std::uint8_t kind = reader.read_byte();
+	switch (static_cast<ast::ast_node_kind>(kind)) {
+	case ast::ast_node_kind::MODULE: {
+		std::string namespace_name = reader.read_string();
+		return new ast::module_node(namespace_name, read_tree(reader));
+	}
+	case ast::ast_node_kind::FIELD: {
+		std::unique_ptr<std::set<ast::modifier>> modifiers(
+				read_modifiers(reader));
+		ast::type_ref type = read_type(reader);
+		std::string name = reader.read_string();
+		ast::expression* value = read_expression(reader);
+		return new ast::field_node(modifiers.release(), type, name, value);
+	}
+	case ast::ast_node_kind::FUNCTION: {
+		std::unique_ptr<std::set<ast::modifier>> modifiers(
+				read_modifiers(reader));
+		ast::type_ref return_type = read_type(reader);
+		std::string name = reader.read_string();
+		std::vector<ast::field_node*>* parameters =
+				new std::vector<ast::field_node*>;
+		ast::statement* body;
+		try {
+			for (int i = 0, e = reader.read_count(); i < e; i++) {
+				ast::ast_node* param = read_ast_node(reader);
+				if (!param->is_of_ast_node_kind(ast::ast_node_kind::FIELD)) {
+					delete param;
+					throw serializer::serializer_exception(
+							"Function parameter is not a field");
+				}
+				parameters->push_back(static_cast<ast::field_node*>(param));
+			}
+			body = read_statement(reader);
+		} catch (serializer::serializer_exception& e) {
+			delete_list(parameters);
+			throw;
+		}
+		return new ast::function_node(modifiers.release(), return_type, name,
+				parameters, body);
+	}
+	default:
+		throw serializer::serializer_exception("Unknown AST node kind");
+	}
+}
+
+void serializer::write_tree(serializer::binary_writer& writer,
+		std::vector<ast::ast_node*>* tree) {
+	writer.write_int(tree->size());
+	for (ast::ast_node* node : *tree) {
+		write_ast_node(writer, node);
+	}
+}
+std::vector<ast::ast_node*>* serializer::read_tree(
+		serializer::binary_reader& reader) {
+	std::vector<ast::ast_node*>* tree = new std::vector<ast::ast_node*>;
+	try {
+		for (int i = 0, e = reader.read_count(); i < e; i++) {
+			tree->push_back(read_ast_node(reader));
+		}
+	} catch (serializer::serializer_exception& e) {
+		delete_list(tree);
+		throw;
+	}
+	return tree;
+}
+
+void serializer::write_index(serializer::binary_writer& writer,
+		indexer::module_index* idx) {
+	writer.write_byte(idx->has_name());
+	writer.write_string(idx->get_name());
+	writer.write_int(idx->get_modules()->size());
+	for (indexer::module_index* submodule : *idx->get_modules()) {
+		write_index(writer, submodule);
+	}
+	writer.write_int(idx->get_fields()->size());
+	for (indexer::field_index* field : *idx->get_fields()) {
+		writer.write_byte(field->is_global());
+		writer.write_string(field->get_name());
+		ast::type_ref type = field->get_type();
+		write_type(writer, type);
+	}
+	writer.write_int(idx->get_functions()->size());
+	for (indexer::function_index* function : *idx->get_functions()) {
+		writer.write_byte(function->is_global());
+		writer.write_string(function->get_name());
+		ast::type_ref return_type = function->get_return_type();
+		write_type(writer, return_type);
+		writer.write_int(function->get_parameter_types()->size());
+		for (ast::type_ref& type : *function->get_parameter_types()) {
+			write_type(writer, type);
+		}
+	}
+}
+indexer::module_index* serializer::read_index(
+		serializer::binary_reader& reader) {
+	bool has_name = reader.read_byte() != 0;
+	std::string name = reader.read_string();
+	// owns the index until it's complete, so nested reads which throw don't
+	// leak it
+	std::unique_ptr<indexer::module_index> idx(
+			has_name ?
+					new indexer::module_index(name) : new indexer::module_index);
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		indexer::module_index* module = read_index(reader);
+		if (!idx->add_module(module)) {
+			delete module;
+			throw serializer::serializer_exception("Duplicate namespace in index");
+		}
+	}
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		bool global = reader.read_byte() != 0;
+		std::string field_name = reader.read_string();
+		ast::type_ref type = read_type(reader);
+		indexer::field_index* field = new indexer::field_index(global,
+				field_name, type);
+		if (!idx->add_field(field)) {
+			delete field;
+			throw serializer::serializer_exception("Duplicate field in index");
+		}
+	}
+	for (int i = 0, e = reader.read_count(); i < e; i++) {
+		bool global = reader.read_byte() != 0;
+		std::string function_name = reader.read_string();
+		ast::type_ref return_type = read_type(reader);
+		std::unique_ptr<std::vector<ast::type_ref>> parameter_types(
+				new std::vector<ast::type_ref>);
+		for (int j = 0, f = reader.read_count(); j < f; j++) {
+			parameter_types->push_back(read_type(reader));
+		}
+		indexer::function_index* function = new indexer::function_index(global,
+				function_name, return_type, parameter_types.release());
+		if (!idx->add_function(function)) {
+			delete function;
+			throw serializer::serializer_exception("Duplicate function in index");
+		}
+	}
+	return idx.release();
+}
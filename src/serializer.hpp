@@ -0,0 +1,91 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef SERIALIZER_HPP_
+#define SERIALIZER_HPP_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "crosslang_ast.hpp"
+#include "indexer.hpp"
+#include "tokenizer.hpp"
+
+namespace serializer {
+
+class serializer_exception: public std::exception {
+	const char* description;
+public:
+	serializer_exception(const char* description);
+	const char* what();
+};
+
+// Writes values in a fixed little-endian layout, so that what's written on
+// one machine can be read on any other
+class binary_writer {
+	std::ostream& out;
+public:
+	binary_writer(std::ostream& out);
+	void write_byte(std::uint8_t value);
+	void write_int(std::int32_t value);
+	void write_long(std::int64_t value);
+	void write_float(float value);
+	void write_double(double value);
+	void write_string(const std::string& value);
+	// 7 bits to a byte, so small values take less space
+	void write_varint(std::uint64_t value);
+};
+
+// Reads values written by a binary_writer. Throws a serializer_exception if
+// the input ends early or is otherwise not what was expected
+class binary_reader {
+	std::istream& in;
+	// how many bytes are left in the input, if it can be found out
+	std::int64_t remaining;
+public:
+	binary_reader(std::istream& in);
+	std::uint8_t read_byte();
+	std::int32_t read_int();
+	std::int64_t read_long();
+	float read_float();
+	double read_double();
+	std::string read_string();
+	std::uint64_t read_varint();
+	// reads a count of things which follow, checking that it's sane. Each
+	// thing takes at least a byte, so there can't be more than are left
+	int read_count();
+};
+
+void write_tokens(binary_writer& writer, std::vector<tokenizer::token>& tokens);
+void read_tokens(binary_reader& reader, std::vector<tokenizer::token>& tokens);
+
+// positions are written as the distance from the one before, which is
+// usually small, rather than in full
+void write_line_breaks(binary_writer& writer,
+		std::vector<std::int64_t>& line_breaks);
+void read_line_breaks(binary_reader& reader,
+		std::vector<std::int64_t>& line_breaks);
+
+void write_type(binary_writer& writer, ast::type_ref& type);
+ast::type_ref read_type(binary_reader& reader);
+
+// any of these may be nullptr, where a node has an optional child
+void write_expression(binary_writer& writer, ast::expression* expr);
+ast::expression* read_expression(binary_reader& reader);
+void write_statement(binary_writer& writer, ast::statement* stmt);
+ast::statement* read_statement(binary_reader& reader);
+void write_ast_node(binary_writer& writer, ast::ast_node* node);
+ast::ast_node* read_ast_node(binary_reader& reader);
+
+void write_tree(binary_writer& writer, std::vector<ast::ast_node*>* tree);
+std::vector<ast::ast_node*>* read_tree(binary_reader& reader);
+
+void write_index(binary_writer& writer, indexer::module_index* idx);
+indexer::module_index* read_index(binary_reader& reader);
+
+}
+
+#endif /* SERIALIZER_HPP_ */
@@ -0,0 +1,131 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include "thread_pool.hpp"
+
+concurrency::thread_pool::thread_pool(int thread_count) {
+	if (thread_count <= 0) {
+		thread_count = std::thread::hardware_concurrency();
+		if (thread_count <= 0) {
+			thread_count = 1;
+		}
+	}
+	for (int i = 0; i < thread_count; i++) {
+		queues.push_back(new worker_queue);
+	}
+	// worker 0 is whoever calls run_all()
+	for (int i = 1; i < thread_count; i++) {
+		threads.push_back(std::thread(&thread_pool::worker_loop, this, i));
+	}
+}
+concurrency::thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> guard(batch_lock);
+		stopping = true;
+	}
+	batch_started.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	for (worker_queue* queue : queues) {
+		delete queue;
+	}
+}
+int concurrency::thread_pool::get_thread_count() {
+	return queues.size();
+}
+void concurrency::thread_pool::run_all(
+		std::vector<std::function<void(int)>>* tasks) {
+	int task_count = tasks->size();
+	int worker_count = queues.size();
+	// give each worker a contiguous run of tasks to start with, so that
+	// neighbouring tasks tend to run on the same thread
+	for (int worker = 0; worker < worker_count; worker++) {
+		int begin = static_cast<long long>(task_count) * worker / worker_count;
+		int end = static_cast<long long>(task_count) * (worker + 1)
+				/ worker_count;
+		std::lock_guard<std::mutex> guard(queues[worker]->lock);
+		for (int task = begin; task < end; task++) {
+			queues[worker]->tasks.push_back(task);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> guard(batch_lock);
+		batch = tasks;
+		errors.assign(task_count, std::exception_ptr());
+		running_workers = threads.size();
+		batch_number++;
+	}
+	batch_started.notify_all();
+	run_tasks(0);
+	{
+		std::unique_lock<std::mutex> guard(batch_lock);
+		while (running_workers != 0) {
+			batch_finished.wait(guard);
+		}
+		batch = nullptr;
+	}
+	for (std::exception_ptr& error : errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
+void concurrency::thread_pool::worker_loop(int worker) {
+	int last_batch_number = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(batch_lock);
+			while (!stopping && batch_number == last_batch_number) {
+				batch_started.wait(guard);
+			}
+			if (stopping) {
+				return;
+			}
+			last_batch_number = batch_number;
+		}
+		run_tasks(worker);
+		{
+			std::lock_guard<std::mutex> guard(batch_lock);
+			running_workers--;
+			if (running_workers == 0) {
+				batch_finished.notify_all();
+			}
+		}
+	}
+}
+void concurrency::thread_pool::run_tasks(int worker) {
+	int task;
+	while (take_task(worker, task)) {
+		try {
+			(*batch)[task](worker);
+		} catch (...) {
+			errors[task] = std::current_exception();
+		}
+	}
+}
+bool concurrency::thread_pool::take_task(int worker, int& task) {
+	{
+		worker_queue* own = queues[worker];
+		std::lock_guard<std::mutex> guard(own->lock);
+		if (!own->tasks.empty()) {
+			task = own->tasks.front();
+			own->tasks.pop_front();
+			return true;
+		}
+	}
+	// nothing left of our own, so steal from the back of someone else's
+	for (int i = 1, e = queues.size(); i < e; i++) {
+		worker_queue* victim = queues[(worker + i) % e];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		if (!victim->tasks.empty()) {
+			task = victim->tasks.back();
+			victim->tasks.pop_back();
+			return true;
+		}
+	}
+	// every task is queued before the batch starts, so once all the queues
+	// are empty there's nothing more to do
+	return false;
+}
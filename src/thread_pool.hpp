@@ -0,0 +1,54 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace concurrency {
+
+// A fixed set of worker threads which run batches of tasks. Each worker has
+// its own queue of tasks, and steals from the back of the others' queues
+// once its own is empty. The thread calling run_all() acts as worker 0, so a
+// pool of 1 thread runs everything on the calling thread.
+class thread_pool {
+	struct worker_queue {
+		std::mutex lock;
+		std::deque<int> tasks;
+	};
+	std::vector<std::thread> threads;
+	std::vector<worker_queue*> queues;
+	std::mutex batch_lock;
+	std::condition_variable batch_started;
+	std::condition_variable batch_finished;
+	std::vector<std::function<void(int)>>* batch = nullptr;
+	std::vector<std::exception_ptr> errors;
+	int batch_number = 0;
+	int running_workers = 0;
+	bool stopping = false;
+public:
+	// a thread_count of 0 or less means one thread per core
+	thread_pool(int thread_count);
+	~thread_pool();
+	int get_thread_count();
+	// runs every task and returns once they've all finished. Each task is
+	// given the index of the worker running it. If any tasks throw, the
+	// exception from the first such task in the list is rethrown
+	void run_all(std::vector<std::function<void(int)>>* tasks);
+private:
+	void worker_loop(int worker);
+	void run_tasks(int worker);
+	bool take_task(int worker, int& task);
+};
+
+}
+
+#endif /* THREAD_POOL_HPP_ */
@@ -2,39 +2,36 @@
  *      Author: Earthcomputer
  */
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
+#include "lookup_table.hpp"
 #include "tokenizer.hpp"
 
-tokenizer::tokenizer_exception::tokenizer_exception(const char* what, int pos) :
-		description(what), pos(pos) {
-}
-tokenizer::tokenizer_exception::~tokenizer_exception() throw () {
-	delete description;
-}
-const char* tokenizer::tokenizer_exception::what() {
-	return description;
-}
-int tokenizer::tokenizer_exception::get_pos() {
-	return pos;
-}
-
-std::string multichar_operators[] = { ">>", "<<", "+=", "-=", "*=", "/=", "%=",
-		"&=", "|=", "^=", ">>=", "<<=", "&&", "||", "^^", "==", "!=", ">=",
-		"<=", "++", "--", "->", "::" };
+// sorted, so that it can be binary searched
+constexpr const char* multichar_operators[] = { "!=", "%=", "&&", "&=", "*=",
+		"++", "+=", "--", "-=", "->", "/=", "::", "<<", "<<=", "<=", "==", ">=",
+		">>", ">>=", "^=", "^^", "|=", "||" };
+static_assert(lookup::is_sorted(multichar_operators),
+		"multichar_operators must be sorted");
 
-void tokenizer::tokenize(std::string in, std::vector<tokenizer::token>& tokens,
-		std::vector<int>& line_breaks) {
-	bool in_token = false;
-	bool in_singleline_comment = false;
-	bool in_multiline_comment = false;
-	bool is_escaped = false;
-	char last_char = -1;
-	tokenizer::token current_token;
-	int pos = 0;
+void tokenizer::stream_tokenizer::feed(const char* text, std::size_t size,
+		std::vector<tokenizer::token>& tokens,
+		std::vector<std::int64_t>& line_breaks,
+		diagnostics::diagnostic_buffer* diags) {
+	// the state is kept in locals while the text is walked, so that it can
+	// stay in registers
+	bool failed = this->failed;
+	bool in_token = this->in_token;
+	bool in_singleline_comment = this->in_singleline_comment;
+	bool in_multiline_comment = this->in_multiline_comment;
+	bool is_escaped = this->is_escaped;
+	char last_char = this->last_char;
+	std::int64_t pos = this->pos;
 
-	for (const auto& c : in) {
+	for (const char* end = text + size; text != end; ++text) {
+		const char c = *text;
 		// check for newline and do newline stuff
 		if (c == '\n') {
 			// add line number index to list
@@ -85,33 +82,21 @@ void tokenizer::tokenize(std::string in, std::vector<tokenizer::token>& tokens,
 			case tokenizer::token_kind::OPERATOR: {
 				// check if a multichar operator could include this char
 				std::string potential_token_text = current_token.text + c;
-				bool could_be_multichar = false;
-				for (const auto& multichar_operator : multichar_operators) {
-					if (!multichar_operator.compare(0,
-							potential_token_text.length(),
-							potential_token_text)) {
-						could_be_multichar = true;
-						break;
-					}
-				}
-				if (could_be_multichar) {
+				if (lookup::contains_prefix(multichar_operators,
+						potential_token_text.c_str())) {
 					current_token.text += c;
 					goto next_iteration;
 				}
 				// check if we've ended on a valid token by checking against the
 				// list of multichar operators
-				if (current_token.text.length() != 1) {
-					could_be_multichar = false;
-					for (const auto& multichar_operator : multichar_operators) {
-						if (multichar_operator == current_token.text) {
-							could_be_multichar = true;
-							break;
-						}
-					}
-					if (!could_be_multichar) {
-						throw tokenizer::tokenizer_exception(
-								"Unable to parse multichar operator", pos);
-					}
+				// the token is kept as it is, so that the rest of the file
+				// can still be checked
+				if (current_token.text.length() != 1
+						&& !lookup::contains(multichar_operators,
+								current_token.text.c_str())) {
+					diags->report(diagnostics::stage::TOKENIZE,
+							"Unable to parse multichar operator", pos);
+					failed = true;
 				}
 				break;
 			}
@@ -143,9 +128,11 @@ void tokenizer::tokenize(std::string in, std::vector<tokenizer::token>& tokens,
 				goto next_iteration;
 			}
 			case tokenizer::token_kind::END_OF_FILE:
-				throw tokenizer::tokenizer_exception(
+				diags->report(diagnostics::stage::TOKENIZE,
 						"A token's kind should never be EOF!",
 						current_token.pos);
+				failed = true;
+				break;
 			}
 			// do end-of-token stuff
 			tokens.push_back(current_token);
@@ -208,37 +195,54 @@ void tokenizer::tokenize(std::string in, std::vector<tokenizer::token>& tokens,
 		next_iteration: last_char = c;
 		pos++;
 	}
+
+	this->failed = failed;
+	this->in_token = in_token;
+	this->in_singleline_comment = in_singleline_comment;
+	this->in_multiline_comment = in_multiline_comment;
+	this->is_escaped = is_escaped;
+	this->last_char = last_char;
+	this->pos = pos;
+}
+
+bool tokenizer::stream_tokenizer::finish(std::vector<tokenizer::token>& tokens,
+		diagnostics::diagnostic_buffer* diags) {
 	// check end of file stuff
 	if (in_multiline_comment) {
-		throw tokenizer::tokenizer_exception(
+		diags->report(diagnostics::stage::TOKENIZE,
 				"Reached the end of the file before the end of a multiline comment",
 				pos);
+		failed = true;
 	}
 	if (in_token) {
 		tokenizer::token_kind kind = current_token.kind;
 		if (kind == tokenizer::token_kind::SINGLE_QUOTED_STRING
 				|| kind == tokenizer::token_kind::DOUBLE_QUOTED_STRING) {
-			throw tokenizer::tokenizer_exception(
+			diags->report(diagnostics::stage::TOKENIZE,
 					"Reached the end of the file before the end of a string",
 					pos);
-		}
-		if (kind == tokenizer::token_kind::OPERATOR
-				&& current_token.text.length() != 1) {
-			bool is_multichar_operator = false;
-			for (const auto& multichar_operator : multichar_operators) {
-				if (current_token.text == multichar_operator) {
-					is_multichar_operator = true;
-					break;
-				}
-			}
-			if (!is_multichar_operator) {
-				throw tokenizer::tokenizer_exception(
-						"Unable to parse multichar operator", pos);
-			}
+			failed = true;
+		} else if (kind == tokenizer::token_kind::OPERATOR
+				&& current_token.text.length() != 1
+				&& !lookup::contains(multichar_operators,
+						current_token.text.c_str())) {
+			diags->report(diagnostics::stage::TOKENIZE,
+					"Unable to parse multichar operator", pos);
+			failed = true;
 		}
 		tokens.push_back(current_token);
 		in_token = false;
 	}
+	return !failed;
+}
+
+bool tokenizer::tokenize(const std::string& in,
+		std::vector<tokenizer::token>& tokens,
+		std::vector<std::int64_t>& line_breaks,
+		diagnostics::diagnostic_buffer* diags) {
+	tokenizer::stream_tokenizer stream;
+	stream.feed(in.data(), in.size(), tokens, line_breaks, diags);
+	return stream.finish(tokens, diags);
 }
 
 std::string tokenizer::read_input_stream(std::istream& in) {
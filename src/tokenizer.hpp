@@ -5,21 +5,14 @@
 #ifndef TOKENIZER_HPP
 #define TOKENIZER_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
+#include "diagnostics.hpp"
 
 namespace tokenizer {
 
-class tokenizer_exception: public std::exception {
-	const char* description;
-	int pos;
-public:
-	tokenizer_exception(const char* what, int pos);
-	~tokenizer_exception() throw ();
-	const char* what();
-	int get_pos();
-};
-
 enum class token_kind {
 	IDENTIFIER,
 	NUMBER,
@@ -32,11 +25,40 @@ enum class token_kind {
 struct token {
 	token_kind kind;
 	std::string text;
-	int pos;
+	// the offset in the file's text, which is 64 bits so that files over
+	// 2GB can be compiled
+	std::int64_t pos;
 };
 
-void tokenize(std::string in, std::vector<token>& tokens,
-		std::vector<int>& line_breaks);
+// returns false if there were any errors, which are added to the
+// diagnostics. Tokenizing carries on after an error where it can, so that
+// every error in the file is found
+bool tokenize(const std::string& in, std::vector<token>& tokens,
+		std::vector<std::int64_t>& line_breaks,
+		diagnostics::diagnostic_buffer* diags);
+
+// tokenizes text which is given a piece at a time, so that the whole text
+// never has to be in memory at once. A token which is split between two
+// pieces comes out with the later one. The tokens and line breaks are only
+// ever added to, so the caller may take them away between pieces
+class stream_tokenizer {
+	bool failed = false;
+	bool in_token = false;
+	bool in_singleline_comment = false;
+	bool in_multiline_comment = false;
+	bool is_escaped = false;
+	char last_char = -1;
+	token current_token;
+	// the offset of the next piece in the whole text
+	std::int64_t pos = 0;
+public:
+	void feed(const char* text, std::size_t size, std::vector<token>& tokens,
+			std::vector<std::int64_t>& line_breaks,
+			diagnostics::diagnostic_buffer* diags);
+	// ends the last token, and returns false if there were any errors
+	bool finish(std::vector<token>& tokens,
+			diagnostics::diagnostic_buffer* diags);
+};
 
 std::string read_input_stream(std::istream& in);
 
@@ -0,0 +1,138 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include "instrumentation.hpp"
+#include "tracing.hpp"
+
+bool tracing::enabled = false;
+
+struct trace_event {
+	const char* name;
+	std::string file;
+	int file_number;
+	double start_micros;
+	double duration_micros;
+};
+
+struct trace_buffer {
+	int thread_id;
+	std::vector<trace_event> events;
+};
+
+std::chrono::steady_clock::time_point trace_start;
+std::ofstream* trace_out = nullptr;
+std::vector<std::string> trace_file_names;
+// the buffers of every thread which has recorded anything. They're kept
+// after their thread has finished, until they're written
+std::mutex buffers_mutex;
+std::vector<trace_buffer*> trace_buffers;
+thread_local trace_buffer* this_thread_buffer = nullptr;
+
+trace_buffer* get_thread_buffer() {
+	if (this_thread_buffer == nullptr) {
+		trace_buffer* buffer = new trace_buffer;
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		buffer->thread_id = trace_buffers.size();
+		trace_buffers.push_back(buffer);
+		this_thread_buffer = buffer;
+	}
+	return this_thread_buffer;
+}
+
+double micros_since_start(std::chrono::steady_clock::time_point time) {
+	return std::chrono::duration<double, std::micro>(time - trace_start).count();
+}
+
+void write_trace_event(std::ostream& out, trace_buffer* buffer,
+		trace_event& event) {
+	out << "{\"name\": \"" << event.name << "\", \"cat\": \"compiler\", "
+			<< "\"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread_id
+			<< ", \"ts\": " << event.start_micros << ", \"dur\": "
+			<< event.duration_micros;
+	if (!event.file.empty()) {
+		out << ", \"args\": {\"file\": ";
+		instrumentation::write_json_string(out, event.file);
+		out << "}";
+	} else if (event.file_number >= 0) {
+		out << ", \"args\": {\"file\": ";
+		if (event.file_number < static_cast<int>(trace_file_names.size())) {
+			instrumentation::write_json_string(out,
+					trace_file_names[event.file_number]);
+		} else {
+			out << event.file_number;
+		}
+		out << "}";
+	}
+	out << "}";
+}
+
+// run when the process exits
+void write_trace() {
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	std::ostream& out = *trace_out;
+	out << std::fixed;
+	out.precision(3);
+	out << "{\"traceEvents\": [";
+	bool first = true;
+	for (trace_buffer* buffer : trace_buffers) {
+		out << (first ? "\n" : ",\n")
+				<< "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+				<< "\"tid\": " << buffer->thread_id
+				<< ", \"args\": {\"name\": \"thread "
+				<< buffer->thread_id << "\"}}";
+		first = false;
+		for (trace_event& event : buffer->events) {
+			out << ",\n";
+			write_trace_event(out, buffer, event);
+		}
+		delete buffer;
+	}
+	trace_buffers.clear();
+	out << "\n], \"displayTimeUnit\": \"ms\"}" << std::endl;
+	trace_out->close();
+	delete trace_out;
+	trace_out = nullptr;
+}
+
+bool tracing::start_tracing(const std::string& path) {
+	trace_out = new std::ofstream(path);
+	if (!trace_out->good()) {
+		delete trace_out;
+		trace_out = nullptr;
+		return false;
+	}
+	trace_start = std::chrono::steady_clock::now();
+	std::atexit(write_trace);
+	enabled = true;
+	return true;
+}
+
+void tracing::set_file_names(const std::vector<std::string>& names) {
+	trace_file_names = names;
+}
+
+void tracing::span::begin(const char* name, const std::string* file,
+		int file_number) {
+	this->name = name;
+	this->file = file;
+	this->file_number = file_number;
+	start = std::chrono::steady_clock::now();
+}
+
+void tracing::span::end() {
+	std::chrono::steady_clock::time_point now =
+			std::chrono::steady_clock::now();
+	trace_event event;
+	event.name = name;
+	if (file != nullptr) {
+		event.file = *file;
+	}
+	event.file_number = file_number;
+	event.start_micros = micros_since_start(start);
+	event.duration_micros = micros_since_start(now) - event.start_micros;
+	get_thread_buffer()->events.push_back(event);
+}
@@ -0,0 +1,70 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef TRACING_HPP_
+#define TRACING_HPP_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Recording when each part of the compiler runs on which thread, to be
+// written out as a Chrome trace (which chrome://tracing and Perfetto can
+// show). Each thread records into its own buffer, so recording never waits
+// for another thread, and the buffers are only written out when the process
+// exits. When tracing isn't on, a span costs one check of a bool.
+namespace tracing {
+
+// only to be set by start_tracing()
+extern bool enabled;
+
+// starts recording, to be written to the file when the process exits.
+// Returns false if the file can't be opened
+bool start_tracing(const std::string& path);
+// the names of the files which spans with a file number are for. Without
+// them, the number is written instead
+void set_file_names(const std::vector<std::string>& names);
+
+// records a span from when it's created until it goes out of scope. The name
+// has to be a string literal
+class span {
+	bool active;
+	const char* name;
+	const std::string* file;
+	int file_number;
+	std::chrono::steady_clock::time_point start;
+public:
+	span(const char* name) :
+			active(enabled) {
+		if (active) {
+			begin(name, nullptr, -1);
+		}
+	}
+	span(const char* name, const std::string& file) :
+			active(enabled) {
+		if (active) {
+			begin(name, &file, -1);
+		}
+	}
+	span(const char* name, int file_number) :
+			active(enabled) {
+		if (active) {
+			begin(name, nullptr, file_number);
+		}
+	}
+	~span() {
+		if (active) {
+			end();
+		}
+	}
+	span(const span&) = delete;
+	span& operator=(const span&) = delete;
+private:
+	void begin(const char* name, const std::string* file, int file_number);
+	void end();
+};
+
+}
+
+#endif /* TRACING_HPP_ */
@@ -0,0 +1,12 @@
+/*
+ *   Author: Earthcomputer
+ */
+
+#ifndef VERSION_HPP_
+#define VERSION_HPP_
+
+// this has to change whenever the output of any stage of the compiler
+// changes, since it's part of the key for everything that gets cached
+const char* const CROSSLANG_VERSION = "0.1.0";
+
+#endif /* VERSION_HPP_ */